@@ -101,10 +101,13 @@ Exercices:
 #include <GL/gl.h>          // OpenGL header
 #include <GL/glu.h>         // OpenGL Utilities header
 #include <GL/glut.h>        // OpenGL Utility Toolkit header
+#include <glux.h>           // OpenGL extensions loader
 
 #include <cstdio>
 #include <cmath>
 
+#include "../lab1/renderTimer.h" // CPU / GPU times of the render tasks
+
 /* -------------------------------------------------------- */
 
 int          g_MainWindow;          // glut Window Id
@@ -121,6 +124,11 @@ GLdouble     zoomDirY = 0.0;        // y coordinate of current zoom initial dire
 GLdouble     zoomSpeed = 0.0;       // speed of current zoom
 bool         zooming = false;       // zoom is currently occuring
 
+enum { RENDER_TASK_SETUP, RENDER_TASK_OBJECT, NUM_RENDER_TASKS };
+const char     *g_RenderTaskNames[NUM_RENDER_TASKS] = { "setup", "object" };
+t_render_timer  g_RenderTimer;
+bool            g_ShowTimings = true;  // draw the render times over the scene
+
 
 /* -------------------------------------------------------- */
 
@@ -142,6 +150,8 @@ void mainKeyboard(unsigned char key, int x, int y)
 		z += 0.1;
 	} else if (key == '-') {
 		z -= 0.1;
+	} else if (key == 't') {
+		g_ShowTimings = !g_ShowTimings;
 	}
 	printf("key '%c' pressed\n",key);
 }
@@ -218,6 +228,8 @@ void mainReshape(int w,int h)
 
 void mainRender()
 {
+	beginRenderTask(&g_RenderTimer,RENDER_TASK_SETUP);
+
 	/// clear screen
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -263,6 +275,9 @@ void mainRender()
 	//glEnd();
 
 
+	endRenderTask(&g_RenderTimer);
+	beginRenderTask(&g_RenderTimer,RENDER_TASK_OBJECT);
+
 	 // block [5A] (For exercise 5)
 	//
 	glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
@@ -277,7 +292,9 @@ void mainRender()
 	//glutSolidTorus(0.25f,0.75f, k * 32, k * 16);
 	glutSolidTeapot	(1);
 
-	
+	endRenderTask(&g_RenderTimer);
+	if (g_ShowTimings) drawRenderTimerOverlay(&g_RenderTimer);
+	endRenderFrame(&g_RenderTimer);
 
 	// swap - this call exchanges the back and front buffer
 	// swap is synchronized on the screen vertical sync
@@ -286,6 +303,14 @@ void mainRender()
 
 /* -------------------------------------------------------- */
 
+// per-frame CPU / GPU times of mainRender, saved however the program exits
+void exportRenderTimes()
+{
+	if (exportRenderTimerCSV(&g_RenderTimer,"renderTimes.csv")) printf("Render times saved to renderTimes.csv\n");
+}
+
+/* -------------------------------------------------------- */
+
 void idle( void )
 {
 	// whenever the application has free time, ask for a screen refresh
@@ -322,6 +347,10 @@ void main(int argc, char **argv)
 	glutReshapeFunc(mainReshape);
 	// idle (whenever the application as some free time)
 	glutIdleFunc(idle);
+	// load OpenGL extensions (requires the OpenGL context)
+	gluxInit();
+	initRenderTimer(&g_RenderTimer,NUM_RENDER_TASKS,g_RenderTaskNames);
+	atexit(exportRenderTimes);
 
 	///
 	/// OpenGL
@@ -343,6 +372,7 @@ void main(int argc, char **argv)
 
 	// print a small documentation
 	printf("[q]     - quit\n");
+	printf("[t]     - show/hide render times\n");
 
 	// enter glut main loop - this *never* returns
 	glutMainLoop();
@@ -0,0 +1,437 @@
+/* -------------------------------------------------------- */
+/*
+
+Bounding volume hierarchy over the triangles of an indexed mesh (see bvh.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "bvh.h"
+
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+/* -------------------------------------------------------- */
+
+#define BVH_BINS          16
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_STACK_SIZE    64    // traversal stack kept on the call stack, larger ones are allocated
+
+// build state shared by the recursive splits
+typedef struct s_bvh_build
+{
+  t_bvh        *bvh;
+  float        *bounds;      // 6 floats (min, max) per triangle
+  float        *centroids;   // 3 floats per triangle
+} t_bvh_build;
+
+/* -------------------------------------------------------- */
+
+static void growBox(float *min, float *max, const float *boxMin, const float *boxMax)
+{
+  for (int k = 0 ; k < 3 ; k ++ ) {
+    if (boxMin[k] < min[k]) min[k] = boxMin[k];
+    if (boxMax[k] > max[k]) max[k] = boxMax[k];
+  }
+}
+
+static void emptyBox(float *min, float *max)
+{
+  for (int k = 0 ; k < 3 ; k ++ ) {
+    min[k] = FLT_MAX;
+    max[k] = -FLT_MAX;
+  }
+}
+
+static float halfArea(const float *min, const float *max)
+{
+  float d[3] = { max[0] - min[0], max[1] - min[1], max[2] - min[2] };
+  if (d[0] < 0.0f) return 0.0f;
+  return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+/* -------------------------------------------------------- */
+
+// Reserve two consecutive nodes, shared by the parallel subtree builds
+static unsigned int allocateChildren(t_bvh *bvh)
+{
+  unsigned int first;
+#pragma omp critical(bvhAllocate)
+  {
+    first = bvh->numNodes;
+    bvh->numNodes += 2;
+  }
+  return first;
+}
+
+/* -------------------------------------------------------- */
+
+// Split a node along the best binned SAH plane. Returns false (the node stays
+// a leaf) if no split is cheaper than intersecting all of its triangles.
+static bool splitNode(t_bvh_build *build, unsigned int nodeIndex)
+{
+  t_bvh *bvh = build->bvh;
+  t_bvh_node &node = bvh->nodes[nodeIndex];
+  unsigned int *triangles = bvh->triangles + node.first;
+  unsigned int  count     = node.count;
+  if (count <= BVH_MAX_LEAF_SIZE) return false;
+
+  float centroidMin[3], centroidMax[3];
+  emptyBox(centroidMin,centroidMax);
+  for (unsigned int i = 0 ; i < count ; i ++ ) {
+    const float *c = build->centroids + 3 * triangles[i];
+    growBox(centroidMin,centroidMax,c,c);
+  }
+
+  int   bestAxis = -1;
+  int   bestSplit = 0;
+  float bestCost = count * halfArea(node.min,node.max);
+  for (int axis = 0 ; axis < 3 ; axis ++ ) {
+    float extent = centroidMax[axis] - centroidMin[axis];
+    if (extent <= 0.0f) continue;
+    float scale = BVH_BINS / extent;
+    unsigned int binCount[BVH_BINS];
+    float binMin[BVH_BINS][3], binMax[BVH_BINS][3];
+    for (int b = 0 ; b < BVH_BINS ; b ++ ) {
+      binCount[b] = 0;
+      emptyBox(binMin[b],binMax[b]);
+    }
+    for (unsigned int i = 0 ; i < count ; i ++ ) {
+      unsigned int t = triangles[i];
+      int b = (int)((build->centroids[3 * t + axis] - centroidMin[axis]) * scale);
+      if (b >= BVH_BINS) b = BVH_BINS - 1;
+      binCount[b] ++;
+      growBox(binMin[b],binMax[b],build->bounds + 6 * t,build->bounds + 6 * t + 3);
+    }
+    // sweep from the right, then from the left evaluating each plane
+    float rightArea[BVH_BINS];
+    unsigned int rightCount[BVH_BINS];
+    float boxMin[3], boxMax[3];
+    emptyBox(boxMin,boxMax);
+    unsigned int sum = 0;
+    for (int b = BVH_BINS - 1 ; b > 0 ; b -- ) {
+      sum += binCount[b];
+      growBox(boxMin,boxMax,binMin[b],binMax[b]);
+      rightCount[b] = sum;
+      rightArea[b]  = halfArea(boxMin,boxMax);
+    }
+    emptyBox(boxMin,boxMax);
+    sum = 0;
+    for (int b = 0 ; b < BVH_BINS - 1 ; b ++ ) {
+      sum += binCount[b];
+      growBox(boxMin,boxMax,binMin[b],binMax[b]);
+      if (sum == 0 || rightCount[b + 1] == 0) continue;
+      float cost = sum * halfArea(boxMin,boxMax) + rightCount[b + 1] * rightArea[b + 1];
+      if (cost < bestCost) {
+        bestCost  = cost;
+        bestAxis  = axis;
+        bestSplit = b + 1;
+      }
+    }
+  }
+  if (bestAxis < 0) return false;
+
+  // partition the triangles: bins below bestSplit go left
+  float scale = BVH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+  unsigned int left = 0, right = count;
+  while (left < right) {
+    int b = (int)((build->centroids[3 * triangles[left] + bestAxis] - centroidMin[bestAxis]) * scale);
+    if (b >= BVH_BINS) b = BVH_BINS - 1;
+    if (b < bestSplit) {
+      left ++;
+    } else {
+      right --;
+      unsigned int s = triangles[left]; triangles[left] = triangles[right]; triangles[right] = s;
+    }
+  }
+
+  unsigned int first = allocateChildren(bvh);
+  t_bvh_node *children = bvh->nodes + first;
+  children[0].first = node.first;
+  children[0].count = left;
+  children[1].first = node.first + left;
+  children[1].count = count - left;
+  for (int c = 0 ; c < 2 ; c ++ ) {
+    emptyBox(children[c].min,children[c].max);
+    for (unsigned int i = children[c].first ; i < children[c].first + children[c].count ; i ++ ) {
+      const float *box = build->bounds + 6 * bvh->triangles[i];
+      growBox(children[c].min,children[c].max,box,box + 3);
+    }
+  }
+  node.first = first;
+  node.count = 0;
+  return true;
+}
+
+// Returns the depth of the deepest leaf of the subtree
+static unsigned int buildSubtree(t_bvh_build *build, unsigned int nodeIndex, unsigned int depth)
+{
+  if (!splitNode(build,nodeIndex)) return depth;
+  unsigned int first = build->bvh->nodes[nodeIndex].first;
+  unsigned int depth0 = buildSubtree(build,first,depth + 1);
+  unsigned int depth1 = buildSubtree(build,first + 1,depth + 1);
+  return (depth0 > depth1) ? depth0 : depth1;
+}
+
+/* -------------------------------------------------------- */
+
+void buildBVH(t_bvh *bvh, const float *positions, unsigned int stride, const unsigned int *indices, unsigned int numIndices)
+{
+  int numTriangles   = (int)(numIndices / 3);
+  bvh->positions     = positions;
+  bvh->stride        = stride;
+  bvh->indices       = indices;
+  bvh->numTriangles  = numTriangles;
+  bvh->triangles     = new unsigned int[numTriangles > 0 ? numTriangles : 1];
+  // a binary tree with at most one triangle per leaf has 2n - 1 nodes
+  bvh->nodes         = new t_bvh_node[numTriangles > 0 ? 2 * numTriangles - 1 : 1];
+  bvh->numNodes      = 1;
+
+  t_bvh_build build;
+  build.bvh       = bvh;
+  build.bounds    = new float[6 * (numTriangles > 0 ? numTriangles : 1)];
+  build.centroids = new float[3 * (numTriangles > 0 ? numTriangles : 1)];
+#pragma omp parallel for
+  for (int t = 0 ; t < numTriangles ; t ++ ) {
+    float *min = build.bounds + 6 * t, *max = min + 3;
+    emptyBox(min,max);
+    for (int k = 0 ; k < 3 ; k ++ ) {
+      const float *p = positions + (size_t)indices[3 * t + k] * stride;
+      growBox(min,max,p,p);
+    }
+    for (int k = 0 ; k < 3 ; k ++ ) build.centroids[3 * t + k] = (min[k] + max[k]) * 0.5f;
+    bvh->triangles[t] = t;
+  }
+
+  t_bvh_node &root = bvh->nodes[0];
+  root.first = 0;
+  root.count = numTriangles;
+  emptyBox(root.min,root.max);
+  for (int t = 0 ; t < numTriangles ; t ++ ) growBox(root.min,root.max,build.bounds + 6 * t,build.bounds + 6 * t + 3);
+
+  // split breadth-first until there are enough subtrees to keep every thread busy
+  const int targetSubtrees = 64;
+  unsigned int *subtrees = new unsigned int[2 * targetSubtrees + 2];
+  int numSubtrees = 1;
+  subtrees[0] = 0;
+  // subtrees left to build are all at depth 'level'
+  unsigned int level = 0;
+  bool progress = true;
+  while (numSubtrees < targetSubtrees && progress) {
+    progress = false;
+    int numNext = 0;
+    unsigned int *next = new unsigned int[2 * numSubtrees];
+    for (int s = 0 ; s < numSubtrees ; s ++ ) {
+      if (splitNode(&build,subtrees[s])) {
+        next[numNext ++] = bvh->nodes[subtrees[s]].first;
+        next[numNext ++] = bvh->nodes[subtrees[s]].first + 1;
+        progress = true;
+      }
+    }
+    // leaves are done, only the new children remain to be split
+    memcpy(subtrees,next,numNext * sizeof(unsigned int));
+    numSubtrees = numNext;
+    delete [](next);
+    if (progress) level ++;
+  }
+  bvh->maxDepth = level;
+#pragma omp parallel for schedule(dynamic,1)
+  for (int s = 0 ; s < numSubtrees ; s ++ ) {
+    unsigned int depth = buildSubtree(&build,subtrees[s],level);
+#pragma omp critical(bvhDepth)
+    if (depth > bvh->maxDepth) bvh->maxDepth = depth;
+  }
+
+  delete [](subtrees);
+  delete [](build.bounds);
+  delete [](build.centroids);
+}
+
+/* -------------------------------------------------------- */
+
+void freeBVH(t_bvh *bvh)
+{
+  delete [](bvh->nodes);
+  delete [](bvh->triangles);
+  memset(bvh,0,sizeof(t_bvh));
+}
+
+/* -------------------------------------------------------- */
+
+// Entry distance of the ray in a box, or FLT_MAX if it misses it before tMax
+static float intersectBox(const t_bvh_node *node, const float *origin, const float *invDirection, float tMax)
+{
+  float tNear = 0.0f, tFar = tMax;
+  for (int k = 0 ; k < 3 ; k ++ ) {
+    float t0 = (node->min[k] - origin[k]) * invDirection[k];
+    float t1 = (node->max[k] - origin[k]) * invDirection[k];
+    if (t0 > t1) { float s = t0; t0 = t1; t1 = s; }
+    if (t0 > tNear) tNear = t0;
+    if (t1 < tFar)  tFar  = t1;
+    if (tNear > tFar) return FLT_MAX;
+  }
+  return tNear;
+}
+
+// Moller-Trumbore ray / triangle intersection
+static bool intersectTriangle(const t_bvh *bvh, unsigned int triangle, const float *origin, const float *direction, float tMax, t_bvh_hit *hit)
+{
+  const float *a = bvh->positions + (size_t)bvh->indices[3 * triangle]     * bvh->stride;
+  const float *b = bvh->positions + (size_t)bvh->indices[3 * triangle + 1] * bvh->stride;
+  const float *c = bvh->positions + (size_t)bvh->indices[3 * triangle + 2] * bvh->stride;
+  float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+  float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+  float p[3]  = { direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2], direction[0] * e2[1] - direction[1] * e2[0] };
+  float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+  if (fabsf(det) < 1e-12f) return false;
+  float inv = 1.0f / det;
+  float s[3] = { origin[0] - a[0], origin[1] - a[1], origin[2] - a[2] };
+  float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+  if (u < 0.0f || u > 1.0f) return false;
+  float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+  float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inv;
+  if (v < 0.0f || u + v > 1.0f) return false;
+  float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+  if (t < 0.0f || t >= tMax) return false;
+  hit->triangle = triangle;
+  hit->t = t;
+  hit->u = u;
+  hit->v = v;
+  return true;
+}
+
+// Closest hit along origin + t * direction, 0 <= t < tMax
+bool intersectRay(const t_bvh *bvh, const float *origin, const float *direction, float tMax, t_bvh_hit *hit)
+{
+  if (bvh->numTriangles == 0) return false;
+  float invDirection[3];
+  for (int k = 0 ; k < 3 ; k ++ ) invDirection[k] = (direction[k] != 0.0f) ? 1.0f / direction[k] : FLT_MAX;
+  bool found = false;
+  // each visited inner node replaces itself by its two children: the stack never exceeds maxDepth + 1 entries
+  unsigned int localStack[BVH_STACK_SIZE];
+  unsigned int *stack = (bvh->maxDepth < BVH_STACK_SIZE) ? localStack : new unsigned int[bvh->maxDepth + 1];
+  int top = 0;
+  if (intersectBox(&bvh->nodes[0],origin,invDirection,tMax) != FLT_MAX) stack[top ++] = 0;
+  while (top > 0) {
+    const t_bvh_node &node = bvh->nodes[stack[-- top]];
+    if (node.count > 0) {
+      for (unsigned int i = node.first ; i < node.first + node.count ; i ++ ) {
+        if (intersectTriangle(bvh,bvh->triangles[i],origin,direction,tMax,hit)) {
+          tMax  = hit->t;
+          found = true;
+        }
+      }
+      continue;
+    }
+    // visit the nearest child first (pushed last)
+    float t0 = intersectBox(&bvh->nodes[node.first],    origin,invDirection,tMax);
+    float t1 = intersectBox(&bvh->nodes[node.first + 1],origin,invDirection,tMax);
+    unsigned int near = node.first, far = node.first + 1;
+    if (t1 < t0) { float s = t0; t0 = t1; t1 = s; near = node.first + 1; far = node.first; }
+    if (t1 != FLT_MAX) stack[top ++] = far;
+    if (t0 != FLT_MAX) stack[top ++] = near;
+  }
+  if (stack != localStack) delete [](stack);
+  return found;
+}
+
+/* -------------------------------------------------------- */
+
+static float boxDistance2(const t_bvh_node *node, const float *p)
+{
+  float d2 = 0.0f;
+  for (int k = 0 ; k < 3 ; k ++ ) {
+    float d = 0.0f;
+    if      (p[k] < node->min[k]) d = node->min[k] - p[k];
+    else if (p[k] > node->max[k]) d = p[k] - node->max[k];
+    d2 += d * d;
+  }
+  return d2;
+}
+
+// Closest point of triangle abc to p (Ericson, Real-Time Collision Detection, 5.1.5)
+static void closestPointOnTriangle(const float *p, const float *a, const float *b, const float *c, float *result)
+{
+  float ab[3], ac[3], ap[3];
+  for (int k = 0 ; k < 3 ; k ++ ) { ab[k] = b[k] - a[k]; ac[k] = c[k] - a[k]; ap[k] = p[k] - a[k]; }
+  float d1 = ab[0] * ap[0] + ab[1] * ap[1] + ab[2] * ap[2];
+  float d2 = ac[0] * ap[0] + ac[1] * ap[1] + ac[2] * ap[2];
+  if (d1 <= 0.0f && d2 <= 0.0f) { memcpy(result,a,3 * sizeof(float)); return; }
+  float bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] };
+  float d3 = ab[0] * bp[0] + ab[1] * bp[1] + ab[2] * bp[2];
+  float d4 = ac[0] * bp[0] + ac[1] * bp[1] + ac[2] * bp[2];
+  if (d3 >= 0.0f && d4 <= d3) { memcpy(result,b,3 * sizeof(float)); return; }
+  float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+    float v = d1 / (d1 - d3);
+    for (int k = 0 ; k < 3 ; k ++ ) result[k] = a[k] + v * ab[k];
+    return;
+  }
+  float cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+  float d5 = ab[0] * cp[0] + ab[1] * cp[1] + ab[2] * cp[2];
+  float d6 = ac[0] * cp[0] + ac[1] * cp[1] + ac[2] * cp[2];
+  if (d6 >= 0.0f && d5 <= d6) { memcpy(result,c,3 * sizeof(float)); return; }
+  float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+    float w = d2 / (d2 - d6);
+    for (int k = 0 ; k < 3 ; k ++ ) result[k] = a[k] + w * ac[k];
+    return;
+  }
+  float va = d3 * d6 - d5 * d4;
+  if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+    float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    for (int k = 0 ; k < 3 ; k ++ ) result[k] = b[k] + w * (c[k] - b[k]);
+    return;
+  }
+  float denom = 1.0f / (va + vb + vc);
+  float v = vb * denom, w = vc * denom;
+  for (int k = 0 ; k < 3 ; k ++ ) result[k] = a[k] + ab[k] * v + ac[k] * w;
+}
+
+// Closest point of the mesh to 'point', if closer than maxDistance
+bool findNearestPoint(const t_bvh *bvh, const float *point, float maxDistance, t_bvh_nearest *nearest)
+{
+  if (bvh->numTriangles == 0) return false;
+  float best2 = maxDistance * maxDistance;
+  bool found = false;
+  // see intersectRay for the stack size
+  unsigned int localStack[BVH_STACK_SIZE];
+  unsigned int *stack = (bvh->maxDepth < BVH_STACK_SIZE) ? localStack : new unsigned int[bvh->maxDepth + 1];
+  int top = 0;
+  stack[top ++] = 0;
+  while (top > 0) {
+    const t_bvh_node &node = bvh->nodes[stack[-- top]];
+    if (boxDistance2(&node,point) >= best2) continue;
+    if (node.count > 0) {
+      for (unsigned int i = node.first ; i < node.first + node.count ; i ++ ) {
+        unsigned int t = bvh->triangles[i];
+        float closest[3];
+        closestPointOnTriangle(point,
+                               bvh->positions + (size_t)bvh->indices[3 * t]     * bvh->stride,
+                               bvh->positions + (size_t)bvh->indices[3 * t + 1] * bvh->stride,
+                               bvh->positions + (size_t)bvh->indices[3 * t + 2] * bvh->stride,
+                               closest);
+        float d[3] = { closest[0] - point[0], closest[1] - point[1], closest[2] - point[2] };
+        float d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        if (d2 < best2) {
+          best2 = d2;
+          found = true;
+          nearest->triangle = t;
+          memcpy(nearest->point,closest,3 * sizeof(float));
+        }
+      }
+      continue;
+    }
+    // visit the nearest child first (pushed last)
+    unsigned int near = node.first, far = node.first + 1;
+    if (boxDistance2(&bvh->nodes[far],point) < boxDistance2(&bvh->nodes[near],point)) { near = far; far = node.first; }
+    stack[top ++] = far;
+    stack[top ++] = near;
+  }
+  if (stack != localStack) delete [](stack);
+  if (found) nearest->distance = sqrtf(best2);
+  return found;
+}
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,61 @@
+/* -------------------------------------------------------- */
+/*
+
+Bounding volume hierarchy over the triangles of an indexed mesh
+
+Built top-down with a binned surface area heuristic: the upper levels are
+split sequentially, then the resulting subtrees are built in parallel
+(OpenMP). The two children of an inner node are stored next to each other.
+
+Queries: closest ray hit (picking) and closest point on the mesh.
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+/* -------------------------------------------------------- */
+
+typedef struct s_bvh_node
+{
+  float        min[3];
+  float        max[3];
+  unsigned int first;   // first child (inner node) or first entry of 'triangles' (leaf)
+  unsigned int count;   // number of triangles of a leaf, 0 for an inner node
+} t_bvh_node;
+
+typedef struct s_bvh
+{
+  t_bvh_node         *nodes;
+  unsigned int        numNodes;
+  unsigned int       *triangles;    // triangle ids, each leaf referencing a range
+  unsigned int        numTriangles;
+  unsigned int        maxDepth;     // of the deepest leaf, the root being at depth 0
+  // mesh the hierarchy was built over (not copied)
+  const float        *positions;
+  unsigned int        stride;       // in floats
+  const unsigned int *indices;
+} t_bvh;
+
+typedef struct s_bvh_hit
+{
+  unsigned int triangle;
+  float        t;                   // distance along the ray, in units of its direction
+  float        u, v;                // barycentric coordinates of the hit
+} t_bvh_hit;
+
+typedef struct s_bvh_nearest
+{
+  unsigned int triangle;
+  float        point[3];
+  float        distance;
+} t_bvh_nearest;
+
+/* -------------------------------------------------------- */
+
+void buildBVH(t_bvh *bvh, const float *positions, unsigned int stride, const unsigned int *indices, unsigned int numIndices);
+void freeBVH(t_bvh *bvh);
+bool intersectRay(const t_bvh *bvh, const float *origin, const float *direction, float tMax, t_bvh_hit *hit);
+bool findNearestPoint(const t_bvh *bvh, const float *point, float maxDistance, t_bvh_nearest *nearest);
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,359 @@
+/* -------------------------------------------------------- */
+/*
+
+Indexed Face Set storage and .mesh file format (see mesh.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "mesh.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+/* -------------------------------------------------------- */
+
+// 64-bit file position, meshes may be larger than 2GB
+static unsigned long long tellFile(FILE *f)
+{
+#ifdef _WIN32
+  return (unsigned long long)_ftelli64(f);
+#else
+  return (unsigned long long)ftello(f);
+#endif
+}
+
+static unsigned long long alignOffset(unsigned long long offset)
+{
+  return ((offset + MESH_ALIGNMENT - 1) / MESH_ALIGNMENT) * MESH_ALIGNMENT;
+}
+
+/* -------------------------------------------------------- */
+
+// Map a whole file in memory, copy-on-write: the arrays can be modified
+// in place (e.g. reordered) without ever writing back to the file.
+static unsigned char *mapFile(const char *filename, unsigned long long *size)
+{
+  *size = 0;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+  if (file == INVALID_HANDLE_VALUE) return NULL;
+  LARGE_INTEGER fileSize;
+  void *data = NULL;
+  if (GetFileSizeEx(file,&fileSize) && fileSize.QuadPart > 0 && (unsigned long long)fileSize.QuadPart <= (size_t)-1) {
+    HANDLE mapping = CreateFileMappingA(file,NULL,PAGE_WRITECOPY,0,0,NULL);
+    if (mapping != NULL) {
+      // the view keeps the mapping alive once both handles are closed
+      data = MapViewOfFile(mapping,FILE_MAP_COPY,0,0,0);
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+  if (data == NULL) return NULL;
+  *size = (unsigned long long)fileSize.QuadPart;
+  return (unsigned char *)data;
+#else
+  int file = open(filename,O_RDONLY);
+  if (file < 0) return NULL;
+  struct stat status;
+  void *data = MAP_FAILED;
+  if (fstat(file,&status) == 0 && status.st_size > 0 && (unsigned long long)status.st_size <= (size_t)-1) {
+    data = mmap(NULL,(size_t)status.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,file,0);
+  }
+  close(file);
+  if (data == MAP_FAILED) return NULL;
+  *size = (unsigned long long)status.st_size;
+  return (unsigned char *)data;
+#endif
+}
+
+static void unmapFile(void *data, unsigned long long size)
+{
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+#else
+  munmap(data,(size_t)size);
+#endif
+}
+
+// An array can be used in place if its address suits the element type
+// (the mapping itself is page aligned, so this only depends on the file offset)
+static bool isAligned(const void *ptr, size_t alignment)
+{
+  return ((size_t)ptr % alignment) == 0;
+}
+
+/* -------------------------------------------------------- */
+
+void initMesh(t_mesh *mesh)
+{
+  memset(mesh,0,sizeof(t_mesh));
+}
+
+/* -------------------------------------------------------- */
+
+void freeMesh(t_mesh *mesh)
+{
+  if (mesh->ownsVerticies) delete [](mesh->verticies);
+  if (mesh->ownsIndices)   delete [](mesh->indices);
+  delete [](mesh->chunks);
+  if (mesh->mapping != NULL) unmapFile(mesh->mapping,mesh->mappingSize);
+  initMesh(mesh);
+}
+
+/* -------------------------------------------------------- */
+
+// Check that chunks tile the vertex and index arrays in order
+static bool checkChunks(const t_mesh_header *header, const t_mesh_chunk *chunks)
+{
+  unsigned int nextVertex = 0;
+  unsigned int nextIndex  = 0;
+  for (unsigned int c = 0 ; c < header->numChunks ; c ++ ) {
+    const t_mesh_chunk &chunk = chunks[c];
+    if (chunk.firstVertex != nextVertex || chunk.firstIndex != nextIndex) return false;
+    if (chunk.numVerticies > header->numVerticies - nextVertex) return false;
+    if (chunk.numIndices > header->numIndices - nextIndex) return false;
+    if (chunk.numIndices % 3 != 0) return false;
+    if (header->indexSize == 2 && chunk.numVerticies > 65536) return false;
+    nextVertex += chunk.numVerticies;
+    nextIndex  += chunk.numIndices;
+  }
+  return nextVertex == header->numVerticies && nextIndex == header->numIndices;
+}
+
+/* -------------------------------------------------------- */
+
+// Point to the verticies in the mapping, or copy them if misaligned
+static void setVerticies(t_mesh *mesh, const unsigned char *data, unsigned int numVerticies)
+{
+  mesh->numVerticies = numVerticies;
+  if (isAligned(data,sizeof(float))) {
+    mesh->verticies     = (t_point *)data;
+    mesh->ownsVerticies = false;
+  } else {
+    mesh->verticies     = new t_point[numVerticies];
+    mesh->ownsVerticies = true;
+    memcpy(mesh->verticies,data,(size_t)numVerticies * sizeof(t_point));
+  }
+}
+
+/* -------------------------------------------------------- */
+
+static bool loadLegacyMesh(const unsigned char *data, unsigned long long fileSize, t_mesh *mesh)
+{
+  unsigned int numVerticies = 0;
+  unsigned int numIndices   = 0;
+  if (fileSize < sizeof(unsigned int)) return false;
+  memcpy(&numVerticies,data,sizeof(unsigned int));
+  unsigned long long indexCountOffset = sizeof(unsigned int) + (unsigned long long)numVerticies * sizeof(t_point);
+  if (indexCountOffset + sizeof(unsigned int) > fileSize) return false;
+  memcpy(&numIndices,data + indexCountOffset,sizeof(unsigned int));
+  if (indexCountOffset + sizeof(unsigned int) + (unsigned long long)numIndices * sizeof(unsigned short) > fileSize) return false;
+  if (numIndices % 3 != 0) return false;
+
+  setVerticies(mesh,data + sizeof(unsigned int),numVerticies);
+  mesh->numChunks    = 1;
+  mesh->chunks       = new t_mesh_chunk[1];
+  mesh->chunks[0].firstVertex  = 0;
+  mesh->chunks[0].numVerticies = numVerticies;
+  mesh->chunks[0].firstIndex   = 0;
+  mesh->chunks[0].numIndices   = numIndices;
+
+  // 16-bit indices are widened to 32 bits
+  const unsigned char *indices = data + indexCountOffset + sizeof(unsigned int);
+  mesh->numIndices  = numIndices;
+  mesh->indices     = new unsigned int[numIndices];
+  mesh->ownsIndices = true;
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) {
+    unsigned short index;
+    memcpy(&index,indices + i * sizeof(unsigned short),sizeof(unsigned short));
+    if (index >= numVerticies) return false;
+    mesh->indices[i] = index;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------- */
+
+static bool loadVersionedMesh(const unsigned char *data, unsigned long long fileSize, t_mesh *mesh)
+{
+  t_mesh_header header;
+  if (fileSize < sizeof(t_mesh_header)) return false;
+  memcpy(&header,data,sizeof(t_mesh_header));
+  if (header.version != MESH_VERSION) {
+    cerr << "[loadMesh] Unsupported version " << header.version << endl;
+    return false;
+  }
+  if (header.indexSize != 2 && header.indexSize != 4) return false;
+  unsigned long long tableEnd    = sizeof(t_mesh_header) + (unsigned long long)header.numChunks * sizeof(t_mesh_chunk);
+  unsigned long long vertexBytes = (unsigned long long)header.numVerticies * sizeof(t_point);
+  unsigned long long indexBytes  = (unsigned long long)header.numIndices * header.indexSize;
+  if (tableEnd > fileSize) return false;
+  if (header.vertexOffset < tableEnd || header.vertexOffset > fileSize || vertexBytes > fileSize - header.vertexOffset) return false;
+  if (header.indexOffset < header.vertexOffset + vertexBytes || header.indexOffset > fileSize || indexBytes > fileSize - header.indexOffset) return false;
+
+  mesh->numChunks = header.numChunks;
+  mesh->chunks    = new t_mesh_chunk[header.numChunks];
+  memcpy(mesh->chunks,data + sizeof(t_mesh_header),(size_t)header.numChunks * sizeof(t_mesh_chunk));
+  if (!checkChunks(&header,mesh->chunks)) return false;
+
+  setVerticies(mesh,data + header.vertexOffset,header.numVerticies);
+
+  // 32-bit indices of a single chunk are already relative to the whole vertex array:
+  // they are used in place, otherwise they are converted chunk by chunk
+  const unsigned char *indices = data + header.indexOffset;
+  mesh->numIndices = header.numIndices;
+  if (header.indexSize == 4 && header.numChunks <= 1 && isAligned(indices,sizeof(unsigned int))) {
+    mesh->indices     = (unsigned int *)indices;
+    mesh->ownsIndices = false;
+    for (unsigned int i = 0 ; i < header.numIndices ; i ++ ) {
+      if (mesh->indices[i] >= header.numVerticies) return false;
+    }
+    return true;
+  }
+  mesh->indices     = new unsigned int[header.numIndices];
+  mesh->ownsIndices = true;
+  for (unsigned int c = 0 ; c < header.numChunks ; c ++ ) {
+    const t_mesh_chunk &chunk = mesh->chunks[c];
+    for (unsigned int i = chunk.firstIndex ; i < chunk.firstIndex + chunk.numIndices ; i ++ ) {
+      unsigned int index;
+      if (header.indexSize == 4) {
+        memcpy(&index,indices + (size_t)i * 4,4);
+      } else {
+        unsigned short shortIndex;
+        memcpy(&shortIndex,indices + (size_t)i * 2,2);
+        index = shortIndex;
+      }
+      if (index >= chunk.numVerticies) return false;
+      mesh->indices[i] = index + chunk.firstVertex;
+    }
+  }
+  return true;
+}
+
+/* -------------------------------------------------------- */
+
+// Load a mesh in either layout, validating sizes, chunks and indices.
+// The file is memory-mapped: verticies (and 32-bit single-chunk indices) are
+// used directly from the mapping, nothing is read through stdio.
+// On failure, the mesh is left empty.
+bool loadMesh(const char *filename, t_mesh *mesh)
+{
+  initMesh(mesh);
+  unsigned long long fileSize = 0;
+  unsigned char *data = mapFile(filename,&fileSize);
+  if (data == NULL) {
+    cerr << "[loadMesh] Cannot open " << filename << endl;
+    return false;
+  }
+  mesh->mapping     = data;
+  mesh->mappingSize = fileSize;
+
+  bool ok;
+  if (fileSize >= 4 && memcmp(data,MESH_MAGIC,4) == 0) {
+    ok = loadVersionedMesh(data,fileSize,mesh);
+  } else {
+    ok = loadLegacyMesh(data,fileSize,mesh);
+  }
+  if (!ok) {
+    cerr << "[loadMesh] Invalid or truncated mesh " << filename << endl;
+    freeMesh(mesh);
+    return false;
+  }
+  // nothing points into the mapping anymore (misaligned verticies and converted indices)
+  if (mesh->ownsVerticies && mesh->ownsIndices) {
+    unmapFile(mesh->mapping,mesh->mappingSize);
+    mesh->mapping     = NULL;
+    mesh->mappingSize = 0;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------- */
+
+static void writePadding(FILE *f, unsigned long long offset)
+{
+  static const char zeros[MESH_ALIGNMENT] = { 0 };
+  unsigned long long position = tellFile(f);
+  if (offset > position) fwrite(zeros,1,(size_t)(offset - position),f);
+}
+
+// Save a mesh in the versioned layout. Indices are stored on 16 bits when every
+// chunk has at most 65536 verticies; a mesh without chunks is saved as one chunk.
+bool saveMesh(const char *filename, const t_mesh *mesh)
+{
+  t_mesh_chunk  single;
+  const t_mesh_chunk *chunks = mesh->chunks;
+  unsigned int  numChunks    = mesh->numChunks;
+  if (numChunks == 0) {
+    single.firstVertex  = 0;
+    single.numVerticies = mesh->numVerticies;
+    single.firstIndex   = 0;
+    single.numIndices   = mesh->numIndices;
+    chunks    = &single;
+    numChunks = 1;
+  }
+
+  t_mesh_header header;
+  memcpy(header.magic,MESH_MAGIC,4);
+  header.version      = MESH_VERSION;
+  header.indexSize    = 2;
+  header.numChunks    = numChunks;
+  header.numVerticies = mesh->numVerticies;
+  header.numIndices   = mesh->numIndices;
+  for (unsigned int c = 0 ; c < numChunks ; c ++ ) {
+    if (chunks[c].numVerticies > 65536) header.indexSize = 4;
+  }
+  header.vertexOffset = alignOffset(sizeof(t_mesh_header) + (unsigned long long)numChunks * sizeof(t_mesh_chunk));
+  header.indexOffset  = alignOffset(header.vertexOffset + (unsigned long long)mesh->numVerticies * sizeof(t_point));
+  if (!checkChunks(&header,chunks)) {
+    cerr << "[saveMesh] Chunks do not cover the mesh" << endl;
+    return false;
+  }
+
+  FILE *f = fopen(filename,"wb");
+  if (f == NULL) {
+    cerr << "[saveMesh] Cannot create " << filename << endl;
+    return false;
+  }
+  bool ok = fwrite(&header,sizeof(t_mesh_header),1,f) == 1
+         && fwrite(chunks,sizeof(t_mesh_chunk),numChunks,f) == numChunks;
+  writePadding(f,header.vertexOffset);
+  ok = ok && fwrite(mesh->verticies,sizeof(t_point),mesh->numVerticies,f) == mesh->numVerticies;
+  writePadding(f,header.indexOffset);
+  // indices are converted chunk by chunk, relative to the first vertex of the chunk
+  for (unsigned int c = 0 ; ok && c < numChunks ; c ++ ) {
+    const t_mesh_chunk &chunk = chunks[c];
+    unsigned int   *indices      = new unsigned int[chunk.numIndices];
+    unsigned short *shortIndices = (unsigned short *)indices;
+    for (unsigned int i = 0 ; ok && i < chunk.numIndices ; i ++ ) {
+      unsigned int index = mesh->indices[chunk.firstIndex + i];
+      if (index < chunk.firstVertex || index - chunk.firstVertex >= chunk.numVerticies) {
+        cerr << "[saveMesh] Triangle " << (chunk.firstIndex + i)/3 << " references a vertex outside its chunk" << endl;
+        ok = false;
+      }
+      // 16-bit indices are packed at the start of the same buffer
+      if (header.indexSize == 2) shortIndices[i] = (unsigned short)(index - chunk.firstVertex);
+      else                       indices[i]      = index - chunk.firstVertex;
+    }
+    ok = ok && fwrite(indices,header.indexSize,chunk.numIndices,f) == chunk.numIndices;
+    delete [](indices);
+  }
+  fclose(f);
+  if (!ok) cerr << "[saveMesh] Cannot write " << filename << endl;
+  return ok;
+}
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,90 @@
+/* -------------------------------------------------------- */
+/*
+
+Indexed Face Set storage and .mesh file format
+
+Two layouts are read:
+
+- legacy layout (test.mesh):
+    unsigned int   numVerticies
+    t_point        verticies[numVerticies]
+    unsigned int   numIndices
+    unsigned short indices[numIndices]
+
+- versioned layout (MESH_VERSION), little-endian:
+    t_mesh_header  header
+    t_mesh_chunk   chunks[header.numChunks]
+    t_point        verticies[header.numVerticies]   at header.vertexOffset
+    indices        (header.indexSize bytes each)    at header.indexOffset
+
+  Chunks split the mesh into consecutive vertex and index ranges. Indices are
+  stored relative to the first vertex of their chunk, so 16-bit indices are
+  enough as long as no chunk has more than 65536 verticies. Arrays start on
+  MESH_ALIGNMENT byte boundaries.
+
+In memory, indices are always 32-bit and refer to the whole vertex array.
+Files are memory-mapped (copy-on-write): the vertex array, and the index
+array when it is stored with 32-bit indices in a single chunk, point directly
+into the mapping instead of being copied, provided they are suitably aligned.
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+/* -------------------------------------------------------- */
+
+typedef struct s_point
+{
+  float p[3];
+  float n[3];
+  float uv[2];
+} t_point;
+
+typedef struct s_mesh_chunk
+{
+  unsigned int firstVertex;
+  unsigned int numVerticies;
+  unsigned int firstIndex;
+  unsigned int numIndices;
+} t_mesh_chunk;
+
+typedef struct s_mesh_header
+{
+  char               magic[4];      // MESH_MAGIC
+  unsigned int       version;       // MESH_VERSION
+  unsigned int       indexSize;     // 2 or 4 bytes per index
+  unsigned int       numChunks;
+  unsigned int       numVerticies;
+  unsigned int       numIndices;
+  unsigned long long vertexOffset;  // byte offset of the vertex array
+  unsigned long long indexOffset;   // byte offset of the index array
+} t_mesh_header;
+
+typedef struct s_mesh
+{
+  t_point      *verticies;
+  unsigned int  numVerticies;
+  unsigned int *indices;            // 3 per triangle
+  unsigned int  numIndices;
+  t_mesh_chunk *chunks;
+  unsigned int  numChunks;
+  // storage: each array either points into the file mapping or is owned (new[])
+  void         *mapping;
+  unsigned long long mappingSize;
+  bool          ownsVerticies;
+  bool          ownsIndices;
+} t_mesh;
+
+#define MESH_MAGIC     "IFSM"
+#define MESH_VERSION   2
+#define MESH_ALIGNMENT 16
+
+/* -------------------------------------------------------- */
+
+void initMesh(t_mesh *mesh);
+void freeMesh(t_mesh *mesh);
+bool loadMesh(const char *filename, t_mesh *mesh);
+bool saveMesh(const char *filename, const t_mesh *mesh);
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,296 @@
+/* -------------------------------------------------------- */
+/*
+
+Level-of-detail chain by quadric error metric simplification (see meshLOD.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "meshLOD.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+/* -------------------------------------------------------- */
+
+// Symmetric 4x4 quadric: xx xy xz xw yy yz yw zz zw ww, plus the total weight (triangle area)
+typedef struct s_quadric
+{
+  double q[10];
+  double weight;
+} t_quadric;
+
+typedef struct s_collapse
+{
+  unsigned int from;
+  unsigned int to;
+  double       cost;
+} t_collapse;
+
+/* -------------------------------------------------------- */
+
+static const float *getPosition(const float *positions, unsigned int stride, unsigned int v)
+{
+  return positions + (size_t)v * stride;
+}
+
+static void triangleNormal(const float *a, const float *b, const float *c, double *n)
+{
+  double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+  double v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+  n[0] = u[1] * v[2] - u[2] * v[1];
+  n[1] = u[2] * v[0] - u[0] * v[2];
+  n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+static void addQuadric(t_quadric *dst, const t_quadric *src)
+{
+  for (int k = 0 ; k < 10 ; k ++ ) dst->q[k] += src->q[k];
+  dst->weight += src->weight;
+}
+
+// Add the plane of a triangle, weighted by its area
+static void addTrianglePlane(t_quadric *quadric, const float *a, const float *b, const float *c)
+{
+  double n[3];
+  triangleNormal(a,b,c,n);
+  double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  if (length == 0.0) return;
+  double w = length * 0.5;
+  n[0] /= length; n[1] /= length; n[2] /= length;
+  double d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+  double p[4] = { n[0], n[1], n[2], d };
+  int k = 0;
+  for (int i = 0 ; i < 4 ; i ++ ) {
+    for (int j = i ; j < 4 ; j ++ ) quadric->q[k ++] += w * p[i] * p[j];
+  }
+  quadric->weight += w;
+}
+
+// Mean squared distance of a point to the planes of two merged quadrics
+static double evaluateCollapse(const t_quadric *qa, const t_quadric *qb, const float *p)
+{
+  double q[10];
+  for (int k = 0 ; k < 10 ; k ++ ) q[k] = qa->q[k] + qb->q[k];
+  double x = p[0], y = p[1], z = p[2];
+  double e = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+           + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+           + q[7] * z * z + 2 * q[8] * z
+           + q[9];
+  double weight = qa->weight + qb->weight;
+  return (weight > 0.0 && e > 0.0) ? e / weight : 0.0;
+}
+
+/* -------------------------------------------------------- */
+
+static int compareKeys(const void *a, const void *b)
+{
+  unsigned long long ka = *(const unsigned long long *)a;
+  unsigned long long kb = *(const unsigned long long *)b;
+  return (ka < kb) ? -1 : ((ka > kb) ? 1 : 0);
+}
+
+static int compareCollapses(const void *a, const void *b)
+{
+  double ca = ((const t_collapse *)a)->cost;
+  double cb = ((const t_collapse *)b)->cost;
+  return (ca < cb) ? -1 : ((ca > cb) ? 1 : 0);
+}
+
+/* -------------------------------------------------------- */
+
+// Would moving 'from' onto 'to' flip (or collapse to a sliver) a triangle around 'from'
+// that does not contain 'to'? 'triangles' lists the triangles around 'from'.
+static bool flipsTriangle(const float *positions, unsigned int stride, const unsigned int *indices,
+                          const unsigned int *triangles, unsigned int numTriangles, unsigned int from, unsigned int to)
+{
+  for (unsigned int t = 0 ; t < numTriangles ; t ++ ) {
+    const unsigned int *triangle = indices + 3 * triangles[t];
+    if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+    const float *p[3], *q[3];
+    for (int k = 0 ; k < 3 ; k ++ ) {
+      p[k] = getPosition(positions,stride,triangle[k]);
+      q[k] = getPosition(positions,stride,(triangle[k] == from) ? to : triangle[k]);
+    }
+    double before[3], after[3];
+    triangleNormal(p[0],p[1],p[2],before);
+    triangleNormal(q[0],q[1],q[2],after);
+    if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0) return true;
+  }
+  return false;
+}
+
+/* -------------------------------------------------------- */
+
+// One simplification pass: collapses are sorted by cost and applied in order,
+// each one locking the vertices around it for the rest of the pass so that the
+// adjacency stays valid. Returns the number of triangles left.
+static unsigned int simplifyPass(const float *positions, unsigned int stride, unsigned int numVerticies,
+                                 unsigned int *indices, unsigned int numTriangles, unsigned int targetTriangles,
+                                 t_quadric *quadrics, double *maxCost)
+{
+  unsigned int numIndices = numTriangles * 3;
+
+  // unique edges, and boundary verticies (on an edge used by a single triangle)
+  unsigned long long *edges = new unsigned long long[numIndices];
+  for (unsigned int t = 0 ; t < numTriangles ; t ++ ) {
+    for (int k = 0 ; k < 3 ; k ++ ) {
+      unsigned int a = indices[3 * t + k], b = indices[3 * t + (k + 1) % 3];
+      if (a > b) { unsigned int s = a; a = b; b = s; }
+      edges[3 * t + k] = ((unsigned long long)a << 32) | b;
+    }
+  }
+  qsort(edges,numIndices,sizeof(unsigned long long),compareKeys);
+  bool *boundary = new bool[numVerticies];
+  memset(boundary,0,numVerticies * sizeof(bool));
+  t_collapse *collapses = new t_collapse[numIndices];
+  unsigned int numCollapses = 0;
+  for (unsigned int e = 0 ; e < numIndices ; ) {
+    unsigned int count = 1;
+    while (e + count < numIndices && edges[e + count] == edges[e]) count ++;
+    unsigned int a = (unsigned int)(edges[e] >> 32), b = (unsigned int)edges[e];
+    if (count == 1) boundary[a] = boundary[b] = true;
+    e += count;
+  }
+  for (unsigned int e = 0 ; e < numIndices ; ) {
+    unsigned int count = 1;
+    while (e + count < numIndices && edges[e + count] == edges[e]) count ++;
+    unsigned int a = (unsigned int)(edges[e] >> 32), b = (unsigned int)edges[e];
+    e += count;
+    if (a == b) continue;
+    // cheaper direction among those which do not move a boundary vertex
+    double costAB = boundary[a] ? -1.0 : evaluateCollapse(&quadrics[a],&quadrics[b],getPosition(positions,stride,b));
+    double costBA = boundary[b] ? -1.0 : evaluateCollapse(&quadrics[a],&quadrics[b],getPosition(positions,stride,a));
+    if (costAB < 0.0 && costBA < 0.0) continue;
+    t_collapse &c = collapses[numCollapses ++];
+    if (costBA < 0.0 || (costAB >= 0.0 && costAB <= costBA)) { c.from = a; c.to = b; c.cost = costAB; }
+    else                                                     { c.from = b; c.to = a; c.cost = costBA; }
+  }
+  qsort(collapses,numCollapses,sizeof(t_collapse),compareCollapses);
+  delete [](edges);
+
+  // vertex -> triangles adjacency
+  unsigned int *offsets   = new unsigned int[numVerticies + 1];
+  unsigned int *adjacency = new unsigned int[numIndices];
+  memset(offsets,0,(numVerticies + 1) * sizeof(unsigned int));
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) offsets[indices[i] + 1] ++;
+  for (unsigned int v = 0 ; v < numVerticies ; v ++ ) offsets[v + 1] += offsets[v];
+  unsigned int *fill = new unsigned int[numVerticies];
+  memcpy(fill,offsets,numVerticies * sizeof(unsigned int));
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) adjacency[fill[indices[i]] ++] = i / 3;
+  delete [](fill);
+
+  unsigned int *remap  = new unsigned int[numVerticies];
+  bool         *locked = new bool[numVerticies];
+  for (unsigned int v = 0 ; v < numVerticies ; v ++ ) remap[v] = v;
+  memset(locked,0,numVerticies * sizeof(bool));
+  unsigned int removed = 0;
+  for (unsigned int c = 0 ; c < numCollapses && numTriangles - removed > targetTriangles ; c ++ ) {
+    unsigned int from = collapses[c].from, to = collapses[c].to;
+    if (locked[from] || locked[to]) continue;
+    const unsigned int *around = adjacency + offsets[from];
+    unsigned int numAround = offsets[from + 1] - offsets[from];
+    if (flipsTriangle(positions,stride,indices,around,numAround,from,to)) continue;
+    remap[from] = to;
+    addQuadric(&quadrics[to],&quadrics[from]);
+    if (collapses[c].cost > *maxCost) *maxCost = collapses[c].cost;
+    for (unsigned int t = 0 ; t < numAround ; t ++ ) {
+      const unsigned int *triangle = indices + 3 * around[t];
+      if (triangle[0] == to || triangle[1] == to || triangle[2] == to) removed ++;
+      locked[triangle[0]] = locked[triangle[1]] = locked[triangle[2]] = true;
+    }
+  }
+
+  // apply the collapses (a collapsed vertex is locked, so remap is never chained)
+  // and drop the triangles which became degenerate
+  unsigned int numKept = 0;
+  for (unsigned int t = 0 ; t < numTriangles ; t ++ ) {
+    unsigned int a = remap[indices[3 * t]], b = remap[indices[3 * t + 1]], c = remap[indices[3 * t + 2]];
+    if (a == b || b == c || c == a) continue;
+    indices[3 * numKept] = a; indices[3 * numKept + 1] = b; indices[3 * numKept + 2] = c;
+    numKept ++;
+  }
+
+  delete [](boundary);
+  delete [](collapses);
+  delete [](offsets);
+  delete [](adjacency);
+  delete [](remap);
+  delete [](locked);
+  return numKept;
+}
+
+/* -------------------------------------------------------- */
+
+// Build up to 'maxLods' levels (including the input), each one having about
+// 'ratio' times the triangles of the previous one. Stops early when a level
+// cannot be reduced any further.
+void buildLODChain(const float *positions, unsigned int stride, unsigned int numVerticies,
+                   unsigned int *indices, unsigned int numIndices,
+                   unsigned int maxLods, float ratio, t_mesh_lod_chain *chain)
+{
+  chain->lods    = new t_mesh_lod[maxLods > 0 ? maxLods : 1];
+  chain->numLods = 1;
+  chain->lods[0].indices    = indices;
+  chain->lods[0].numIndices = numIndices;
+  chain->lods[0].error      = 0.0f;
+  unsigned int numTriangles = numIndices / 3;
+  if (numTriangles == 0) return;
+
+  t_quadric *quadrics = new t_quadric[numVerticies];
+  memset(quadrics,0,numVerticies * sizeof(t_quadric));
+  for (unsigned int t = 0 ; t < numTriangles ; t ++ ) {
+    const float *p[3];
+    for (int k = 0 ; k < 3 ; k ++ ) p[k] = getPosition(positions,stride,indices[3 * t + k]);
+    for (int k = 0 ; k < 3 ; k ++ ) addTrianglePlane(&quadrics[indices[3 * t + k]],p[0],p[1],p[2]);
+  }
+
+  unsigned int *work = new unsigned int[numIndices];
+  memcpy(work,indices,numIndices * sizeof(unsigned int));
+  double maxCost = 0.0;
+  while (chain->numLods < maxLods) {
+    unsigned int target = (unsigned int)(numTriangles * ratio);
+    unsigned int left   = numTriangles;
+    // a pass cannot collapse adjacent edges, several are needed to reach the target
+    while (left > target) {
+      unsigned int kept = simplifyPass(positions,stride,numVerticies,work,left,target,quadrics,&maxCost);
+      if (kept == left) break;
+      left = kept;
+    }
+    if (left == numTriangles) break;
+    t_mesh_lod &lod = chain->lods[chain->numLods ++];
+    lod.numIndices = left * 3;
+    lod.indices    = new unsigned int[lod.numIndices];
+    lod.error      = (float)sqrt(maxCost);
+    memcpy(lod.indices,work,lod.numIndices * sizeof(unsigned int));
+    numTriangles = left;
+  }
+  delete [](work);
+  delete [](quadrics);
+}
+
+/* -------------------------------------------------------- */
+
+void freeLODChain(t_mesh_lod_chain *chain)
+{
+  for (unsigned int l = 1 ; l < chain->numLods ; l ++ ) delete [](chain->lods[l].indices);
+  delete [](chain->lods);
+  chain->lods    = NULL;
+  chain->numLods = 0;
+}
+
+/* -------------------------------------------------------- */
+
+// Coarsest level whose error, seen at 'distance' with a vertical field of view
+// of 'fovY' degrees on 'screenHeight' pixels, stays below 'maxPixelError' pixels
+unsigned int selectLOD(const t_mesh_lod_chain *chain, float distance, float fovY, float screenHeight, float maxPixelError)
+{
+  if (distance <= 0.0f) return 0;
+  float pixelsPerUnit = screenHeight / (2.0f * distance * tanf(fovY * 3.14159265f / 360.0f));
+  unsigned int lod = 0;
+  while (lod + 1 < chain->numLods && chain->lods[lod + 1].error * pixelsPerUnit <= maxPixelError) lod ++;
+  return lod;
+}
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,46 @@
+/* -------------------------------------------------------- */
+/*
+
+Level-of-detail chain by quadric error metric simplification
+
+Each level is built from the previous one by half-edge collapses (a vertex is
+merged into a neighbour) ordered by quadric error (Garland & Heckbert 1997),
+so every level only needs a new index array over the original verticies.
+Collapses that would flip a triangle or move a boundary vertex are rejected.
+
+The error of a level is an RMS estimate, in object space: the square root of
+the largest quadric cost of its collapses, each cost being the area-weighted
+mean squared distance of the kept vertex to the planes accumulated by the
+merged verticies. It is not a bound on the distance to the original surface,
+so the runtime selection (coarsest level whose error projects to less than a
+given number of pixels) is a heuristic, not a guarantee.
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+/* -------------------------------------------------------- */
+
+typedef struct s_mesh_lod
+{
+  unsigned int *indices;      // into the full-resolution vertex array
+  unsigned int  numIndices;
+  float         error;        // object-space RMS error estimate (not a bound)
+} t_mesh_lod;
+
+typedef struct s_mesh_lod_chain
+{
+  t_mesh_lod   *lods;         // lods[0] is the input (indices not copied)
+  unsigned int  numLods;
+} t_mesh_lod_chain;
+
+/* -------------------------------------------------------- */
+
+void buildLODChain(const float *positions, unsigned int stride, unsigned int numVerticies,
+                   unsigned int *indices, unsigned int numIndices,
+                   unsigned int maxLods, float ratio, t_mesh_lod_chain *chain);
+void freeLODChain(t_mesh_lod_chain *chain);
+unsigned int selectLOD(const t_mesh_lod_chain *chain, float distance, float fovY, float screenHeight, float maxPixelError);
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,176 @@
+/* -------------------------------------------------------- */
+/*
+
+Post-load mesh optimization (see meshOptimize.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "meshOptimize.h"
+
+#include <cstring>
+
+/* -------------------------------------------------------- */
+
+// Simulate a FIFO cache of 'cacheSize' verticies over the index stream
+float computeACMR(const unsigned int *indices, unsigned int numIndices, unsigned int numVerticies, unsigned int cacheSize)
+{
+  if (numIndices < 3) return 0.0f;
+  // a vertex is in the cache if it entered it less than 'cacheSize' misses ago
+  unsigned int *entered = new unsigned int[numVerticies];
+  memset(entered,0,numVerticies * sizeof(unsigned int));
+  unsigned int misses = 0;
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) {
+    unsigned int v = indices[i];
+    if (entered[v] == 0 || misses - entered[v] + 1 > cacheSize) {
+      misses ++;
+      entered[v] = misses;
+    }
+  }
+  delete [](entered);
+  return misses / float(numIndices / 3);
+}
+
+/* -------------------------------------------------------- */
+
+// Next fanning vertex: the candidate (vertex of the last emitted triangles) still
+// having triangles left that will be the oldest in the cache without leaving it,
+// otherwise the most recent dead-end vertex with triangles left, otherwise the
+// next vertex in order with triangles left
+static int getNextVertex(const unsigned int *candidates, unsigned int numCandidates,
+                         const unsigned int *live, const unsigned int *cacheTime, unsigned int timestamp, unsigned int cacheSize,
+                         unsigned int *deadEnd, unsigned int &deadEndSize, unsigned int &cursor, unsigned int numVerticies)
+{
+  int best         = -1;
+  int bestPriority = -1;
+  for (unsigned int c = 0 ; c < numCandidates ; c ++ ) {
+    unsigned int v = candidates[c];
+    if (live[v] == 0) continue;
+    int priority = 0;
+    if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize) priority = timestamp - cacheTime[v];
+    if (priority > bestPriority) {
+      best         = v;
+      bestPriority = priority;
+    }
+  }
+  if (best >= 0) return best;
+
+  while (deadEndSize > 0) {
+    unsigned int v = deadEnd[-- deadEndSize];
+    if (live[v] > 0) return v;
+  }
+  while (cursor < numVerticies) {
+    if (live[cursor] > 0) return cursor;
+    cursor ++;
+  }
+  return -1;
+}
+
+/* -------------------------------------------------------- */
+
+// Reorder the triangles of 'indices', which reference verticies
+// [firstVertex, firstVertex + numVerticies), with Tipsify
+void optimizeVertexCache(unsigned int *indices, unsigned int numIndices, unsigned int firstVertex, unsigned int numVerticies, unsigned int cacheSize)
+{
+  unsigned int numTriangles = numIndices / 3;
+  if (numTriangles < 2) return;
+
+  // vertex -> triangles adjacency, as offsets into a single array
+  unsigned int *live      = new unsigned int[numVerticies];
+  unsigned int *offsets   = new unsigned int[numVerticies + 1];
+  unsigned int *adjacency = new unsigned int[numIndices];
+  memset(live,0,numVerticies * sizeof(unsigned int));
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) live[indices[i] - firstVertex] ++;
+  offsets[0] = 0;
+  for (unsigned int v = 0 ; v < numVerticies ; v ++ ) offsets[v + 1] = offsets[v] + live[v];
+  unsigned int *fill = new unsigned int[numVerticies];
+  memcpy(fill,offsets,numVerticies * sizeof(unsigned int));
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) adjacency[fill[indices[i] - firstVertex] ++] = i / 3;
+  delete [](fill);
+
+  unsigned int *cacheTime  = new unsigned int[numVerticies];
+  unsigned int *deadEnd    = new unsigned int[numIndices];
+  unsigned int *candidates = new unsigned int[numIndices];
+  bool         *emitted    = new bool[numTriangles];
+  unsigned int *output     = new unsigned int[numIndices];
+  memset(cacheTime,0,numVerticies * sizeof(unsigned int));
+  memset(emitted,0,numTriangles * sizeof(bool));
+  unsigned int timestamp   = cacheSize + 1;
+  unsigned int deadEndSize = 0;
+  unsigned int cursor      = 0;
+  unsigned int numOutput   = 0;
+
+  int fanning = getNextVertex(NULL,0,live,cacheTime,timestamp,cacheSize,deadEnd,deadEndSize,cursor,numVerticies);
+  while (fanning >= 0) {
+    // emit every remaining triangle around the fanning vertex
+    unsigned int numCandidates = 0;
+    for (unsigned int a = offsets[fanning] ; a < offsets[fanning + 1] ; a ++ ) {
+      unsigned int t = adjacency[a];
+      if (emitted[t]) continue;
+      emitted[t] = true;
+      for (unsigned int k = 0 ; k < 3 ; k ++ ) {
+        unsigned int v = indices[t * 3 + k] - firstVertex;
+        output[numOutput ++]          = v + firstVertex;
+        deadEnd[deadEndSize ++]       = v;
+        candidates[numCandidates ++]  = v;
+        live[v] --;
+        if (timestamp - cacheTime[v] > cacheSize) cacheTime[v] = timestamp ++;
+      }
+    }
+    fanning = getNextVertex(candidates,numCandidates,live,cacheTime,timestamp,cacheSize,deadEnd,deadEndSize,cursor,numVerticies);
+  }
+  memcpy(indices,output,numTriangles * 3 * sizeof(unsigned int));
+
+  delete [](live);
+  delete [](offsets);
+  delete [](adjacency);
+  delete [](cacheTime);
+  delete [](deadEnd);
+  delete [](candidates);
+  delete [](emitted);
+  delete [](output);
+}
+
+/* -------------------------------------------------------- */
+
+// Reorder verticies [firstVertex, firstVertex + numVerticies) by first use in 'indices',
+// unused verticies being moved to the end, and remap the indices accordingly
+void optimizeVertexFetch(t_point *verticies, unsigned int *indices, unsigned int numIndices, unsigned int firstVertex, unsigned int numVerticies)
+{
+  const unsigned int unassigned = 0xFFFFFFFF;
+  unsigned int *remap = new unsigned int[numVerticies];
+  memset(remap,0xFF,numVerticies * sizeof(unsigned int));
+  unsigned int next = 0;
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) {
+    unsigned int v = indices[i] - firstVertex;
+    if (remap[v] == unassigned) remap[v] = next ++;
+    indices[i] = remap[v] + firstVertex;
+  }
+  for (unsigned int v = 0 ; v < numVerticies ; v ++ ) {
+    if (remap[v] == unassigned) remap[v] = next ++;
+  }
+
+  t_point *source = new t_point[numVerticies];
+  memcpy(source,verticies + firstVertex,numVerticies * sizeof(t_point));
+  for (unsigned int v = 0 ; v < numVerticies ; v ++ ) verticies[firstVertex + remap[v]] = source[v];
+  delete [](source);
+  delete [](remap);
+}
+
+/* -------------------------------------------------------- */
+
+// Optimize every chunk of the mesh (or the whole mesh if it has no chunks)
+void optimizeMesh(t_mesh *mesh, unsigned int cacheSize)
+{
+  t_mesh_chunk whole = { 0, mesh->numVerticies, 0, mesh->numIndices };
+  const t_mesh_chunk *chunks = (mesh->numChunks > 0) ? mesh->chunks : &whole;
+  unsigned int numChunks     = (mesh->numChunks > 0) ? mesh->numChunks : 1;
+  for (unsigned int c = 0 ; c < numChunks ; c ++ ) {
+    const t_mesh_chunk &chunk = chunks[c];
+    unsigned int *indices = mesh->indices + chunk.firstIndex;
+    optimizeVertexCache(indices,chunk.numIndices,chunk.firstVertex,chunk.numVerticies,cacheSize);
+    optimizeVertexFetch(mesh->verticies,indices,chunk.numIndices,chunk.firstVertex,chunk.numVerticies);
+  }
+}
+
+/* -------------------------------------------------------- */
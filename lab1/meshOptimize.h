@@ -0,0 +1,35 @@
+/* -------------------------------------------------------- */
+/*
+
+Post-load mesh optimization
+
+- triangles are reordered for post-transform vertex cache reuse (Tipsify,
+  Sander et al. 2007, linear time),
+- verticies are then reordered by first use, so that vertex fetches walk
+  the vertex array almost sequentially.
+
+Both passes work chunk by chunk (see mesh.h) so that chunks stay
+self-contained, and modify the mesh in place.
+
+The cache efficiency is measured as the ACMR (average cache miss ratio:
+transformed verticies per triangle) of a FIFO cache.
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+#include "mesh.h"
+
+/* -------------------------------------------------------- */
+
+#define VERTEX_CACHE_SIZE 16
+
+/* -------------------------------------------------------- */
+
+float computeACMR(const unsigned int *indices, unsigned int numIndices, unsigned int numVerticies, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+void  optimizeVertexCache(unsigned int *indices, unsigned int numIndices, unsigned int firstVertex, unsigned int numVerticies, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+void  optimizeVertexFetch(t_point *verticies, unsigned int *indices, unsigned int numIndices, unsigned int firstVertex, unsigned int numVerticies);
+void  optimizeMesh(t_mesh *mesh, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+/* -------------------------------------------------------- */
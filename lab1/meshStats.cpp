@@ -0,0 +1,175 @@
+/* -------------------------------------------------------- */
+/*
+
+Mesh bounds and ingest statistics (see meshStats.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "meshStats.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#ifdef MESH_STATS_SSE
+#include <xmmintrin.h>
+#endif
+
+/* -------------------------------------------------------- */
+
+static bool isDegenerate(const t_point *verticies, const unsigned int *triangle)
+{
+  if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) return true;
+  const float *a = verticies[triangle[0]].p;
+  const float *b = verticies[triangle[1]].p;
+  const float *c = verticies[triangle[2]].p;
+  float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+  float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+  float n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+  return n[0] * n[0] + n[1] * n[1] + n[2] * n[2] == 0.0f;
+}
+
+/* -------------------------------------------------------- */
+
+void computeMeshStats(const t_mesh *mesh, t_mesh_stats *stats)
+{
+  const t_point *verticies = mesh->verticies;
+  int numVerticies = (int)mesh->numVerticies;
+  int numTriangles = (int)(mesh->numIndices / 3);
+
+  memset(stats,0,sizeof(t_mesh_stats));
+  stats->minNormalLength = FLT_MAX;
+  stats->maxNormalLength = 0.0f;
+  if (numVerticies == 0) {
+    stats->minNormalLength = 0.0f;
+    return;
+  }
+
+  // triangle sweep: degenerate triangles, and marks on the used verticies
+  // (threads may mark the same vertex concurrently, always with the same value)
+  unsigned char *used = new unsigned char[numVerticies];
+  memset(used,0,numVerticies);
+  unsigned int numDegenerate = 0;
+#pragma omp parallel for reduction(+:numDegenerate)
+  for (int t = 0 ; t < numTriangles ; t ++ ) {
+    const unsigned int *triangle = mesh->indices + 3 * t;
+    if (isDegenerate(verticies,triangle)) numDegenerate ++;
+    used[triangle[0]] = used[triangle[1]] = used[triangle[2]] = 1;
+  }
+  stats->numDegenerateTriangles = numDegenerate;
+
+  // vertex sweep: normal lengths and unused verticies (bounds are left to
+  // computeBounds), each thread reducing into its own partial results which
+  // are then merged
+#pragma omp parallel
+  {
+    float minNormal2 = FLT_MAX;
+    float maxNormal2 = 0.0f;
+    unsigned int numUnused = 0, numZero = 0, numNonUnit = 0;
+#pragma omp for nowait
+    for (int i = 0 ; i < numVerticies ; i ++ ) {
+      const t_point &v = verticies[i];
+      float normal2;
+#ifdef MESH_STATS_SSE
+      // normal lanes: n[0] n[1] n[2] (uv[0] ignored)
+      __m128 n  = _mm_loadu_ps(v.n);
+      __m128 n2 = _mm_mul_ps(n,n);
+      // sum of the first 3 lanes
+      __m128 sum = _mm_add_ss(n2,_mm_shuffle_ps(n2,n2,_MM_SHUFFLE(1,1,1,1)));
+      sum = _mm_add_ss(sum,_mm_movehl_ps(n2,n2));
+      normal2 = _mm_cvtss_f32(sum);
+#else
+      normal2 = v.n[0] * v.n[0] + v.n[1] * v.n[1] + v.n[2] * v.n[2];
+#endif
+      minNormal2 = (normal2 < minNormal2) ? normal2 : minNormal2;
+      maxNormal2 = (normal2 > maxNormal2) ? normal2 : maxNormal2;
+      // compare squared lengths: 1e-6^2 and (1 -+ 1e-3)^2
+      if      (normal2 < 1e-12f) numZero ++;
+      else if (normal2 < 0.998001f || normal2 > 1.002001f) numNonUnit ++;
+      if (!used[i]) numUnused ++;
+    }
+#pragma omp critical
+    {
+      if (minNormal2 < stats->minNormalLength) stats->minNormalLength = minNormal2;
+      if (maxNormal2 > stats->maxNormalLength) stats->maxNormalLength = maxNormal2;
+      stats->numUnusedVerticies += numUnused;
+      stats->numZeroNormals     += numZero;
+      stats->numNonUnitNormals  += numNonUnit;
+    }
+  }
+  // squared lengths were reduced
+  stats->minNormalLength = sqrtf(stats->minNormalLength);
+  stats->maxNormalLength = sqrtf(stats->maxNormalLength);
+  delete [](used);
+}
+
+/* -------------------------------------------------------- */
+
+// Bounds of 'numVerticies' positions, 'stride' floats apart
+void computeBounds(const float *positions, unsigned int stride, unsigned int numVerticies, float *minCoord, float *maxCoord)
+{
+  for (int k = 0 ; k < 3 ; k ++ ) {
+    minCoord[k] = (numVerticies > 0) ? FLT_MAX  : 0.0f;
+    maxCoord[k] = (numVerticies > 0) ? -FLT_MAX : 0.0f;
+  }
+  // packed positions are reduced by groups of 4 verticies (12 floats), the rest one by one
+  int numGroups = 0;
+#ifdef MESH_STATS_SSE
+  if (stride == 3) numGroups = (int)(numVerticies / 4);
+#endif
+#pragma omp parallel
+  {
+    float localMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float localMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+#ifdef MESH_STATS_SSE
+    // lanes: a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+    __m128 minA = _mm_set1_ps(FLT_MAX),  minB = minA, minC = minA;
+    __m128 maxA = _mm_set1_ps(-FLT_MAX), maxB = maxA, maxC = maxA;
+#pragma omp for nowait
+    for (int g = 0 ; g < numGroups ; g ++ ) {
+      const float *group = positions + 12 * g;
+      __m128 a = _mm_loadu_ps(group);
+      __m128 b = _mm_loadu_ps(group + 4);
+      __m128 c = _mm_loadu_ps(group + 8);
+      minA = _mm_min_ps(minA,a); maxA = _mm_max_ps(maxA,a);
+      minB = _mm_min_ps(minB,b); maxB = _mm_max_ps(maxB,b);
+      minC = _mm_min_ps(minC,c); maxC = _mm_max_ps(maxC,c);
+    }
+    float lanes[2][12];
+    _mm_storeu_ps(lanes[0],minA); _mm_storeu_ps(lanes[0] + 4,minB); _mm_storeu_ps(lanes[0] + 8,minC);
+    _mm_storeu_ps(lanes[1],maxA); _mm_storeu_ps(lanes[1] + 4,maxB); _mm_storeu_ps(lanes[1] + 8,maxC);
+    for (int l = 0 ; l < 12 ; l ++ ) {
+      localMin[l % 3] = (lanes[0][l] < localMin[l % 3]) ? lanes[0][l] : localMin[l % 3];
+      localMax[l % 3] = (lanes[1][l] > localMax[l % 3]) ? lanes[1][l] : localMax[l % 3];
+    }
+#endif
+#pragma omp for nowait
+    for (int i = 4 * numGroups ; i < (int)numVerticies ; i ++ ) {
+      const float *p = positions + (size_t)i * stride;
+      for (int k = 0 ; k < 3 ; k ++ ) {
+        localMin[k] = (p[k] < localMin[k]) ? p[k] : localMin[k];
+        localMax[k] = (p[k] > localMax[k]) ? p[k] : localMax[k];
+      }
+    }
+#pragma omp critical
+    {
+      for (int k = 0 ; k < 3 ; k ++ ) {
+        minCoord[k] = (localMin[k] < minCoord[k]) ? localMin[k] : minCoord[k];
+        maxCoord[k] = (localMax[k] > maxCoord[k]) ? localMax[k] : maxCoord[k];
+      }
+    }
+  }
+}
+
+/* -------------------------------------------------------- */
+
+void printMeshStats(const t_mesh_stats *stats)
+{
+  printf("degenerate tris   : %u\n",stats->numDegenerateTriangles);
+  printf("unused verticies  : %u\n",stats->numUnusedVerticies);
+  printf("normal lengths    : %g - %g (%u zero, %u non-unit)\n",
+         stats->minNormalLength,stats->maxNormalLength,stats->numZeroNormals,stats->numNonUnitNormals);
+}
+
+/* -------------------------------------------------------- */
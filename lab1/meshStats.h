@@ -0,0 +1,43 @@
+/* -------------------------------------------------------- */
+/*
+
+Mesh bounds and ingest statistics
+
+Statistics are computed with one parallel sweep over the triangles followed
+by one over the verticies (OpenMP), normals being processed 4 floats at a
+time with SSE when available.
+
+Bounds are computed separately by computeBounds, on a position stream of any
+stride (see meshStreams.h), packed SoA positions being reduced 4 verticies at
+a time.
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+#include "mesh.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MESH_STATS_SSE
+#endif
+
+/* -------------------------------------------------------- */
+
+typedef struct s_mesh_stats
+{
+  unsigned int numDegenerateTriangles;  // repeated vertex or zero area
+  unsigned int numUnusedVerticies;      // referenced by no triangle
+  unsigned int numZeroNormals;          // length below 1e-6
+  unsigned int numNonUnitNormals;       // length farther than 1e-3 from 1
+  float        minNormalLength;
+  float        maxNormalLength;
+} t_mesh_stats;
+
+/* -------------------------------------------------------- */
+
+void computeMeshStats(const t_mesh *mesh, t_mesh_stats *stats);
+void computeBounds(const float *positions, unsigned int stride, unsigned int numVerticies, float *minCoord, float *maxCoord);
+void printMeshStats(const t_mesh_stats *stats);
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,110 @@
+/* -------------------------------------------------------- */
+/*
+
+Vertex storage as interleaved t_point (AoS) or separate attribute streams (SoA)
+(see meshStreams.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "meshStreams.h"
+
+#include <cstring>
+
+/* -------------------------------------------------------- */
+
+// Wrap existing verticies (not copied, not owned) in the AoS layout
+void initMeshStreams(t_mesh_streams *streams, t_point *points, unsigned int numVerticies)
+{
+  memset(streams,0,sizeof(t_mesh_streams));
+  streams->layout       = MESH_LAYOUT_AOS;
+  streams->numVerticies = numVerticies;
+  streams->points       = points;
+  streams->ownsPoints   = false;
+}
+
+/* -------------------------------------------------------- */
+
+void freeMeshStreams(t_mesh_streams *streams)
+{
+  if (streams->ownsPoints) delete [](streams->points);
+  delete [](streams->positions);
+  delete [](streams->normals);
+  delete [](streams->uvs);
+  initMeshStreams(streams,NULL,0);
+}
+
+/* -------------------------------------------------------- */
+
+// Convert to the requested layout; the previous storage is released if owned
+void convertMeshStreams(t_mesh_streams *streams, t_mesh_layout layout)
+{
+  if (streams->layout == layout) return;
+  int n = (int)streams->numVerticies;
+  if (layout == MESH_LAYOUT_SOA) {
+    streams->positions = new float[3 * n];
+    streams->normals   = new float[3 * n];
+    streams->uvs       = new float[2 * n];
+    const t_point *points = streams->points;
+#pragma omp parallel for
+    for (int i = 0 ; i < n ; i ++ ) {
+      memcpy(streams->positions + 3 * i,points[i].p, 3 * sizeof(float));
+      memcpy(streams->normals   + 3 * i,points[i].n, 3 * sizeof(float));
+      memcpy(streams->uvs       + 2 * i,points[i].uv,2 * sizeof(float));
+    }
+    if (streams->ownsPoints) delete [](streams->points);
+    streams->points     = NULL;
+    streams->ownsPoints = false;
+  } else {
+    t_point *points = new t_point[n];
+#pragma omp parallel for
+    for (int i = 0 ; i < n ; i ++ ) {
+      memcpy(points[i].p, streams->positions + 3 * i,3 * sizeof(float));
+      memcpy(points[i].n, streams->normals   + 3 * i,3 * sizeof(float));
+      memcpy(points[i].uv,streams->uvs       + 2 * i,2 * sizeof(float));
+    }
+    delete [](streams->positions);
+    delete [](streams->normals);
+    delete [](streams->uvs);
+    streams->positions  = NULL;
+    streams->normals    = NULL;
+    streams->uvs        = NULL;
+    streams->points     = points;
+    streams->ownsPoints = true;
+  }
+  streams->layout = layout;
+}
+
+/* -------------------------------------------------------- */
+
+const float *getPositions(const t_mesh_streams *streams, unsigned int *stride)
+{
+  if (streams->layout == MESH_LAYOUT_SOA) {
+    *stride = 3;
+    return streams->positions;
+  }
+  *stride = sizeof(t_point) / sizeof(float);
+  return streams->points ? streams->points->p : NULL;
+}
+
+const float *getNormals(const t_mesh_streams *streams, unsigned int *stride)
+{
+  if (streams->layout == MESH_LAYOUT_SOA) {
+    *stride = 3;
+    return streams->normals;
+  }
+  *stride = sizeof(t_point) / sizeof(float);
+  return streams->points ? streams->points->n : NULL;
+}
+
+const float *getUVs(const t_mesh_streams *streams, unsigned int *stride)
+{
+  if (streams->layout == MESH_LAYOUT_SOA) {
+    *stride = 2;
+    return streams->uvs;
+  }
+  *stride = sizeof(t_point) / sizeof(float);
+  return streams->points ? streams->points->uv : NULL;
+}
+
+/* -------------------------------------------------------- */
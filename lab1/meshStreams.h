@@ -0,0 +1,52 @@
+/* -------------------------------------------------------- */
+/*
+
+Vertex storage as interleaved t_point (AoS) or separate attribute streams (SoA)
+
+In the SoA layout, positions, normals and texture coordinates are three
+tightly packed arrays (xyz xyz ..., xyz xyz ..., uv uv ...), so CPU passes
+that only need positions read 12 bytes per vertex instead of 32.
+
+Passes and the GPU upload address an attribute through a base pointer and
+a stride (in floats) which are valid for both layouts, see getPositions,
+getNormals and getUVs.
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+#include "mesh.h"
+
+/* -------------------------------------------------------- */
+
+typedef enum e_mesh_layout
+{
+  MESH_LAYOUT_AOS,
+  MESH_LAYOUT_SOA
+} t_mesh_layout;
+
+typedef struct s_mesh_streams
+{
+  t_mesh_layout layout;
+  unsigned int  numVerticies;
+  // AoS
+  t_point      *points;
+  bool          ownsPoints;   // false when wrapping the verticies of a t_mesh
+  // SoA
+  float        *positions;    // 3 floats per vertex
+  float        *normals;      // 3 floats per vertex
+  float        *uvs;          // 2 floats per vertex
+} t_mesh_streams;
+
+/* -------------------------------------------------------- */
+
+void initMeshStreams(t_mesh_streams *streams, t_point *points, unsigned int numVerticies);
+void freeMeshStreams(t_mesh_streams *streams);
+void convertMeshStreams(t_mesh_streams *streams, t_mesh_layout layout);
+
+const float *getPositions(const t_mesh_streams *streams, unsigned int *stride);
+const float *getNormals  (const t_mesh_streams *streams, unsigned int *stride);
+const float *getUVs      (const t_mesh_streams *streams, unsigned int *stride);
+
+/* -------------------------------------------------------- */
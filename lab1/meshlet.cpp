@@ -0,0 +1,237 @@
+/* -------------------------------------------------------- */
+/*
+
+Meshlets: small triangle clusters culled as a whole on the CPU (see meshlet.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "meshlet.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+/* -------------------------------------------------------- */
+
+static int compareTriangles(const void *a, const void *b)
+{
+  unsigned int ta = *(const unsigned int *)a, tb = *(const unsigned int *)b;
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+// Bounding sphere and normal cone of the triangles of a cluster
+static void computeMeshletBounds(const float *positions, unsigned int stride, const unsigned int *indices, t_meshlet *meshlet)
+{
+  const unsigned int *tris = indices + meshlet->firstIndex;
+  unsigned int numTriangles = meshlet->numIndices / 3;
+  // sphere around the center of the bounding box
+  float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for (unsigned int i = 0 ; i < meshlet->numIndices ; i ++ ) {
+    const float *p = positions + (size_t)tris[i] * stride;
+    for (int k = 0 ; k < 3 ; k ++ ) {
+      if (p[k] < min[k]) min[k] = p[k];
+      if (p[k] > max[k]) max[k] = p[k];
+    }
+  }
+  float radius2 = 0.0f;
+  for (int k = 0 ; k < 3 ; k ++ ) meshlet->center[k] = (min[k] + max[k]) * 0.5f;
+  for (unsigned int i = 0 ; i < meshlet->numIndices ; i ++ ) {
+    const float *p = positions + (size_t)tris[i] * stride;
+    float d[3] = { p[0] - meshlet->center[0], p[1] - meshlet->center[1], p[2] - meshlet->center[2] };
+    float d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+    if (d2 > radius2) radius2 = d2;
+  }
+  meshlet->radius = sqrtf(radius2);
+  // cone axis: average of the unit face normals (counter-clockwise front faces)
+  float *normals = new float[3 * numTriangles];
+  float axis[3] = { 0.0f, 0.0f, 0.0f };
+  for (unsigned int t = 0 ; t < numTriangles ; t ++ ) {
+    const float *a = positions + (size_t)tris[3 * t]     * stride;
+    const float *b = positions + (size_t)tris[3 * t + 1] * stride;
+    const float *c = positions + (size_t)tris[3 * t + 2] * stride;
+    float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    float *n = normals + 3 * t;
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float inv = (length > 0.0f) ? 1.0f / length : 0.0f;
+    for (int k = 0 ; k < 3 ; k ++ ) {
+      n[k] *= inv;
+      axis[k] += n[k];
+    }
+  }
+  float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  float inv = (length > 0.0f) ? 1.0f / length : 0.0f;
+  for (int k = 0 ; k < 3 ; k ++ ) meshlet->coneAxis[k] = axis[k] * inv;
+  // half angle: the widest normal, degenerate triangles being ignored
+  float minDot = 1.0f;
+  for (unsigned int t = 0 ; t < numTriangles ; t ++ ) {
+    const float *n = normals + 3 * t;
+    if (n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f) continue;
+    float d = n[0] * meshlet->coneAxis[0] + n[1] * meshlet->coneAxis[1] + n[2] * meshlet->coneAxis[2];
+    if (d < minDot) minDot = d;
+  }
+  // a cone of 90 degrees or more can always see the eye
+  meshlet->coneCutoff = (length > 0.0f && minDot > 0.0f) ? sqrtf(1.0f - minDot * minDot) : 2.0f;
+  delete [](normals);
+}
+
+/* -------------------------------------------------------- */
+
+void buildMeshlets(const float *positions, unsigned int stride, unsigned int numVerticies,
+                   unsigned int *indices, unsigned int numIndices, t_meshlet_set *set)
+{
+  unsigned int numTriangles = numIndices / 3;
+  // triangles around each vertex
+  unsigned int *firstTriangle = new unsigned int[numVerticies + 1];
+  unsigned int *triangles     = new unsigned int[numIndices > 0 ? numIndices : 1];
+  memset(firstTriangle,0,(numVerticies + 1) * sizeof(unsigned int));
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) firstTriangle[indices[i] + 1] ++;
+  for (unsigned int v = 0 ; v < numVerticies ; v ++ ) firstTriangle[v + 1] += firstTriangle[v];
+  unsigned int *fill = new unsigned int[numVerticies];
+  memcpy(fill,firstTriangle,numVerticies * sizeof(unsigned int));
+  for (unsigned int i = 0 ; i < numIndices ; i ++ ) triangles[fill[indices[i]] ++] = i / 3;
+  delete [](fill);
+
+  bool         *assigned    = new bool[numTriangles > 0 ? numTriangles : 1];
+  unsigned int *inMeshlet   = new unsigned int[numVerticies];  // 1 + id of the last cluster using the vertex
+  unsigned int *order       = new unsigned int[numTriangles > 0 ? numTriangles : 1];
+  memset(assigned,0,numTriangles * sizeof(bool));
+  memset(inMeshlet,0,numVerticies * sizeof(unsigned int));
+  // at most one cluster per triangle
+  set->meshlets    = new t_meshlet[numTriangles > 0 ? numTriangles : 1];
+  set->numMeshlets = 0;
+
+  unsigned int numOrdered = 0;
+  for (unsigned int seed = 0 ; seed < numTriangles ; seed ++ ) {
+    if (assigned[seed]) continue;
+    unsigned int  id = set->numMeshlets + 1;
+    unsigned int  verticies[MESHLET_MAX_VERTICIES];
+    unsigned int  numMeshletVerticies = 0;
+    unsigned int *meshletTriangles = order + numOrdered;
+    unsigned int  numMeshletTriangles = 0;
+    unsigned int  next = seed;
+    do {
+      // add the triangle
+      assigned[next] = true;
+      meshletTriangles[numMeshletTriangles ++] = next;
+      for (int k = 0 ; k < 3 ; k ++ ) {
+        unsigned int v = indices[3 * next + k];
+        if (inMeshlet[v] != id) {
+          inMeshlet[v] = id;
+          verticies[numMeshletVerticies ++] = v;
+        }
+      }
+      if (numMeshletTriangles == MESHLET_MAX_TRIANGLES) break;
+      // grow along the cluster verticies, adding as few new verticies as possible
+      unsigned int bestNew = 4;
+      next = numTriangles;
+      for (unsigned int i = 0 ; i < numMeshletVerticies && bestNew > 0 ; i ++ ) {
+        unsigned int v = verticies[i];
+        for (unsigned int j = firstTriangle[v] ; j < firstTriangle[v + 1] ; j ++ ) {
+          unsigned int t = triangles[j];
+          if (assigned[t]) continue;
+          unsigned int numNew = (inMeshlet[indices[3 * t]] != id) + (inMeshlet[indices[3 * t + 1]] != id) + (inMeshlet[indices[3 * t + 2]] != id);
+          if (numMeshletVerticies + numNew > MESHLET_MAX_VERTICIES) continue;
+          if (numNew < bestNew || (numNew == bestNew && t < next)) {
+            bestNew = numNew;
+            next    = t;
+          }
+        }
+      }
+    } while (next < numTriangles);
+    // keep the original (vertex cache friendly) order inside the cluster
+    qsort(meshletTriangles,numMeshletTriangles,sizeof(unsigned int),compareTriangles);
+    t_meshlet &meshlet = set->meshlets[set->numMeshlets ++];
+    meshlet.firstIndex = 3 * numOrdered;
+    meshlet.numIndices = 3 * numMeshletTriangles;
+    numOrdered += numMeshletTriangles;
+  }
+
+  // reorder the index array cluster by cluster
+  unsigned int *reordered = new unsigned int[numIndices > 0 ? numIndices : 1];
+  for (unsigned int t = 0 ; t < numTriangles ; t ++ ) {
+    memcpy(reordered + 3 * t,indices + 3 * order[t],3 * sizeof(unsigned int));
+  }
+  memcpy(indices,reordered,numTriangles * 3 * sizeof(unsigned int));
+  delete [](reordered);
+
+  int numMeshlets = (int)set->numMeshlets;
+#pragma omp parallel for
+  for (int m = 0 ; m < numMeshlets ; m ++ ) {
+    computeMeshletBounds(positions,stride,indices,set->meshlets + m);
+  }
+
+  delete [](firstTriangle);
+  delete [](triangles);
+  delete [](assigned);
+  delete [](inMeshlet);
+  delete [](order);
+}
+
+/* -------------------------------------------------------- */
+
+void freeMeshlets(t_meshlet_set *set)
+{
+  delete [](set->meshlets);
+  set->meshlets    = NULL;
+  set->numMeshlets = 0;
+}
+
+/* -------------------------------------------------------- */
+
+unsigned int cullMeshlets(const t_meshlet_set *set, const double *modelView, const double *projection, unsigned char *visible)
+{
+  // frustum planes in object space, from the rows of projection * modelView
+  double clip[16];
+  for (int c = 0 ; c < 4 ; c ++ ) {
+    for (int r = 0 ; r < 4 ; r ++ ) {
+      clip[c * 4 + r] = projection[r]     * modelView[c * 4]
+                      + projection[4 + r] * modelView[c * 4 + 1]
+                      + projection[8 + r] * modelView[c * 4 + 2]
+                      + projection[12 + r]* modelView[c * 4 + 3];
+    }
+  }
+  float planes[6][4];
+  for (int p = 0 ; p < 6 ; p ++ ) {
+    int    row  = p / 2;
+    double sign = (p & 1) ? -1.0 : 1.0;
+    double plane[4];
+    for (int c = 0 ; c < 4 ; c ++ ) plane[c] = clip[c * 4 + 3] + sign * clip[c * 4 + row];
+    double length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    for (int c = 0 ; c < 4 ; c ++ ) planes[p][c] = (float)(plane[c] / length);
+  }
+  // eye in object space, the modelview being a rigid transform: -R^T t
+  float eye[3];
+  for (int k = 0 ; k < 3 ; k ++ ) {
+    eye[k] = (float)-(modelView[k * 4] * modelView[12] + modelView[k * 4 + 1] * modelView[13] + modelView[k * 4 + 2] * modelView[14]);
+  }
+
+  int numMeshlets = (int)set->numMeshlets;
+  int numVisible  = 0;
+#pragma omp parallel for reduction(+:numVisible)
+  for (int m = 0 ; m < numMeshlets ; m ++ ) {
+    const t_meshlet &meshlet = set->meshlets[m];
+    bool culled = false;
+    for (int p = 0 ; p < 6 && !culled ; p ++ ) {
+      float d = planes[p][0] * meshlet.center[0] + planes[p][1] * meshlet.center[1] + planes[p][2] * meshlet.center[2] + planes[p][3];
+      culled = (d < -meshlet.radius);
+    }
+    // every normal of the cone points away from the eye, seen from anywhere in the sphere
+    if (!culled && meshlet.coneCutoff <= 1.0f) {
+      float view[3] = { meshlet.center[0] - eye[0], meshlet.center[1] - eye[1], meshlet.center[2] - eye[2] };
+      float distance = sqrtf(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+      float d = view[0] * meshlet.coneAxis[0] + view[1] * meshlet.coneAxis[1] + view[2] * meshlet.coneAxis[2];
+      culled = (d >= meshlet.coneCutoff * distance + meshlet.radius);
+    }
+    visible[m] = culled ? 0 : 1;
+    numVisible += visible[m];
+  }
+  return numVisible;
+}
+
+/* -------------------------------------------------------- */
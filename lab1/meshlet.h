@@ -0,0 +1,53 @@
+/* -------------------------------------------------------- */
+/*
+
+Meshlets: small triangle clusters culled as a whole on the CPU
+
+An index array is partitioned into clusters of at most MESHLET_MAX_VERTICIES
+distinct verticies and MESHLET_MAX_TRIANGLES triangles, grown along shared
+verticies so that each cluster is spatially compact. The index array is
+reordered cluster by cluster (keeping the relative triangle order inside a
+cluster, hence most of the vertex cache optimization), so a cluster is a
+contiguous index range and consecutive visible clusters merge into a single
+draw call.
+
+Each cluster stores a bounding sphere, for frustum culling, and a cone
+bounding its face normals, for backface culling: a cluster is skipped when
+every one of its triangles faces away from the eye.
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+/* -------------------------------------------------------- */
+
+#define MESHLET_MAX_VERTICIES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+typedef struct s_meshlet
+{
+  float        center[3];     // bounding sphere
+  float        radius;
+  float        coneAxis[3];   // average face normal
+  float        coneCutoff;    // sine of the cone half angle, > 1 if the cluster cannot be backface culled
+  unsigned int firstIndex;
+  unsigned int numIndices;
+} t_meshlet;
+
+typedef struct s_meshlet_set
+{
+  t_meshlet    *meshlets;
+  unsigned int  numMeshlets;
+} t_meshlet_set;
+
+/* -------------------------------------------------------- */
+
+void buildMeshlets(const float *positions, unsigned int stride, unsigned int numVerticies,
+                   unsigned int *indices, unsigned int numIndices, t_meshlet_set *set);
+void freeMeshlets(t_meshlet_set *set);
+// modelView and projection are column-major OpenGL matrices; visible[i] is set
+// to 1 for the clusters to draw. Returns the number of visible clusters.
+unsigned int cullMeshlets(const t_meshlet_set *set, const double *modelView, const double *projection, unsigned char *visible);
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,347 @@
+/* -------------------------------------------------------- */
+/*
+
+Procedural RGBA textures with a CPU-built mip chain (see proceduralTexture.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "proceduralTexture.h"
+
+#include <cstring>
+#include <cmath>
+#ifdef TEXTURE_SSE
+#include <xmmintrin.h>
+#endif
+
+/* -------------------------------------------------------- */
+
+#define NOISE_OCTAVES 4
+#define KAISER_TAPS   6      // source texels per destination texel along each axis
+#define KAISER_ALPHA  4.0f
+
+/* -------------------------------------------------------- */
+
+// Lattice value of the noise in [0,1]
+static float latticeValue(int x, int y, int octave)
+{
+  unsigned int h = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)octave * 83492791u);
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  h ^= h >> 15;
+  return (h & 0xffffff) / 16777215.0f;
+}
+
+// 1 for odd integers, 0 for even ones
+static float parity(float n)
+{
+  float half = n * 0.5f;
+  return (half - floorf(half)) * 2.0f;
+}
+
+#ifdef TEXTURE_SSE
+// Floor of 4 floats below 2^22 in magnitude, rounding through the mantissa
+static inline __m128 floor4(__m128 v)
+{
+  const __m128 magic = _mm_set1_ps(12582912.0f);  // 1.5 * 2^23
+  __m128 r = _mm_sub_ps(_mm_add_ps(v,magic),magic);
+  return _mm_sub_ps(r,_mm_and_ps(_mm_cmpgt_ps(r,v),_mm_set1_ps(1.0f)));
+}
+
+static inline __m128 parity4(__m128 n)
+{
+  __m128 half = _mm_mul_ps(n,_mm_set1_ps(0.5f));
+  return _mm_mul_ps(_mm_sub_ps(half,floor4(half)),_mm_set1_ps(2.0f));
+}
+#endif
+
+/* -------------------------------------------------------- */
+
+// Evaluate row y of a pattern in [0,1], 'lattice' being width + 2 floats of scratch
+static void generateRow(t_texture_pattern pattern, unsigned int width, unsigned int height, unsigned int period,
+                        int y, float *row, float *lattice)
+{
+  int   w  = (int)width;
+  float fy = y + 0.5f;      // texel center
+  float invPeriod = 1.0f / period;
+#ifdef TEXTURE_SSE
+  const __m128 offsets = _mm_setr_ps(0.5f,1.5f,2.5f,3.5f);
+#endif
+  int x = 0;
+  if (pattern == TEXTURE_CHECKERBOARD) {
+    float cellY = floorf(fy * invPeriod);
+#ifdef TEXTURE_SSE
+    __m128 cy  = _mm_set1_ps(cellY);
+    __m128 inv = _mm_set1_ps(invPeriod);
+    for ( ; x + 4 <= w ; x += 4) {
+      __m128 fx = _mm_add_ps(offsets,_mm_set1_ps((float)x));
+      _mm_storeu_ps(row + x,parity4(_mm_add_ps(floor4(_mm_mul_ps(fx,inv)),cy)));
+    }
+#endif
+    for ( ; x < w ; x ++ ) row[x] = parity(floorf((x + 0.5f) * invPeriod) + cellY);
+  } else if (pattern == TEXTURE_CIRCLES) {
+    float dy  = (fy - height * 0.5f) * invPeriod;
+    float dy2 = dy * dy;
+    float cx  = width * 0.5f;
+#ifdef TEXTURE_SSE
+    __m128 c   = _mm_set1_ps(cx);
+    __m128 inv = _mm_set1_ps(invPeriod);
+    __m128 d2  = _mm_set1_ps(dy2);
+    for ( ; x + 4 <= w ; x += 4) {
+      __m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(offsets,_mm_set1_ps((float)x)),c),inv);
+      __m128 d  = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx,dx),d2));
+      _mm_storeu_ps(row + x,parity4(floor4(d)));
+    }
+#endif
+    for ( ; x < w ; x ++ ) {
+      float dx = ((x + 0.5f) - cx) * invPeriod;
+      row[x] = parity(floorf(sqrtf(dx * dx + dy2)));
+    }
+  } else {
+    // fractal value noise: octaves of halving cell size and amplitude
+    memset(row,0,width * sizeof(float));
+    unsigned int cell = period;
+    float amplitude = 0.5f, total = 0.0f;
+    for (int o = 0 ; o < NOISE_OCTAVES ; o ++ ) {
+      float invCell = 1.0f / cell;
+      float gy = fy * invCell;
+      float iy = floorf(gy);
+      float ty = gy - iy;
+      ty = ty * ty * (3.0f - 2.0f * ty);
+      // lattice interpolated along y once per row, so texels only interpolate along x
+      int numCells = (int)(width / cell) + 2;
+      for (int i = 0 ; i < numCells ; i ++ ) {
+        float a = latticeValue(i,(int)iy,o), b = latticeValue(i,(int)iy + 1,o);
+        lattice[i] = a + (b - a) * ty;
+      }
+      x = 0;
+#ifdef TEXTURE_SSE
+      __m128 inv   = _mm_set1_ps(invCell);
+      __m128 amp   = _mm_set1_ps(amplitude);
+      __m128 three = _mm_set1_ps(3.0f);
+      __m128 two   = _mm_set1_ps(2.0f);
+      for ( ; x + 4 <= w ; x += 4) {
+        __m128 gx = _mm_mul_ps(_mm_add_ps(offsets,_mm_set1_ps((float)x)),inv);
+        __m128 ix = floor4(gx);
+        __m128 t  = _mm_sub_ps(gx,ix);
+        t = _mm_mul_ps(_mm_mul_ps(t,t),_mm_sub_ps(three,_mm_mul_ps(two,t)));
+        float cells[4];
+        _mm_storeu_ps(cells,ix);
+        int c0 = (int)cells[0], c1 = (int)cells[1], c2 = (int)cells[2], c3 = (int)cells[3];
+        __m128 a = _mm_setr_ps(lattice[c0],    lattice[c1],    lattice[c2],    lattice[c3]);
+        __m128 b = _mm_setr_ps(lattice[c0 + 1],lattice[c1 + 1],lattice[c2 + 1],lattice[c3 + 1]);
+        __m128 v = _mm_add_ps(a,_mm_mul_ps(_mm_sub_ps(b,a),t));
+        _mm_storeu_ps(row + x,_mm_add_ps(_mm_loadu_ps(row + x),_mm_mul_ps(v,amp)));
+      }
+#endif
+      for ( ; x < w ; x ++ ) {
+        float gx = (x + 0.5f) * invCell;
+        float ix = floorf(gx);
+        float t  = gx - ix;
+        t = t * t * (3.0f - 2.0f * t);
+        int c = (int)ix;
+        row[x] += (lattice[c] + (lattice[c + 1] - lattice[c]) * t) * amplitude;
+      }
+      total     += amplitude;
+      amplitude *= 0.5f;
+      cell       = (cell > 1) ? cell / 2 : 1;
+    }
+    float invTotal = 1.0f / total;
+    for (x = 0 ; x < w ; x ++ ) row[x] *= invTotal;
+  }
+}
+
+/* -------------------------------------------------------- */
+
+void generateProceduralTexture(t_texture *texture, t_texture_pattern pattern, unsigned int width, unsigned int height, unsigned int period)
+{
+  if (period == 0) period = 1;
+  // room for the whole mip chain
+  unsigned int numLevels = 1;
+  for (unsigned int s = (width > height) ? width : height ; s > 1 ; s >>= 1) numLevels ++;
+  texture->levels    = new t_texture_level[numLevels];
+  memset(texture->levels,0,numLevels * sizeof(t_texture_level));
+  texture->numLevels = 1;
+  t_texture_level &level = texture->levels[0];
+  level.width  = width;
+  level.height = height;
+  level.data   = new unsigned char[(size_t)width * height * 4];
+
+  int h = (int)height;
+#pragma omp parallel
+  {
+    float *row     = new float[width];
+    float *lattice = new float[width + 2];
+#pragma omp for
+    for (int y = 0 ; y < h ; y ++ ) {
+      generateRow(pattern,width,height,period,y,row,lattice);
+      unsigned char *texel = level.data + (size_t)y * width * 4;
+      for (unsigned int x = 0 ; x < width ; x ++ ) {
+        float v = row[x];
+        v = (v < 0.0f) ? 0.0f : (v > 1.0f) ? 1.0f : v;
+        unsigned char grey = (unsigned char)(v * 255.0f + 0.5f);
+        texel[4 * x + 0] = grey;
+        texel[4 * x + 1] = grey;
+        texel[4 * x + 2] = grey;
+        texel[4 * x + 3] = 255;
+      }
+    }
+    delete [](row);
+    delete [](lattice);
+  }
+}
+
+/* -------------------------------------------------------- */
+
+// Filter taps wrap around the edges: the texture is repeated (GL_REPEAT),
+// so every level must tile like the base one
+static unsigned int wrapTexel(int i, unsigned int size)
+{
+  return (unsigned int)(((i % (int)size) + (int)size) % (int)size);
+}
+
+// Average of 2x2 texels (edges wrapped for odd or unit sizes)
+static void downsampleBox(const t_texture_level *src, t_texture_level *dst)
+{
+  int h = (int)dst->height;
+#pragma omp parallel for
+  for (int j = 0 ; j < h ; j ++ ) {
+    const unsigned char *row0 = src->data + (size_t)wrapTexel(2 * j,    src->height) * src->width * 4;
+    const unsigned char *row1 = src->data + (size_t)wrapTexel(2 * j + 1,src->height) * src->width * 4;
+    unsigned char *out = dst->data + (size_t)j * dst->width * 4;
+    for (unsigned int i = 0 ; i < dst->width ; i ++ ) {
+      unsigned int i0 = 4 * wrapTexel(2 * i,    src->width);
+      unsigned int i1 = 4 * wrapTexel(2 * i + 1,src->width);
+      for (int c = 0 ; c < 4 ; c ++ ) {
+        out[4 * i + c] = (unsigned char)((row0[i0 + c] + row0[i1 + c] + row1[i0 + c] + row1[i1 + c] + 2) >> 2);
+      }
+    }
+  }
+}
+
+/* -------------------------------------------------------- */
+
+static float besselI0(float x)
+{
+  float sum = 1.0f, term = 1.0f;
+  for (int k = 1 ; k < 20 ; k ++ ) {
+    float q = x / (2.0f * k);
+    term *= q * q;
+    sum  += term;
+  }
+  return sum;
+}
+
+// Sinc low-pass at half the source frequency, windowed by a Kaiser window
+static void computeKaiserWeights(float *weights)
+{
+  float sum = 0.0f;
+  for (int t = 0 ; t < KAISER_TAPS ; t ++ ) {
+    float x = t - (KAISER_TAPS - 1) * 0.5f;   // source texels from the destination texel center
+    float s = 3.14159265f * x * 0.5f;
+    float sinc = sinf(s) / s;                  // x is never 0 for an even number of taps
+    float r = x / (KAISER_TAPS * 0.5f);
+    weights[t] = sinc * besselI0(KAISER_ALPHA * sqrtf(1.0f - r * r)) / besselI0(KAISER_ALPHA);
+    sum += weights[t];
+  }
+  for (int t = 0 ; t < KAISER_TAPS ; t ++ ) weights[t] /= sum;
+}
+
+// Separable Kaiser filter: horizontal pass into floats, then vertical pass
+static void downsampleKaiser(const t_texture_level *src, t_texture_level *dst, const float *weights)
+{
+  float *tmp = new float[(size_t)src->height * dst->width * 4];
+  int sh = (int)src->height, dh = (int)dst->height;
+#pragma omp parallel
+  {
+    // source row as floats, padded with the wrapped texels of the other edge
+    // so that taps 2i .. 2i+5 of the padded row never need wrapping
+    unsigned int paddedWidth = src->width + KAISER_TAPS - 1;
+    float *padded = new float[paddedWidth * 4];
+#pragma omp for
+    for (int j = 0 ; j < sh ; j ++ ) {
+      const unsigned char *row = src->data + (size_t)j * src->width * 4;
+      for (unsigned int k = 0 ; k < paddedWidth ; k ++ ) {
+        const unsigned char *p = row + 4 * wrapTexel((int)k - (KAISER_TAPS / 2 - 1),src->width);
+        for (int c = 0 ; c < 4 ; c ++ ) padded[4 * k + c] = p[c];
+      }
+      float *out = tmp + (size_t)j * dst->width * 4;
+      for (unsigned int i = 0 ; i < dst->width ; i ++ ) {
+        const float *taps = padded + 8 * i;
+#ifdef TEXTURE_SSE
+        __m128 acc = _mm_setzero_ps();
+        for (int t = 0 ; t < KAISER_TAPS ; t ++ ) acc = _mm_add_ps(acc,_mm_mul_ps(_mm_loadu_ps(taps + 4 * t),_mm_set1_ps(weights[t])));
+        _mm_storeu_ps(out + 4 * i,acc);
+#else
+        float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int t = 0 ; t < KAISER_TAPS ; t ++ ) {
+          for (int c = 0 ; c < 4 ; c ++ ) acc[c] += taps[4 * t + c] * weights[t];
+        }
+        for (int c = 0 ; c < 4 ; c ++ ) out[4 * i + c] = acc[c];
+#endif
+      }
+    }
+    delete [](padded);
+  }
+#pragma omp parallel for
+  for (int j = 0 ; j < dh ; j ++ ) {
+    const float *rows[KAISER_TAPS];
+    for (int t = 0 ; t < KAISER_TAPS ; t ++ ) rows[t] = tmp + (size_t)wrapTexel(2 * j - 2 + t,src->height) * dst->width * 4;
+    unsigned char *out = dst->data + (size_t)j * dst->width * 4;
+    for (unsigned int i = 0 ; i < dst->width ; i ++ ) {
+      float texel[4];
+#ifdef TEXTURE_SSE
+      __m128 acc = _mm_setzero_ps();
+      for (int t = 0 ; t < KAISER_TAPS ; t ++ ) acc = _mm_add_ps(acc,_mm_mul_ps(_mm_loadu_ps(rows[t] + 4 * i),_mm_set1_ps(weights[t])));
+      // negative lobes can overshoot
+      acc = _mm_min_ps(_mm_max_ps(acc,_mm_setzero_ps()),_mm_set1_ps(255.0f));
+      _mm_storeu_ps(texel,acc);
+#else
+      for (int c = 0 ; c < 4 ; c ++ ) {
+        float acc = 0.0f;
+        for (int t = 0 ; t < KAISER_TAPS ; t ++ ) acc += rows[t][4 * i + c] * weights[t];
+        // negative lobes can overshoot
+        texel[c] = (acc < 0.0f) ? 0.0f : (acc > 255.0f) ? 255.0f : acc;
+      }
+#endif
+      for (int c = 0 ; c < 4 ; c ++ ) out[4 * i + c] = (unsigned char)(texel[c] + 0.5f);
+    }
+  }
+  delete [](tmp);
+}
+
+/* -------------------------------------------------------- */
+
+void buildMipChain(t_texture *texture, t_mip_filter filter)
+{
+  float weights[KAISER_TAPS];
+  computeKaiserWeights(weights);
+  // rebuild from levels[0]
+  for (unsigned int l = 1 ; l < texture->numLevels ; l ++ ) {
+    delete [](texture->levels[l].data);
+    texture->levels[l].data = NULL;
+  }
+  texture->numLevels = 1;
+  while (texture->levels[texture->numLevels - 1].width > 1 || texture->levels[texture->numLevels - 1].height > 1) {
+    const t_texture_level &src = texture->levels[texture->numLevels - 1];
+    t_texture_level       &dst = texture->levels[texture->numLevels];
+    dst.width  = (src.width  > 1) ? src.width  / 2 : 1;
+    dst.height = (src.height > 1) ? src.height / 2 : 1;
+    dst.data   = new unsigned char[(size_t)dst.width * dst.height * 4];
+    if (filter == MIP_FILTER_BOX) downsampleBox(&src,&dst);
+    else                          downsampleKaiser(&src,&dst,weights);
+    texture->numLevels ++;
+  }
+}
+
+/* -------------------------------------------------------- */
+
+void freeTexture(t_texture *texture)
+{
+  for (unsigned int l = 0 ; l < texture->numLevels ; l ++ ) delete [](texture->levels[l].data);
+  delete [](texture->levels);
+  texture->levels    = NULL;
+  texture->numLevels = 0;
+}
+
+/* -------------------------------------------------------- */
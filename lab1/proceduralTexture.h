@@ -0,0 +1,58 @@
+/* -------------------------------------------------------- */
+/*
+
+Procedural RGBA textures with a CPU-built mip chain
+
+Patterns (checkerboard, concentric circles, fractal value noise) are
+evaluated row by row in parallel (OpenMP), four pixels at a time with SSE
+when available. The mip chain is built by halving each level with either a
+2x2 box filter or a separable Kaiser-windowed sinc, which keeps more detail
+and aliases less on high-frequency patterns. Filters wrap around the edges
+so that every level tiles (the texture is used with GL_REPEAT).
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TEXTURE_SSE
+#endif
+
+/* -------------------------------------------------------- */
+
+typedef enum e_texture_pattern
+{
+  TEXTURE_CHECKERBOARD,
+  TEXTURE_CIRCLES,
+  TEXTURE_NOISE
+} t_texture_pattern;
+
+typedef enum e_mip_filter
+{
+  MIP_FILTER_BOX,
+  MIP_FILTER_KAISER
+} t_mip_filter;
+
+typedef struct s_texture_level
+{
+  unsigned int   width;
+  unsigned int   height;
+  unsigned char *data;        // RGBA, 4 bytes per texel
+} t_texture_level;
+
+typedef struct s_texture
+{
+  t_texture_level *levels;    // levels[0] is the full resolution
+  unsigned int     numLevels;
+} t_texture;
+
+/* -------------------------------------------------------- */
+
+// 'period' is the size in texels of a checker cell, ring or coarsest noise cell
+void generateProceduralTexture(t_texture *texture, t_texture_pattern pattern, unsigned int width, unsigned int height, unsigned int period);
+// Build every level down to 1x1 from levels[0]
+void buildMipChain(t_texture *texture, t_mip_filter filter);
+void freeTexture(t_texture *texture);
+
+/* -------------------------------------------------------- */
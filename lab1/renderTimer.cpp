@@ -0,0 +1,196 @@
+/* -------------------------------------------------------- */
+/*
+
+CPU and GPU timing of the render tasks of a frame (see renderTimer.h)
+
+*/
+/* -------------------------------------------------------- */
+
+#include "renderTimer.h"
+
+#include <GL/glu.h>         // OpenGL Utilities header
+#include <GL/glut.h>        // OpenGL Utility Toolkit header
+#include <glux.h>           // OpenGL extensions loader
+#include "GL_ARB_timer_query.h"
+GLUX_LOAD(GL_ARB_timer_query);
+
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+/* -------------------------------------------------------- */
+
+// Current time in ms
+static double now()
+{
+#ifdef _WIN32
+  static LARGE_INTEGER frequency = {0};
+  if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart * 1e3 / (double)frequency.QuadPart;
+#else
+  timeval tv;
+  gettimeofday(&tv,NULL);
+  return tv.tv_sec * 1e3 + tv.tv_usec * 1e-3;
+#endif
+}
+
+static void addSample(t_render_timer *timer, unsigned int frame, unsigned int task, double cpuTime, double gpuTime)
+{
+  if (timer->numSamples == timer->samplesCapacity) {
+    timer->samplesCapacity = (timer->samplesCapacity > 0) ? 2 * timer->samplesCapacity : 1024;
+    t_render_sample *samples = new t_render_sample[timer->samplesCapacity];
+    if (timer->samples != NULL) memcpy(samples,timer->samples,timer->numSamples * sizeof(t_render_sample));
+    delete [](timer->samples);
+    timer->samples = samples;
+  }
+  t_render_sample &sample = timer->samples[timer->numSamples ++];
+  sample.frame   = frame;
+  sample.task    = task;
+  sample.cpuTime = cpuTime;
+  sample.gpuTime = gpuTime;
+}
+
+/* -------------------------------------------------------- */
+
+void initRenderTimer(t_render_timer *timer, unsigned int numTasks, const char **taskNames)
+{
+  unsigned int numSlots = numTasks * RENDER_TIMER_QUERIES;
+  timer->numTasks        = numTasks;
+  timer->taskNames       = taskNames;
+  timer->gpuTimers       = GLUX_IS_AVAILABLE(GL_ARB_timer_query);
+  timer->queries         = NULL;
+  timer->queryFrames     = new unsigned int[numSlots];
+  timer->queryCpuTimes   = new double[numSlots];
+  timer->queryPending    = new bool[numSlots];
+  timer->lastCpuTime     = new double[numTasks];
+  timer->lastGpuTime     = new double[numTasks];
+  timer->frame           = 0;
+  timer->currentTask     = 0;
+  timer->taskStart       = 0.0;
+  timer->samples         = NULL;
+  timer->numSamples      = 0;
+  timer->samplesCapacity = 0;
+  memset(timer->queryPending,0,numSlots * sizeof(bool));
+  memset(timer->lastCpuTime,0,numTasks * sizeof(double));
+  memset(timer->lastGpuTime,0,numTasks * sizeof(double));
+  // without the extension, only CPU times are measured
+  if (timer->gpuTimers) {
+    timer->queries = new GLuint[numSlots];
+    glGenQueries(numSlots,timer->queries);
+  }
+}
+
+void freeRenderTimer(t_render_timer *timer)
+{
+  if (timer->queries != NULL) {
+    glDeleteQueries(timer->numTasks * RENDER_TIMER_QUERIES,timer->queries);
+    delete [](timer->queries);
+  }
+  delete [](timer->queryFrames);
+  delete [](timer->queryCpuTimes);
+  delete [](timer->queryPending);
+  delete [](timer->lastCpuTime);
+  delete [](timer->lastGpuTime);
+  delete [](timer->samples);
+  memset(timer,0,sizeof(t_render_timer));
+}
+
+/* -------------------------------------------------------- */
+
+void beginRenderTask(t_render_timer *timer, unsigned int task)
+{
+  timer->currentTask = task;
+  unsigned int slot = task * RENDER_TIMER_QUERIES + timer->frame % RENDER_TIMER_QUERIES;
+  // a query still without result after RENDER_TIMER_QUERIES frames is dropped rather than waited for
+  timer->queryPending[slot] = false;
+  if (timer->gpuTimers) glBeginQuery(GL_TIME_ELAPSED,timer->queries[slot]);
+  timer->taskStart = now();
+}
+
+void endRenderTask(t_render_timer *timer)
+{
+  unsigned int slot = timer->currentTask * RENDER_TIMER_QUERIES + timer->frame % RENDER_TIMER_QUERIES;
+  double cpuTime = now() - timer->taskStart;
+  timer->lastCpuTime[timer->currentTask] = cpuTime;
+  if (timer->gpuTimers) {
+    glEndQuery(GL_TIME_ELAPSED);
+    timer->queryFrames[slot]   = timer->frame;
+    timer->queryCpuTimes[slot] = cpuTime;
+    timer->queryPending[slot]  = true;
+  } else {
+    addSample(timer,timer->frame,timer->currentTask,cpuTime,-1.0);
+  }
+}
+
+// Read back the available query results, without waiting for the others
+void endRenderFrame(t_render_timer *timer)
+{
+  for (unsigned int slot = 0 ; slot < timer->numTasks * RENDER_TIMER_QUERIES ; slot ++ ) {
+    if (!timer->queryPending[slot]) continue;
+    GLint available = 0;
+    glGetQueryObjectiv(timer->queries[slot],GL_QUERY_RESULT_AVAILABLE,&available);
+    if (!available) continue;
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(timer->queries[slot],GL_QUERY_RESULT,&elapsed);
+    unsigned int task = slot / RENDER_TIMER_QUERIES;
+    timer->lastGpuTime[task]  = elapsed / 1e6;
+    timer->queryPending[slot] = false;
+    addSample(timer,timer->queryFrames[slot],task,timer->queryCpuTimes[slot],timer->lastGpuTime[task]);
+  }
+  timer->frame ++;
+}
+
+/* -------------------------------------------------------- */
+
+// Latest times of every task, one line each in the top left corner
+void drawRenderTimerOverlay(const t_render_timer *timer)
+{
+  glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+  glDisable(GL_LIGHTING);
+  glDisable(GL_TEXTURE_2D);
+  glDisable(GL_DEPTH_TEST);
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  int height = glutGet(GLUT_WINDOW_HEIGHT);
+  gluOrtho2D(0,glutGet(GLUT_WINDOW_WIDTH),0,height);
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  glColor3f(1,1,0);
+  for (unsigned int t = 0 ; t < timer->numTasks ; t ++ ) {
+    char text[128];
+    if (timer->gpuTimers) sprintf(text,"%-8s CPU %7.3f ms  GPU %7.3f ms",timer->taskNames[t],timer->lastCpuTime[t],timer->lastGpuTime[t]);
+    else                  sprintf(text,"%-8s CPU %7.3f ms",timer->taskNames[t],timer->lastCpuTime[t]);
+    glRasterPos2i(5,height - 15 * (t + 1));
+    for (const char *c = text ; *c != '\0' ; c ++ ) glutBitmapCharacter(GLUT_BITMAP_8_BY_13,*c);
+  }
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glPopAttrib();
+}
+
+bool exportRenderTimerCSV(const t_render_timer *timer, const char *filename)
+{
+  FILE *file = fopen(filename,"w");
+  if (file == NULL) {
+    fprintf(stderr,"[exportRenderTimerCSV] Cannot write %s\n",filename);
+    return false;
+  }
+  fprintf(file,"frame,task,cpu_ms,gpu_ms\n");
+  for (unsigned int i = 0 ; i < timer->numSamples ; i ++ ) {
+    const t_render_sample &s = timer->samples[i];
+    if (s.gpuTime >= 0.0) fprintf(file,"%u,%s,%.4f,%.4f\n",s.frame,timer->taskNames[s.task],s.cpuTime,s.gpuTime);
+    else                  fprintf(file,"%u,%s,%.4f,\n",s.frame,timer->taskNames[s.task],s.cpuTime);
+  }
+  fclose(file);
+  return true;
+}
+
+/* -------------------------------------------------------- */
@@ -0,0 +1,65 @@
+/* -------------------------------------------------------- */
+/*
+
+CPU and GPU timing of the render tasks of a frame
+
+Each task is timed on the CPU and, with GL_ARB_timer_query, on the GPU by a
+GL_TIME_ELAPSED query. Queries rotate over RENDER_TIMER_QUERIES frames so
+that results are read once available, without stalling the pipeline.
+Tasks must not overlap (elapsed time queries cannot be nested).
+
+Latest times can be drawn as an overlay; all samples are exported as CSV
+(one line per frame and task).
+
+*/
+/* -------------------------------------------------------- */
+
+#pragma once
+
+#include <windows.h>        // windows API header (required by gl.h)
+
+#include <GL/gl.h>          // OpenGL header
+
+/* -------------------------------------------------------- */
+
+#define RENDER_TIMER_QUERIES 4
+
+typedef struct s_render_sample
+{
+  unsigned int frame;
+  unsigned int task;
+  double       cpuTime;       // in ms
+  double       gpuTime;       // in ms, negative if not measured
+} t_render_sample;
+
+typedef struct s_render_timer
+{
+  unsigned int     numTasks;
+  const char     **taskNames;
+  bool             gpuTimers;     // GL_ARB_timer_query available
+  GLuint          *queries;       // RENDER_TIMER_QUERIES per task
+  unsigned int    *queryFrames;
+  double          *queryCpuTimes;
+  bool            *queryPending;
+  double          *lastCpuTime;
+  double          *lastGpuTime;
+  unsigned int     frame;
+  unsigned int     currentTask;
+  double           taskStart;
+  t_render_sample *samples;
+  unsigned int     numSamples;
+  unsigned int     samplesCapacity;
+} t_render_timer;
+
+/* -------------------------------------------------------- */
+
+// Must be called with a current GL context (after gluxInit)
+void initRenderTimer(t_render_timer *timer, unsigned int numTasks, const char **taskNames);
+void freeRenderTimer(t_render_timer *timer);
+void beginRenderTask(t_render_timer *timer, unsigned int task);
+void endRenderTask(t_render_timer *timer);
+void endRenderFrame(t_render_timer *timer);
+void drawRenderTimerOverlay(const t_render_timer *timer);
+bool exportRenderTimerCSV(const t_render_timer *timer, const char *filename);
+
+/* -------------------------------------------------------- */
@@ -80,7 +80,7 @@ Ex4)
     unsigned int    g_NumVerticies  = 0;      // number of verticies
     t_point        *g_Verticies     = NULL;   // verticies
     unsigned int    g_NumIndices    = 0;      // number of indices (= 3 * number of triangles)
-    unsigned short *g_Indices       = NULL;   // indices, 3 per triangles
+    unsigned int   *g_Indices       = NULL;   // indices, 3 per triangles
 
   - Uncomment line [4A]
   - Uncomment code to draw the IFS (marker [4B]).
@@ -95,13 +95,16 @@ Ex5)
 
 Ex6)
 
- Function 'createCheckerBoardTexture' generate a checkerboard texture (it returns the texture OpenGL id)
+ Function 'createProceduralTexture' generates a tiling procedural texture with its MIP-map levels
+ (it returns the texture OpenGL id). The pattern is chosen on the command line with
+ '-texture checkerboard|circles|noise' (see proceduralTexture.h).
 
  - Uncomment block [7A], test the program, notice the quad at the bottom left corner
  - What is the purpose of glPushAttrib(GL_ENABLE_BIT) ? (marker [7B])
- - Apply a checkboard texture to the quad
- - Apply a checkboard texture to the mesh
- - Change 'createCheckerBoardTexture' to replace the black part by the i,j coordinates within the texture
+ - Apply the procedural texture to the quad
+ - Apply the procedural texture to the mesh
+ - Add a pattern to 'generateProceduralTexture' replacing the black squares of the checkerboard
+   by the i,j coordinates within the texture
 
 Ex7)
 
@@ -115,9 +118,9 @@ Ex8)
 
 Ex9)
 
- - Create a new function 'createCirclesTexture' generating a 256x256 texture with 16 
-   concentric circles of alterning green/blue color (centered on the middle of the texture). 
- - Use key 's' to switch between this new texture and the checkerboard.
+ - Change the circles pattern (TEXTURE_CIRCLES) so that its 16 concentric circles alternate
+   green/blue instead of grey levels.
+ - Use key 's' to cycle through the patterns (checkerboard, circles, noise), recreating the texture.
 
 */
 /* -------------------------------------------------------- */
@@ -127,11 +130,28 @@ Ex9)
 #include <GL/gl.h>          // OpenGL header
 #include <GL/glu.h>         // OpenGL Utilities header
 #include <GL/glut.h>        // OpenGL Utility Toolkit header
+#include <glux.h>           // OpenGL extensions loader
+#include "GL_ARB_vertex_buffer_object.h"
+GLUX_LOAD(GL_ARB_vertex_buffer_object);
+#include "GL_EXT_texture_filter_anisotropic.h"
+GLUX_LOAD(GL_EXT_texture_filter_anisotropic);
 
 #include <cstdio>
+#include <cstddef>
+#include <cstring>
 #include <cmath>
 #include <iostream>
 
+#include "mesh.h"
+#include "meshOptimize.h"
+#include "meshStats.h"
+#include "meshStreams.h"
+#include "meshLOD.h"
+#include "bvh.h"
+#include "meshlet.h"
+#include "proceduralTexture.h"
+#include "renderTimer.h"
+
 using namespace std;
 
 /* -------------------------------------------------------- */
@@ -161,38 +181,166 @@ float g_objectMinCoords[][3] = {{0, 0, 0}, {0, 0, 0}};
 float g_objectMaxCoords[][3] = {{0, 0, 0}, {0, 0, 0}};
 float g_center[] = {0, 0, 0};
 GLuint g_tex;
+t_texture_pattern g_TexturePattern = TEXTURE_CHECKERBOARD;
+unsigned int      g_TextureSize    = 512;
 
 
 /* -------------------------------------------------------- */
 
-typedef struct s_point
-{
-  float p[3];
-  float n[3];
-  float uv[2];
-} t_point;
-
+t_mesh          g_Mesh;                   // loaded IFS, g_Verticies and g_Indices point into it
 t_point        *g_Verticies     = NULL;
-unsigned short *g_Indices       = NULL;
+unsigned int   *g_Indices       = NULL;
 unsigned int    g_NumVerticies  = 0;
 unsigned int    g_NumIndices    = 0;
 
+bool            g_OptimizeMesh  = true;   // reorder triangles and verticies after loading
+bool            g_UseSoA        = false;  // store verticies as separate attribute streams
+t_mesh_streams  g_Streams;                // vertex storage used for drawing (AoS wraps g_Verticies)
+GLuint          g_VertexBuffer  = 0;      // vertex buffer holding g_Streams (0 if unavailable)
+GLuint          g_IndexBuffer   = 0;      // index buffer holding g_Indices (0 if unavailable)
+const GLvoid   *g_AttributePointer[3];    // position, normal, uv (offsets into g_VertexBuffer if any)
+GLsizei         g_AttributeStride[3];     // in bytes
+
+unsigned int     g_MaxLODs       = 6;     // number of levels of detail, including the full mesh
+t_mesh_lod_chain g_LODs;                  // levels of detail, g_LODs.lods[0] being g_Indices
+unsigned int    *g_LODFirstIndex = NULL;  // offset of each level in g_IndexBuffer
+unsigned int     g_CurrentLOD    = 0;
+float            g_MaxPixelError = 1.0f;  // LOD selection threshold, in pixels
+t_meshlet_set   *g_Meshlets       = NULL; // clusters of each level of detail
+unsigned char   *g_MeshletVisible = NULL; // culling result of the drawn level
+bool             g_CullMeshlets   = true; // cull clusters against the frustum and their normal cone
+
+t_bvh            g_BVH;                   // hierarchy over the g_Indices triangles, for picking
+int              g_PickedTriangle = -1;   // triangle under the cursor on the last shift+click
+GLdouble         g_ModelView[16];         // object transform of the last frame, for unprojection
+GLdouble         g_Projection[16];
+GLint            g_Viewport[4];
+
+// timed parts of mainRender
+enum { RENDER_TASK_SETUP, RENDER_TASK_OBJECT, RENDER_TASK_OVERLAY, NUM_RENDER_TASKS };
+const char      *g_RenderTaskNames[NUM_RENDER_TASKS] = { "setup", "object", "overlay" };
+t_render_timer   g_RenderTimer;
+bool             g_ShowTimings    = true;  // draw the render times over the scene
+
 /* -------------------------------------------------------- */
 
-void getMinMaxCoords(t_point *verticies, int nVerticies, float *minCoord, float *maxCoord)
- {
+// Upload the IFS once into a vertex buffer and an index buffer. The vertex buffer holds
+// either the interleaved t_point array or the three attribute streams one after the other
+// (the data is read straight from the memory-mapped file when loadMesh could use it in place)
+void uploadIFS()
+{
+  unsigned int stride[3];
+  const float *attributes[3] = { getPositions(&g_Streams,&stride[0]), getNormals(&g_Streams,&stride[1]), getUVs(&g_Streams,&stride[2]) };
+  for (int k = 0 ; k < 3 ; k ++ ) {
+    g_AttributePointer[k] = attributes[k];
+    g_AttributeStride[k]  = stride[k] * sizeof(float);
+  }
+  if (!GLUX_IS_AVAILABLE(GL_ARB_vertex_buffer_object)) {
+    cerr << "[uploadIFS] Vertex buffers unavailable, drawing from client memory" << endl;
+    return;
+  }
+  glGenBuffersARB(1,&g_VertexBuffer);
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB,g_VertexBuffer);
+  if (g_Streams.layout == MESH_LAYOUT_AOS) {
+    glBufferDataARB(GL_ARRAY_BUFFER_ARB,g_Streams.numVerticies*sizeof(t_point),g_Streams.points,GL_STATIC_DRAW_ARB);
+    for (int k = 0 ; k < 3 ; k ++ ) g_AttributePointer[k] = (const GLvoid *)((const char *)attributes[k] - (const char *)g_Streams.points);
+  } else {
+    size_t offset = 0;
+    glBufferDataARB(GL_ARRAY_BUFFER_ARB,g_Streams.numVerticies*sizeof(t_point),NULL,GL_STATIC_DRAW_ARB);
+    for (int k = 0 ; k < 3 ; k ++ ) {
+      size_t size = g_Streams.numVerticies * g_AttributeStride[k];
+      glBufferSubDataARB(GL_ARRAY_BUFFER_ARB,offset,size,attributes[k]);
+      g_AttributePointer[k] = (const GLvoid *)offset;
+      offset += size;
+    }
+  }
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
+  // all levels of detail share the vertex buffer and follow each other in the index buffer
+  unsigned int numIndices = 0;
+  g_LODFirstIndex = new unsigned int[g_LODs.numLods];
+  for (unsigned int l = 0 ; l < g_LODs.numLods ; l ++ ) {
+    g_LODFirstIndex[l] = numIndices;
+    numIndices += g_LODs.lods[l].numIndices;
+  }
+  glGenBuffersARB(1,&g_IndexBuffer);
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,g_IndexBuffer);
+  glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB,numIndices*sizeof(unsigned int),NULL,GL_STATIC_DRAW_ARB);
+  for (unsigned int l = 0 ; l < g_LODs.numLods ; l ++ ) {
+    glBufferSubDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB,g_LODFirstIndex[l]*sizeof(unsigned int),g_LODs.lods[l].numIndices*sizeof(unsigned int),g_LODs.lods[l].indices);
+  }
+  glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,0);
+}
 
-	for (int j = 0; j < 3; j++)
-	{
-		 minCoord[j] = verticies[0].p[j];
-	     maxCoord[j] = verticies[0].p[j];
-		 for (int i = 0; i < nVerticies; i++)
-		 {
-				minCoord[j] = min(verticies[i].p[j], minCoord[j]);
-				maxCoord[j] = max(verticies[i].p[j], maxCoord[j]);		 
-		 }
-	}
- }
+/* -------------------------------------------------------- */
+
+// Draw a level of detail of the IFS (from the buffers if uploaded, otherwise
+// from client memory): one glDrawElements call per run of visible clusters
+void drawIFS(unsigned int lod)
+{
+  const GLvoid *indexBase = g_LODs.lods[lod].indices;
+  if (g_VertexBuffer != 0) {
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB,g_VertexBuffer);
+    glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,g_IndexBuffer);
+    // pointers are now offsets into the bound buffers
+    indexBase = (const GLvoid *)(g_LODFirstIndex[lod]*sizeof(unsigned int));
+  }
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glVertexPointer  (3,GL_FLOAT,g_AttributeStride[0],g_AttributePointer[0]);
+  glNormalPointer  (  GL_FLOAT,g_AttributeStride[1],g_AttributePointer[1]);
+  glTexCoordPointer(2,GL_FLOAT,g_AttributeStride[2],g_AttributePointer[2]);
+  if (g_Meshlets != NULL && g_CullMeshlets) {
+    const t_meshlet_set &set = g_Meshlets[lod];
+    cullMeshlets(&set,g_ModelView,g_Projection,g_MeshletVisible);
+    // clusters are consecutive in the index array, merge the adjacent visible ones
+    unsigned int m = 0;
+    while (m < set.numMeshlets) {
+      if (!g_MeshletVisible[m]) { m ++; continue; }
+      unsigned int first = set.meshlets[m].firstIndex, count = 0;
+      while (m < set.numMeshlets && g_MeshletVisible[m]) count += set.meshlets[m ++].numIndices;
+      glDrawElements(GL_TRIANGLES,count,GL_UNSIGNED_INT,(const char *)indexBase + first*sizeof(unsigned int));
+    }
+  } else {
+    glDrawElements(GL_TRIANGLES,g_LODs.lods[lod].numIndices,GL_UNSIGNED_INT,indexBase);
+  }
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  if (g_VertexBuffer != 0) {
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
+    glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,0);
+  }
+}
+
+/* -------------------------------------------------------- */
+
+// Select the triangle under window coordinates x,y (ray cast through the BVH)
+void pickTriangle(int x,int y)
+{
+  if (g_BVH.numTriangles == 0) return;
+  // unproject the cursor on the near and far planes, in object space
+  GLdouble nearPoint[3], farPoint[3];
+  GLdouble winY = g_Viewport[3] - 1 - y;
+  gluUnProject(x,winY,0.0,g_ModelView,g_Projection,g_Viewport,&nearPoint[0],&nearPoint[1],&nearPoint[2]);
+  gluUnProject(x,winY,1.0,g_ModelView,g_Projection,g_Viewport,&farPoint[0],&farPoint[1],&farPoint[2]);
+  float origin[3], direction[3];
+  for (int k = 0 ; k < 3 ; k ++ ) {
+    origin[k]    = (float)nearPoint[k];
+    direction[k] = (float)(farPoint[k] - nearPoint[k]);
+  }
+  t_bvh_hit hit;
+  if (intersectRay(&g_BVH,origin,direction,1.0f,&hit)) {
+    g_PickedTriangle = hit.triangle;
+    printf("Picked triangle %u at %f,%f,%f\n",hit.triangle,
+      origin[0] + hit.t*direction[0],origin[1] + hit.t*direction[1],origin[2] + hit.t*direction[2]);
+  } else {
+    g_PickedTriangle = -1;
+    printf("No triangle under the cursor\n");
+  }
+}
+
+/* -------------------------------------------------------- */
 
 void mainKeyboard(unsigned char key, int x, int y) 
 {
@@ -202,6 +350,13 @@ void mainKeyboard(unsigned char key, int x, int y)
   if (key == 'w') {
     g_WireframeMode=!g_WireframeMode;
   } 
+  if (key == 't') {
+    g_ShowTimings=!g_ShowTimings;
+  } 
+  if (key == 'm') {
+    g_CullMeshlets=!g_CullMeshlets;
+    printf("cluster culling %s\n",g_CullMeshlets ? "on" : "off");
+  } 
   if(key == '1') {
 	  g_material_diffuse[0] = g_material_diffuse[1] = 1;
 	  g_material_diffuse[2] = 0;
@@ -251,7 +406,10 @@ void mainKeyboard(unsigned char key, int x, int y)
 void mainMouse(int btn, int state, int x, int y) 
 {
   if (state == GLUT_DOWN) {
-    if (btn == GLUT_LEFT_BUTTON) {
+    if (btn == GLUT_LEFT_BUTTON && (glutGetModifiers() & GLUT_ACTIVE_SHIFT)) {
+      // shift + left click picks a triangle instead of zooming
+      if (g_objectId == 1) pickTriangle(x,y);
+    } else if (btn == GLUT_LEFT_BUTTON) {
       printf("Left mouse button pressed at coordinates %d,%d\n",x,y);
       g_LeftButtonPressed  = true;
       g_MouseX = x;
@@ -322,6 +480,7 @@ void mainReshape(int w,int h)
 
 void mainRender()
 {
+	beginRenderTask(&g_RenderTimer,RENDER_TASK_SETUP);
 	glEnable(GL_LIGHT0);
 	glEnable(GL_LIGHT1);
 	glEnable(GL_LIGHT2);
@@ -376,6 +535,13 @@ void mainRender()
   gluLookAt(g_Zoom*2.5,g_Zoom*2.5,0.5f, g_center[0],g_center[1],g_center[2], 0,0,1);
   // rotate object around z axis (up)
   glRotated(g_Rotate*20.0f,0,0,1);
+  // keep the transform for picking
+  glGetDoublev(GL_MODELVIEW_MATRIX,g_ModelView);
+  glGetDoublev(GL_PROJECTION_MATRIX,g_Projection);
+  glGetIntegerv(GL_VIEWPORT,g_Viewport);
+
+  endRenderTask(&g_RenderTimer);
+  beginRenderTask(&g_RenderTimer,RENDER_TASK_OBJECT);
 
   // wireframe mode
   if (g_WireframeMode) {
@@ -395,19 +561,40 @@ void mainRender()
 	  // [4B]
 	  // Draw IFS
       glBindTexture (GL_TEXTURE_2D, g_tex);
-	  glBegin(GL_TRIANGLES);
-	  for (int t = 0 ; t < g_NumIndices/3 ; t ++ ) {
-		for (int i = 0 ; i < 3 ; i ++ ) {
-		  glVertex3fv( g_Verticies[ g_Indices[t*3 + i] ].p );
-		  glTexCoord2fv(g_Verticies[ g_Indices[t*3 + i] ].uv);
-		  glNormal3fv(g_Verticies[ g_Indices[t*3 + i] ].n);
-		}
+	  // coarsest level of detail whose error stays below g_MaxPixelError once projected
+	  if (g_LODs.numLods > 0) {
+		  float eye[3] = { g_Zoom*2.5f - g_center[0], g_Zoom*2.5f - g_center[1], 0.5f - g_center[2] };
+		  float distance = sqrtf(eye[0]*eye[0] + eye[1]*eye[1] + eye[2]*eye[2]);
+		  unsigned int lod = selectLOD(&g_LODs, distance, 45.0f, (float)g_H, g_MaxPixelError);
+		  if (lod != g_CurrentLOD) {
+			  g_CurrentLOD = lod;
+			  printf("LOD %u (%u triangles)\n", lod, g_LODs.lods[lod].numIndices/3);
+		  }
+		  drawIFS(lod);
+	  }
+	  // highlight the picked triangle (full resolution mesh)
+	  if (g_PickedTriangle >= 0) {
+		  unsigned int stride;
+		  const float *positions = getPositions(&g_Streams,&stride);
+		  glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+		  glDisable(GL_LIGHTING);
+		  glDisable(GL_TEXTURE_2D);
+		  glDisable(GL_DEPTH_TEST);
+		  glColor3f(1,0,0);
+		  glBegin(GL_TRIANGLES);
+		  for (int k = 0 ; k < 3 ; k ++ ) {
+			  glVertex3fv(positions + g_Indices[3*g_PickedTriangle + k]*stride);
+		  }
+		  glEnd();
+		  glPopAttrib();
 	  }
-	  glEnd();
   }
   
 
 
+  endRenderTask(&g_RenderTimer);
+  beginRenderTask(&g_RenderTimer,RENDER_TASK_OVERLAY);
+
   // [7A] draw an on-screen quad in the top left corner
  
 
@@ -429,6 +616,9 @@ void mainRender()
   glEnd();
   glPopAttrib();
 
+  endRenderTask(&g_RenderTimer);
+  if (g_ShowTimings) drawRenderTimerOverlay(&g_RenderTimer);
+  endRenderFrame(&g_RenderTimer);
 
   // swap
   glutSwapBuffers();
@@ -436,6 +626,14 @@ void mainRender()
 
 /* -------------------------------------------------------- */
 
+// per-frame CPU / GPU times of mainRender, saved however the program exits
+void exportRenderTimes()
+{
+  if (exportRenderTimerCSV(&g_RenderTimer,"renderTimes.csv")) printf("Render times saved to renderTimes.csv\n");
+}
+
+/* -------------------------------------------------------- */
+
 void idle( void )
 {
   // whenever the application has free time, ask for a screen refresh
@@ -444,55 +642,97 @@ void idle( void )
 
 /* -------------------------------------------------------- */
 
-// Load an IFS
-void loadIFS(const char *filename)
+// Load an IFS (legacy or versioned .mesh layout, see mesh.h)
+bool loadIFS(const char *filename)
 {
-  // open file
-  FILE *f=fopen(filename,"rb");
-  if (f == NULL) {
-    // error?
+  if (!loadMesh(filename,&g_Mesh)) {
     cerr << "[loadIFS] Cannot load " << filename << endl;
+    return false;
+  }
+  // reorder for the post-transform vertex cache and vertex fetches
+  if (g_OptimizeMesh && g_Mesh.numIndices > 0) {
+    float before = computeACMR(g_Mesh.indices,g_Mesh.numIndices,g_Mesh.numVerticies);
+    optimizeMesh(&g_Mesh);
+    float after  = computeACMR(g_Mesh.indices,g_Mesh.numIndices,g_Mesh.numVerticies);
+    cerr << "ACMR " << before << " -> " << after << " (FIFO cache of " << VERTEX_CACHE_SIZE << " verticies)" << endl;
   }
-  // read vertices
-  fread(&g_NumVerticies,sizeof(unsigned int),1,f);
-  g_Verticies = new t_point[g_NumVerticies];
-  fread(g_Verticies,sizeof(t_point),g_NumVerticies,f);
-  // read indices
-  fread(&g_NumIndices,sizeof(unsigned int),1,f);
-  g_Indices = new unsigned short[g_NumIndices];
-  fread(g_Indices,sizeof(unsigned short),g_NumIndices,f);
-  // close file
-  fclose(f);
+  g_Verticies    = g_Mesh.verticies;
+  g_NumVerticies = g_Mesh.numVerticies;
+  g_Indices      = g_Mesh.indices;
+  g_NumIndices   = g_Mesh.numIndices;
   // print mesh info
-  cerr << g_NumVerticies << " points " << g_NumIndices/3 << " triangles" << endl;
+  cerr << g_NumVerticies << " points " << g_NumIndices/3 << " triangles in " << g_Mesh.numChunks << " chunk(s)" << endl;
   // done.
 
-  getMinMaxCoords(g_Verticies, g_NumVerticies, g_objectMinCoords[1], g_objectMaxCoords[1]);
+  // bounds and ingest checks in a single sweep
+  t_mesh_stats stats;
+  computeMeshStats(&g_Mesh,&stats);
+  printMeshStats(&stats);
+
+  // vertex storage used from now on
+  initMeshStreams(&g_Streams,g_Verticies,g_NumVerticies);
+  if (g_UseSoA) convertMeshStreams(&g_Streams,MESH_LAYOUT_SOA);
+
+  // bounds of the object, from the position stream (any layout)
+  unsigned int stride;
+  const float *positions = getPositions(&g_Streams,&stride);
+  computeBounds(positions,stride,g_NumVerticies,g_objectMinCoords[1],g_objectMaxCoords[1]);
+  printf("bounds            : (%g %g %g) - (%g %g %g)\n",
+         g_objectMinCoords[1][0],g_objectMinCoords[1][1],g_objectMinCoords[1][2],
+         g_objectMaxCoords[1][0],g_objectMaxCoords[1][1],g_objectMaxCoords[1][2]);
+
+  // levels of detail, each one reordered for the vertex cache like the full mesh
+  buildLODChain(positions,stride,g_NumVerticies,g_Indices,g_NumIndices,g_MaxLODs,0.5f,&g_LODs);
+  for (unsigned int l = 1 ; l < g_LODs.numLods ; l ++ ) {
+    if (g_OptimizeMesh) optimizeVertexCache(g_LODs.lods[l].indices,g_LODs.lods[l].numIndices,0,g_NumVerticies);
+    cerr << "LOD " << l << ": " << g_LODs.lods[l].numIndices/3 << " triangles, error " << g_LODs.lods[l].error << endl;
+  }
+
+  // clusters for culling (reorders the triangles of each level)
+  unsigned int maxMeshlets = 0;
+  g_Meshlets = new t_meshlet_set[g_LODs.numLods];
+  for (unsigned int l = 0 ; l < g_LODs.numLods ; l ++ ) {
+    buildMeshlets(positions,stride,g_NumVerticies,g_LODs.lods[l].indices,g_LODs.lods[l].numIndices,&g_Meshlets[l]);
+    if (g_Meshlets[l].numMeshlets > maxMeshlets) maxMeshlets = g_Meshlets[l].numMeshlets;
+  }
+  g_MeshletVisible = new unsigned char[maxMeshlets > 0 ? maxMeshlets : 1];
+  if (g_LODs.numLods > 0) cerr << g_Meshlets[0].numMeshlets << " clusters" << endl;
+
+  // triangle hierarchy for picking
+  buildBVH(&g_BVH,positions,stride,g_Indices,g_NumIndices);
+  cerr << "BVH: " << g_BVH.numNodes << " nodes" << endl;
+  return true;
 }
 
 /* -------------------------------------------------------- */
 
-GLuint createCheckerBoardTexture()
+// Generate a pattern of res x res texels (16 cells or rings across) with its
+// mip chain on the CPU, and upload it for trilinear / anisotropic sampling
+GLuint createProceduralTexture(t_texture_pattern pattern,unsigned int res)
 {
-  static int res=16;
+  int start = glutGet(GLUT_ELAPSED_TIME);
+  t_texture texture;
+  generateProceduralTexture(&texture,pattern,res,res,res/16);
+  buildMipChain(&texture,MIP_FILTER_KAISER);
+  cerr << "Texture " << res << "x" << res << ", " << texture.numLevels << " levels in " << glutGet(GLUT_ELAPSED_TIME) - start << " ms" << endl;
   GLuint id=0;
   glGenTextures(1,&id);
   glBindTexture(GL_TEXTURE_2D,id);
-  unsigned char *data=new unsigned char[res*res*4];
-  for (int j=0;j<res;j++) {
-    for (int i=0;i<res;i++) {
-      data[(i+j*res)*4+0] = ((i+j)&1) ? 255 : 0;
-      data[(i+j*res)*4+1] = ((i+j)&1) ? 255 : 0;
-      data[(i+j*res)*4+2] = ((i+j)&1) ? 255 : 0;
-      data[(i+j*res)*4+3] = 255;
-    }
+  for (unsigned int l = 0 ; l < texture.numLevels ; l ++ ) {
+    const t_texture_level &level = texture.levels[l];
+    glTexImage2D(GL_TEXTURE_2D,l,GL_RGBA,level.width,level.height,0,GL_RGBA,GL_UNSIGNED_BYTE,level.data);
   }
-  glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,res,res,0,GL_RGBA,GL_UNSIGNED_BYTE,data);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP);
-  delete [](data);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
+  if (GLUX_IS_AVAILABLE(GL_EXT_texture_filter_anisotropic)) {
+    GLfloat maxAnisotropy = 1.0f;
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT,&maxAnisotropy);
+    glTexParameterf(GL_TEXTURE_2D,GL_TEXTURE_MAX_ANISOTROPY_EXT,maxAnisotropy);
+  }
+  // the patterns tile: repeat (the default) is kept for Ex7
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
+  freeTexture(&texture);
   return (id);
 }
 
@@ -526,6 +766,10 @@ void main(int argc, char **argv)
   glutReshapeFunc(mainReshape);
   // idle (whenever the application as some free time)
   glutIdleFunc(idle);
+  // load OpenGL extensions (requires the OpenGL context)
+  gluxInit();
+  initRenderTimer(&g_RenderTimer,NUM_RENDER_TASKS,g_RenderTaskNames);
+  atexit(exportRenderTimes);
 
   ///
   /// OpenGL
@@ -553,13 +797,38 @@ void main(int argc, char **argv)
   //glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, material_shininess); 
   //glEnable(GL_NORMALIZE);
 
-  g_tex = createCheckerBoardTexture();
-  
   /// Load IFS mesh
-   loadIFS("test.mesh"); // [4A]
+  // usage: tp1 [file.mesh] [-convert out.mesh] [-noOptimize] [-soa] [-lods n]
+  //            [-texture checker|circles|noise] [-textureSize n]
+  const char *meshFilename    = "test.mesh";
+  const char *convertFilename = NULL;
+  for (int i = 1 ; i < argc ; i ++ ) {
+    if (!strcmp(argv[i],"-convert") && i + 1 < argc) convertFilename = argv[++i];
+    else if (!strcmp(argv[i],"-noOptimize")) g_OptimizeMesh = false;
+    else if (!strcmp(argv[i],"-soa")) g_UseSoA = true;
+    else if (!strcmp(argv[i],"-lods") && i + 1 < argc) g_MaxLODs = atoi(argv[++i]);
+    else if (!strcmp(argv[i],"-texture") && i + 1 < argc) {
+      i ++;
+      if      (!strcmp(argv[i],"circles")) g_TexturePattern = TEXTURE_CIRCLES;
+      else if (!strcmp(argv[i],"noise"))   g_TexturePattern = TEXTURE_NOISE;
+      else                                 g_TexturePattern = TEXTURE_CHECKERBOARD;
+    }
+    else if (!strcmp(argv[i],"-textureSize") && i + 1 < argc) g_TextureSize = atoi(argv[++i]);
+    else meshFilename = argv[i];
+  }
+
+  g_tex = createProceduralTexture(g_TexturePattern,g_TextureSize);
+  if (loadIFS(meshFilename)) { // [4A]
+    uploadIFS();
+    // re-save in the versioned layout (32-bit indices if needed)
+    if (convertFilename != NULL && saveMesh(convertFilename,&g_Mesh)) {
+      cerr << "Saved " << convertFilename << endl;
+    }
+  }
 
   // print a small documentation
   printf("[q]     - quit\n");
+  printf("[t]     - show/hide render times\n");
 
   // enter glut main loop - this *never* returns
   glutMainLoop();
@@ -0,0 +1,220 @@
+﻿#include "BC4Codec.h"
+#ifdef BC4_SSE2
+#include <emmintrin.h>
+#endif
+
+/// <summary>
+/// Renvoie la taille en octets d'une texture compressée, les bords incomplets occupant des blocs entiers.
+/// </summary>
+/// <param name="width">Largeur de la texture.</param>
+/// <param name="height">Hauteur de la texture.</param>
+/// <returns>Taille en octets de la texture compressée.</returns>
+unsigned int BC4Codec::getCompressedSize(unsigned int width, unsigned int height)
+{
+	return ((width + BLOCK_SIZE - 1) / BLOCK_SIZE) * ((height + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_BYTES;
+}
+
+/// <summary>
+/// Compresse une texture. Les blocs dépassant du bord reproduisent les derniers texels de la texture.
+/// Pour que les patches ne partagent aucun bloc, leurs emplacements doivent être alignés sur des multiples de 4 texels (voir <c>QuadTree::packTexture</c>).
+/// </summary>
+/// <param name="texture">Pointeur vers les données de la texture.</param>
+/// <param name="width">Largeur de la texture.</param>
+/// <param name="height">Hauteur de la texture.</param>
+/// <returns>Pointeur vers les blocs compressés, de taille <c>getCompressedSize(width, height)</c>.</returns>
+BYTE *BC4Codec::encode(const BYTE *texture, unsigned int width, unsigned int height)
+{
+	int nBlocksU = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	int nBlocksV = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	BYTE *blocks = new BYTE[getCompressedSize(width, height)];
+
+	// Les blocs sont indépendants : chaque fil traite des rangées de blocs entières.
+	#pragma omp parallel for schedule(dynamic, 4)
+	for (int bj = 0; bj < nBlocksV; ++bj)
+	{
+		BYTE texels[BLOCK_SIZE * BLOCK_SIZE];
+		for (int bi = 0; bi < nBlocksU; ++bi)
+		{
+			for (unsigned int j = 0; j < BLOCK_SIZE; ++j)
+			{
+				unsigned int v = min(bj * BLOCK_SIZE + j, height - 1);
+				for (unsigned int i = 0; i < BLOCK_SIZE; ++i)
+				{
+					unsigned int u = min(bi * BLOCK_SIZE + i, width - 1);
+					texels[packXY(i, j, BLOCK_SIZE)] = texture[packXY(u, v, width)];
+				}
+			}
+			encodeBlock(texels, blocks + packXY(bi, bj, nBlocksU) * BLOCK_BYTES);
+		}
+	}
+	return blocks;
+}
+
+/// <summary>
+/// Décompresse une texture sur le CPU, afin de valider le codeur ou d'afficher la texture sans support matériel du format.
+/// </summary>
+/// <param name="blocks">Pointeur vers les blocs compressés.</param>
+/// <param name="width">Largeur de la texture.</param>
+/// <param name="height">Hauteur de la texture.</param>
+/// <returns>Pointeur vers les données de la texture décompressée.</returns>
+BYTE *BC4Codec::decode(const BYTE *blocks, unsigned int width, unsigned int height)
+{
+	int nBlocksU = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	int nBlocksV = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	BYTE *texture = new BYTE[width * height];
+
+	#pragma omp parallel for
+	for (int bj = 0; bj < nBlocksV; ++bj)
+	{
+		BYTE texels[BLOCK_SIZE * BLOCK_SIZE];
+		for (int bi = 0; bi < nBlocksU; ++bi)
+		{
+			decodeBlock(blocks + packXY(bi, bj, nBlocksU) * BLOCK_BYTES, texels);
+			for (unsigned int j = 0; j < BLOCK_SIZE && bj * BLOCK_SIZE + j < height; ++j)
+			{
+				for (unsigned int i = 0; i < BLOCK_SIZE && bi * BLOCK_SIZE + i < width; ++i)
+				{
+					texture[packXY(bi * BLOCK_SIZE + i, bj * BLOCK_SIZE + j, width)] = texels[packXY(i, j, BLOCK_SIZE)];
+				}
+			}
+		}
+	}
+	return texture;
+}
+
+/// <summary>
+/// Compresse un bloc de 4x4 texels. Deux palettes sont essayées :
+///	- 8 valeurs réparties entre le minimum et le maximum du bloc (premier octet supérieur au second),
+///	- 6 valeurs réparties entre le minimum et le maximum des texels différents de 0 et 255, plus 0 et 255 exactement (premier octet inférieur ou égal au second).
+/// La seconde reproduit sans erreur le fond et les bords francs des masques.
+/// </summary>
+/// <param name="texels">Les 16 texels du bloc, ligne par ligne.</param>
+/// <param name="block">Les 8 octets du bloc compressé.</param>
+void BC4Codec::encodeBlock(const BYTE *texels, BYTE *block)
+{
+	BYTE minValue = 255, maxValue = 0;
+	BYTE innerMin = 255, innerMax = 0;
+	for (unsigned int n = 0; n < BLOCK_SIZE * BLOCK_SIZE; ++n)
+	{
+		minValue = min(minValue, texels[n]);
+		maxValue = max(maxValue, texels[n]);
+		if (texels[n] != 0 && texels[n] != 255)
+		{
+			innerMin = min(innerMin, texels[n]);
+			innerMax = max(innerMax, texels[n]);
+		}
+	}
+	// Sans texel intermédiaire, les extrémités de la seconde palette sont indifférentes.
+	if (innerMin > innerMax)
+	{
+		innerMin = 0;
+		innerMax = 255;
+	}
+
+	BYTE palette[8];
+	BYTE indices[BLOCK_SIZE * BLOCK_SIZE];
+	BYTE red0 = maxValue, red1 = minValue;
+	buildPalette(red0, red1, palette);
+	unsigned int error = selectIndices(texels, palette, indices);
+	if (error > 0)
+	{
+		BYTE otherIndices[BLOCK_SIZE * BLOCK_SIZE];
+		buildPalette(innerMin, innerMax, palette);
+		unsigned int otherError = selectIndices(texels, palette, otherIndices);
+		if (otherError < error)
+		{
+			red0 = innerMin;
+			red1 = innerMax;
+			memcpy(indices, otherIndices, sizeof(indices));
+		}
+	}
+
+	// Les indices de 3 bits sont stockés à la suite, en little-endian, dans les 6 derniers octets.
+	unsigned long long bits = 0;
+	for (unsigned int n = 0; n < BLOCK_SIZE * BLOCK_SIZE; ++n) bits |= (unsigned long long)indices[n] << (3 * n);
+	block[0] = red0;
+	block[1] = red1;
+	for (unsigned int k = 0; k < 6; ++k) block[2 + k] = (BYTE)(bits >> (8 * k));
+}
+
+/// <summary>
+/// Décompresse un bloc de 4x4 texels.
+/// </summary>
+/// <param name="block">Les 8 octets du bloc compressé.</param>
+/// <param name="texels">Les 16 texels du bloc, ligne par ligne.</param>
+void BC4Codec::decodeBlock(const BYTE *block, BYTE *texels)
+{
+	BYTE palette[8];
+	buildPalette(block[0], block[1], palette);
+	unsigned long long bits = 0;
+	for (unsigned int k = 0; k < 6; ++k) bits |= (unsigned long long)block[2 + k] << (8 * k);
+	for (unsigned int n = 0; n < BLOCK_SIZE * BLOCK_SIZE; ++n) texels[n] = palette[(bits >> (3 * n)) & 7];
+}
+
+/// <summary>
+/// Calcule la palette définie par les deux premiers octets d'un bloc.
+/// </summary>
+/// <param name="red0">Premier octet du bloc.</param>
+/// <param name="red1">Second octet du bloc.</param>
+/// <param name="palette">Les 8 valeurs de la palette.</param>
+void BC4Codec::buildPalette(BYTE red0, BYTE red1, BYTE *palette)
+{
+	palette[0] = red0;
+	palette[1] = red1;
+	if (red0 > red1)
+	{
+		for (unsigned int k = 2; k < 8; ++k) palette[k] = (BYTE)(((8 - k) * red0 + (k - 1) * red1 + 3) / 7);
+	}
+	else
+	{
+		for (unsigned int k = 2; k < 6; ++k) palette[k] = (BYTE)(((6 - k) * red0 + (k - 1) * red1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+/// <summary>
+/// Choisit pour chaque texel la valeur la plus proche de la palette.
+/// </summary>
+/// <param name="texels">Les 16 texels du bloc.</param>
+/// <param name="palette">Les 8 valeurs de la palette.</param>
+/// <param name="indices">Les 16 indices choisis.</param>
+/// <returns>Somme des erreurs absolues commises.</returns>
+unsigned int BC4Codec::selectIndices(const BYTE *texels, const BYTE *palette, BYTE *indices)
+{
+#ifdef BC4_SSE2
+	// Les 16 texels sont traités en même temps : écart absolu par soustractions saturées, puis sélection sans branchement.
+	__m128i values = _mm_loadu_si128((const __m128i*)texels);
+	__m128i bestError = _mm_set1_epi8((char)0xFF);
+	__m128i bestIndex = _mm_setzero_si128();
+	for (int k = 0; k < 8; ++k)
+	{
+		__m128i entry = _mm_set1_epi8((char)palette[k]);
+		__m128i error = _mm_or_si128(_mm_subs_epu8(values, entry), _mm_subs_epu8(entry, values));
+		// error < bestError : error vaut le minimum des deux sans lui être égal.
+		__m128i better = _mm_andnot_si128(_mm_cmpeq_epi8(error, bestError), _mm_cmpeq_epi8(_mm_min_epu8(error, bestError), error));
+		bestError = _mm_min_epu8(error, bestError);
+		bestIndex = _mm_or_si128(_mm_and_si128(better, _mm_set1_epi8((char)k)), _mm_andnot_si128(better, bestIndex));
+	}
+	_mm_storeu_si128((__m128i*)indices, bestIndex);
+	__m128i sum = _mm_sad_epu8(bestError, _mm_setzero_si128());
+	return (unsigned int)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#else
+	unsigned int total = 0;
+	for (unsigned int n = 0; n < BLOCK_SIZE * BLOCK_SIZE; ++n)
+	{
+		unsigned int bestError = 256;
+		for (unsigned int k = 0; k < 8; ++k)
+		{
+			unsigned int error = abs((int)texels[n] - (int)palette[k]);
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[n] = (BYTE)k;
+			}
+		}
+		total += bestError;
+	}
+	return total;
+#endif
+}
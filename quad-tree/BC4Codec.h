@@ -0,0 +1,30 @@
+﻿/*! \file */
+#pragma once
+#include "stdafx.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC4_SSE2
+#endif
+
+/// <summary>
+/// Compression d'une texture en niveaux de gris au format BC4 (<c>GL_COMPRESSED_RED_RGTC1</c>) : chaque bloc de 4x4 texels est codé sur 8 octets,
+/// soit deux valeurs extrêmes et un indice de 3 bits par texel désignant l'une des 8 valeurs de la palette qu'elles définissent.
+/// Le codeur essaie les deux palettes du format (8 valeurs interpolées, ou 6 valeurs interpolées plus 0 et 255, adaptée aux masques) et conserve la meilleure.
+/// Les blocs sont codés en parallèle (OpenMP), et les indices choisis à l'aide de SSE2 lorsque celui-ci est disponible.
+/// </summary>
+class BC4Codec
+{
+public:
+	static const unsigned int BLOCK_SIZE = 4;
+	static const unsigned int BLOCK_BYTES = 8;
+
+	static unsigned int getCompressedSize(unsigned int width, unsigned int height);
+	static BYTE *encode(const BYTE *texture, unsigned int width, unsigned int height);
+	static BYTE *decode(const BYTE *blocks, unsigned int width, unsigned int height);
+	static void encodeBlock(const BYTE *texels, BYTE *block);
+	static void decodeBlock(const BYTE *block, BYTE *texels);
+
+private:
+	static void buildPalette(BYTE red0, BYTE red1, BYTE *palette);
+	static unsigned int selectIndices(const BYTE *texels, const BYTE *palette, BYTE *indices);
+};
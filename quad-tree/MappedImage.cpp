@@ -0,0 +1,141 @@
+﻿#include "MappedImage.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedImage::MappedImage(void)
+	: m_base(NULL), m_size(0), m_data(NULL), m_width(0), m_height(0)
+{
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+#endif
+}
+
+MappedImage::~MappedImage(void)
+{
+	close();
+}
+
+/// <summary>
+/// Projette un fichier PGM en mémoire et lit ses dimensions. Comme pour la lecture classique, les pixels sont les <c>width * height</c> derniers octets du fichier.
+/// </summary>
+/// <param name="filename">Nom du fichier.</param>
+/// <returns><c>true</c> si le fichier a pu être projeté, <c>false</c> sinon.</returns>
+bool MappedImage::open(const char *filename)
+{
+	close();
+
+#ifdef _WIN32
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL)
+	{
+		close();
+		return false;
+	}
+	m_base = (const BYTE*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_base == NULL)
+	{
+		close();
+		return false;
+	}
+#else
+	int file = ::open(filename, O_RDONLY);
+	if (file < 0) return false;
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0)
+	{
+		::close(file);
+		return false;
+	}
+	m_size = (size_t)status.st_size;
+	void *base = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (base == MAP_FAILED) return false;
+	m_base = (const BYTE*)base;
+	// L'image est parcourue ligne par ligne lors de la construction de l'arbre.
+	madvise(base, m_size, MADV_SEQUENTIAL);
+#endif
+
+	// On cherche la ligne de l'en-tête contenant les dimensions (les commentaires et le numéro magique ne contiennent pas deux entiers).
+	char line[64];
+	size_t start = 0;
+	bool found = false;
+	while (!found && start < m_size)
+	{
+		size_t end = start;
+		while (end < m_size && m_base[end] != '\n') ++end;
+		size_t length = min(end - start, sizeof(line) - 1);
+		memcpy(line, m_base + start, length);
+		line[length] = '\0';
+		found = (line[0] != '#' && sscanf(line, "%u %u", &m_width, &m_height) == 2);
+		start = end + 1;
+	}
+	if (!found || (size_t)m_width * m_height > m_size)
+	{
+		close();
+		return false;
+	}
+	m_data = m_base + m_size - (size_t)m_width * m_height;
+	return true;
+}
+
+/// <summary>
+/// Libère la projection du fichier. Les pointeurs renvoyés par <c>getData</c> deviennent invalides.
+/// </summary>
+void MappedImage::close(void)
+{
+#ifdef _WIN32
+	if (m_base != NULL) UnmapViewOfFile(m_base);
+	if (m_mapping != NULL) CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+	m_mapping = NULL;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_base != NULL) munmap((void*)m_base, m_size);
+#endif
+	m_base = NULL;
+	m_data = NULL;
+	m_size = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/// <summary>
+/// Renvoie les pixels de l'image.
+/// </summary>
+/// <returns>Pointeur vers les pixels, valide jusqu'à l'appel de <c>close</c>.</returns>
+const BYTE *MappedImage::getData(void) const
+{
+	return m_data;
+}
+
+/// <summary>
+/// Renvoie la largeur de l'image.
+/// </summary>
+/// <returns>Largeur de l'image.</returns>
+unsigned int MappedImage::getWidth(void) const
+{
+	return m_width;
+}
+
+/// <summary>
+/// Renvoie la hauteur de l'image.
+/// </summary>
+/// <returns>Hauteur de l'image.</returns>
+unsigned int MappedImage::getHeight(void) const
+{
+	return m_height;
+}
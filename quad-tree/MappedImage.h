@@ -0,0 +1,29 @@
+﻿/*! \file */
+#pragma once
+#include "stdafx.h"
+
+/// <summary>
+/// Image en niveaux de gris au format PGM binaire projetée en mémoire : les pixels sont lus directement depuis le fichier, sans être copiés.
+/// </summary>
+class MappedImage
+{
+public:
+	MappedImage(void);
+	~MappedImage(void);
+	bool open(const char *filename);
+	void close(void);
+	const BYTE *getData(void) const;
+	unsigned int getWidth(void) const;
+	unsigned int getHeight(void) const;
+
+private:
+	const BYTE *m_base;
+	size_t m_size;
+#ifdef _WIN32
+	HANDLE m_file;
+	HANDLE m_mapping;
+#endif
+	const BYTE *m_data;
+	unsigned int m_width;
+	unsigned int m_height;
+};
@@ -10,12 +10,26 @@ QuadTree::QuadTree(void)
 /// <param name="data">Pointeur vers le contenu de l'image.</param>
 /// <param name="totalSizeX">Largeur de l'image.</param>
 /// <param name="totalSizeY">Hauteur de l'image.</param>
-QuadTree::QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int totalSizeY)
-	: m_isLeaf(true), m_depth(0), m_nLeaves(0), m_isEmpty(true), m_data(data), m_totalSizeX(totalSizeX), m_totalSizeY(totalSizeY), m_x(0), m_y(0), m_sizeU(totalSizeX), m_sizeV(totalSizeY), m_isRoot(true), m_nLeavesAtDepth(NULL), m_orderedLeaves(NULL)
+/// <param name="splitPolicy">Critère de subdivision des noeuds.</param>
+/// <param name="powerOfTwoRoot">Spécifie si la racine doit être un carré dont le côté est la puissance de 2 supérieure à la plus grande dimension de l'image (la zone hors de l'image étant considérée comme du fond).</param>
+QuadTree::QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int totalSizeY, const QuadTreeSplitPolicy &splitPolicy, bool powerOfTwoRoot)
+	: m_isLeaf(true), m_depth(0), m_nLeaves(0), m_isEmpty(true), m_data(data), m_totalSizeX(totalSizeX), m_totalSizeY(totalSizeY), m_x(0), m_y(0), m_sizeU(totalSizeX), m_sizeV(totalSizeY), m_isRoot(true), m_nLeavesAtDepth(NULL), m_nDepths(0), m_splitPolicy(NULL), m_orderedLeaves(NULL), m_totalSizeU(0), m_totalSizeV(0), m_indirectionPoolWidth(0), m_indirectionPoolHeight(0), m_layer(0), m_gutter(0)
 {
-	unsigned int n = 1 + (unsigned int)ceil(log((double)min(totalSizeX, totalSizeY)) / log(2.));
+	QUADTREE_PROFILE_SCOPE(STAGE_BUILD);
+
+	// Avec une racine carrée de côté puissance de 2, tous les noeuds d'une même profondeur ont la même taille.
+	if (powerOfTwoRoot)
+	{
+		m_sizeU = m_sizeV = nextPowerOfTwo(max(max(totalSizeX, totalSizeY), 1u));
+	}
+
+	// La profondeur est bornée par le nombre de subdivisions de la plus grande dimension et par le critère de subdivision.
+	unsigned int n = 1 + (unsigned int)ceil(log((double)max(max(m_sizeU, m_sizeV), 1u)) / log(2.));
+	if (splitPolicy.maxDepth < n) n = splitPolicy.maxDepth + 1;
 	m_nLeavesAtDepth = new unsigned int[n];
 	memset(m_nLeavesAtDepth, 0, n * sizeof(unsigned int));	
+	m_nDepths = n;
+	m_splitPolicy = new QuadTreeSplitPolicy(splitPolicy);
 
 	initNode();
 }
@@ -32,8 +46,9 @@ QuadTree::QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int total
 /// <param name="y">Première coordonnée verticale de la portion d'image à traiter.</param>
 /// <param name="nLeavesAtDepth">Pointeur vers un tableau contenant le nombre de feuilles existant pour chaque profondeur (ignoré si <c>isRoot</c> vaut <c>true</c>).</param>
 /// <param name="depth">Profondeur du noeud à créer.</param>
-QuadTree::QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int totalSizeY, unsigned int sizeX, unsigned int sizeY, unsigned int x, unsigned int y, unsigned int *nLeavesAtDepth, unsigned int depth)
-	: m_isLeaf(true), m_depth(depth), m_nLeaves(0), m_isEmpty(true), m_data(data), m_totalSizeX(totalSizeX), m_totalSizeY(totalSizeY), m_x(x), m_y(y), m_sizeU(sizeX), m_sizeV(sizeY), m_isRoot(false), m_nLeavesAtDepth(nLeavesAtDepth), m_orderedLeaves(NULL)
+/// <param name="splitPolicy">Pointeur vers le critère de subdivision partagé par tous les noeuds de l'arbre.</param>
+QuadTree::QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int totalSizeY, unsigned int sizeX, unsigned int sizeY, unsigned int x, unsigned int y, unsigned int *nLeavesAtDepth, unsigned int depth, const QuadTreeSplitPolicy *splitPolicy)
+	: m_isLeaf(true), m_depth(depth), m_nLeaves(0), m_isEmpty(true), m_data(data), m_totalSizeX(totalSizeX), m_totalSizeY(totalSizeY), m_x(x), m_y(y), m_sizeU(sizeX), m_sizeV(sizeY), m_isRoot(false), m_nLeavesAtDepth(nLeavesAtDepth), m_nDepths(0), m_splitPolicy(splitPolicy), m_orderedLeaves(NULL), m_totalSizeU(0), m_totalSizeV(0), m_indirectionPoolWidth(0), m_indirectionPoolHeight(0), m_layer(0), m_gutter(0)
 {	
 	initNode();
 }
@@ -50,27 +65,46 @@ void QuadTree::initNode()
 	}	
 
 	// On parcours la protion d'image associée au noeud :
-	//	- Si elle ne contient que du fond, le noeud sera considéré vide.
-	//	- Si elle ne contient pas du tout de fond ou si l'une de ses dimensions est strictement inférieure à 2, le noeud est une feuille non vide.
-	//	- Si elle contient en partie du fond le noeud est un noeud intermédiaire.
+	//	- Si elle ne contient que du fond (ou si son intensité moyenne est tolérée comme erreur), le noeud sera considéré vide.
+	//	- Si la proportion de fond qu'elle contient est tolérée (et que le noeud ne dépasse pas la taille maximale), ou si le noeud a atteint la taille minimale ou la profondeur maximale, le noeud est une feuille non vide.
+	//	- Sinon le noeud est un noeud intermédiaire.
+	// Avec le critère par défaut (aucune tolérance), le parcours s'arrête dès que du fond et autre chose que du fond ont été rencontrés.
+	// La partie du noeud située hors de l'image (racine complétée à une puissance de 2) est comptée comme du fond sans être parcourue.
+	QUADTREE_PROFILE_COUNT(COUNTER_NODES_VISITED, 1);
+	const QuadTreeSplitPolicy &policy = *m_splitPolicy;
+	bool exact = policy.maxBackgroundFraction <= 0. && policy.maxEmptyError <= 0.;
 	bool containsEdge = false;
-	for (unsigned int i = 0; i < m_sizeU; ++i)
+	unsigned int visibleSizeU = getVisibleSizeU();
+	unsigned int visibleSizeV = getVisibleSizeV();
+	unsigned int nScanned = m_sizeU * m_sizeV - visibleSizeU * visibleSizeV;
+	unsigned int nBackground = nScanned;
+	double sum = 0.;
+	for (unsigned int i = 0; i < visibleSizeU; ++i)
 	{
-		for (unsigned int j = 0; j < m_sizeV; ++j)
+		for (unsigned int j = 0; j < visibleSizeV; ++j)
 		{
+			QUADTREE_PROFILE_COUNT(COUNTER_PIXELS_SCANNED, 1);
 			unsigned int x = m_x + i;
 			unsigned int y = m_y + j;
-			if (m_isEmpty) m_isEmpty = m_data[packXY(x, y, m_totalSizeX)] == 0;
-			if (!m_isEmpty) containsEdge = m_data[packXY(x, y, m_totalSizeX)] == 0;
-			if (containsEdge) break;
+			BYTE value = m_data[packXY(x, y, m_totalSizeX)];
+			++nScanned;
+			if (value == 0) ++nBackground;
+			else sum += value;
+			if (exact && nBackground > 0 && nBackground < nScanned)
+			{
+				containsEdge = true;
+				break;
+			}
 		}
 		if (containsEdge) break;
 	}
 
+	m_isEmpty = !containsEdge && (nBackground == nScanned || sum <= policy.maxEmptyError * nScanned);
 	if (m_isEmpty) return;
 
 	// Si le noeud est une feuille non vide, le nombre de feuilles est égale à 1, et on incrémente le nombre total de feuilles de même profondeur.
-	if (m_sizeU < 2 || m_sizeV < 2 || !containsEdge) 
+	bool needsSplit = containsEdge || nBackground > policy.maxBackgroundFraction * nScanned || max(m_sizeU, m_sizeV) > policy.maxLeafSize;
+	if (!needsSplit || min(m_sizeU, m_sizeV) < 2 * policy.minLeafSize || m_depth >= policy.maxDepth) 
 	{
 		m_nLeaves = 1;
 		++m_nLeavesAtDepth[m_depth];
@@ -84,10 +118,10 @@ void QuadTree::initNode()
 	unsigned int sizeX1 = m_sizeU / 2;
 	unsigned int sizeY0 = m_sizeV - (m_sizeV / 2);
 	unsigned int sizeY1 = m_sizeV / 2;
-	m_children[0] = new QuadTree(m_data, m_totalSizeX, m_totalSizeY, sizeX0, sizeY0, m_x, m_y, m_nLeavesAtDepth, m_depth + 1);
-	m_children[1] = new QuadTree(m_data, m_totalSizeX, m_totalSizeY, sizeX1, sizeY0, m_x + sizeX0, m_y, m_nLeavesAtDepth, m_depth + 1);
-	m_children[2] = new QuadTree(m_data, m_totalSizeX, m_totalSizeY, sizeX0, sizeY1, m_x, m_y + sizeY0, m_nLeavesAtDepth, m_depth + 1);
-	m_children[3] = new QuadTree(m_data, m_totalSizeX, m_totalSizeY, sizeX1, sizeY1, m_x + sizeX0, m_y + sizeY0, m_nLeavesAtDepth, m_depth + 1);
+	m_children[0] = new QuadTree(m_data, m_totalSizeX, m_totalSizeY, sizeX0, sizeY0, m_x, m_y, m_nLeavesAtDepth, m_depth + 1, m_splitPolicy);
+	m_children[1] = new QuadTree(m_data, m_totalSizeX, m_totalSizeY, sizeX1, sizeY0, m_x + sizeX0, m_y, m_nLeavesAtDepth, m_depth + 1, m_splitPolicy);
+	m_children[2] = new QuadTree(m_data, m_totalSizeX, m_totalSizeY, sizeX0, sizeY1, m_x, m_y + sizeY0, m_nLeavesAtDepth, m_depth + 1, m_splitPolicy);
+	m_children[3] = new QuadTree(m_data, m_totalSizeX, m_totalSizeY, sizeX1, sizeY1, m_x + sizeX0, m_y + sizeY0, m_nLeavesAtDepth, m_depth + 1, m_splitPolicy);
 
 	m_nLeaves = m_children[0]->getNLeaves() + m_children[1]->getNLeaves() + m_children[2]->getNLeaves() + m_children[3]->getNLeaves();
 
@@ -103,9 +137,28 @@ QuadTree::~QuadTree(void)
 		delete m_children[3];
 	}
 	if(m_isRoot) delete[] m_nLeavesAtDepth;
+	if(m_isRoot) delete m_splitPolicy;
 	if (m_orderedLeaves != NULL) delete[] m_orderedLeaves;
 }
 
+/// <summary>
+/// Renvoie la largeur de la partie du noeud située dans l'image.
+/// </summary>
+/// <returns>Largeur de la partie du noeud située dans l'image.</returns>
+unsigned int QuadTree::getVisibleSizeU(void) const
+{
+	return (m_x < m_totalSizeX) ? min(m_sizeU, m_totalSizeX - m_x) : 0;
+}
+
+/// <summary>
+/// Renvoie la hauteur de la partie du noeud située dans l'image.
+/// </summary>
+/// <returns>Hauteur de la partie du noeud située dans l'image.</returns>
+unsigned int QuadTree::getVisibleSizeV(void) const
+{
+	return (m_y < m_totalSizeY) ? min(m_sizeV, m_totalSizeY - m_y) : 0;
+}
+
 /// <summary>
 /// Indique si un noeud est une feuille.
 /// </summary>
@@ -295,6 +348,31 @@ const QuadTree *QuadTree::getLeaf(unsigned int i) const
 	return m_orderedLeaves[i];
 }
 
+/// <summary>
+/// Recherche les feuilles non vides intersectant une région de l'image, en écartant les sous-arbres entiers situés hors de la région.
+/// </summary>
+/// <param name="x0">Première coordonnée horizontale normalisée de la région.</param>
+/// <param name="y0">Première coordonnée verticale normalisée de la région.</param>
+/// <param name="x1">Dernière coordonnée horizontale normalisée de la région.</param>
+/// <param name="y1">Dernière coordonnée verticale normalisée de la région.</param>
+/// <param name="leaves">Tableau (d'au moins <c>getNLeaves()</c> éléments) recevant les feuilles visibles.</param>
+/// <returns>Nombre de feuilles visibles.</returns>
+unsigned int QuadTree::getVisibleLeaves(double x0, double y0, double x1, double y1, const QuadTree **leaves) const
+{
+	if (isEmpty() || getX0d() >= x1 || getX1d() <= x0 || getY0d() >= y1 || getY1d() <= y0) return 0;
+	if (isLeaf())
+	{
+		leaves[0] = this;
+		return 1;
+	}
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		n += m_children[i]->getVisibleLeaves(x0, y0, x1, y1, leaves + n);
+	}
+	return n;
+}
+
 /// <summary>
 /// Renvoie la profondeur du noeud.
 /// </summary>
@@ -304,24 +382,66 @@ unsigned int QuadTree::getDepth(void) const
 	return m_depth;
 }
 
+/// <summary>
+/// Renvoie l'indice de la page de texture contenant le patch de la feuille (toujours 0 hors d'un <c>QuadTreeAtlas</c>).
+/// </summary>
+/// <returns>Indice de la page contenant le patch.</returns>
+unsigned int QuadTree::getLayer(void) const
+{
+	return m_layer;
+}
+
 /// <summary>
 /// Pour la racine, génère la texture contenant les patches correspondant aux feuilles.
 /// </summary>
 /// <param name="powerOfTwo">Spécifie si les dimensions de la texture générée doivent être des puissances entières de 2.</param>
+/// <param name="gutter">Largeur de la bordure (reproduisant les bords du patch) entourant chaque patch, permettant le filtrage.</param>
+/// <param name="mipLevels">Nombre de niveaux de mipmap que la texture doit pouvoir supporter sans que les patches ne se mélangent.</param>
+/// <param name="blockSize">Côté des blocs de compression de la texture (4 pour BC4, 1 sans compression) : à chaque niveau de mipmap, aucun bloc ne couvre deux patches.</param>
 /// <returns>Pointeur vers les données de la texture générée.</returns>
-BYTE *QuadTree::generateTexture(bool powerOfTwo)
+BYTE *QuadTree::generateTexture(bool powerOfTwo, unsigned int gutter, unsigned int mipLevels, unsigned int blockSize)
+{
+	packTexture(powerOfTwo, gutter, mipLevels, blockSize);
+	BYTE *texture = new BYTE[m_totalSizeU * m_totalSizeV];
+	writeTexture(texture);
+	return texture;
+}
+
+/// <summary>
+/// Pour la racine, détermine la position de chaque patch dans la texture et les dimensions de celle-ci (<c>getTotalSizeU</c>, <c>getTotalSizeV</c>), sans la générer.
+/// La texture peut ensuite être écrite directement dans sa destination finale à l'aide de <c>writeTexture</c>.
+/// </summary>
+/// <param name="powerOfTwo">Spécifie si les dimensions de la texture doivent être des puissances entières de 2.</param>
+/// <param name="gutter">Largeur de la bordure (reproduisant les bords du patch) entourant chaque patch, permettant le filtrage.</param>
+/// <param name="mipLevels">Nombre de niveaux de mipmap que la texture doit pouvoir supporter sans que les patches ne se mélangent.</param>
+/// <param name="blockSize">Côté des blocs de compression de la texture (4 pour BC4, 1 sans compression) : à chaque niveau de mipmap, aucun bloc ne couvre deux patches.</param>
+void QuadTree::packTexture(bool powerOfTwo, unsigned int gutter, unsigned int mipLevels, unsigned int blockSize)
 {	
+	m_gutter = gutter;
+
 	// On initialise la liste des feuilles non vides classées avec des pointeurs nuls, puis on classe les feuilles non vides.
 	m_orderedLeaves = new QuadTree*[getNLeaves()];
 	memset(m_orderedLeaves, NULL, getNLeaves() * sizeof(QuadTree*));
 
+	QUADTREE_PROFILE_BEGIN(STAGE_ORDER);
 	orderLeaves(m_orderedLeaves);
+	QUADTREE_PROFILE_END(STAGE_ORDER);
+
+	QUADTREE_PROFILE_BEGIN(STAGE_PACK);
+	// Chaque patch occupe dans la texture un emplacement entouré d'une bordure de gutter texels, dont les dimensions sont arrondies à un multiple de blockSize * 2^mipLevels.
+	// Ainsi, à chaque niveau de mipmap, un texel (ou un bloc compressé) ne couvre jamais deux emplacements différents.
+	unsigned int alignment = blockSize << mipLevels;
+	for (unsigned int n = 0; n < getNLeaves(); ++n)
+	{
+		m_orderedLeaves[n]->m_slotSizeU = ((m_orderedLeaves[n]->getSizeU() + 2 * gutter + alignment - 1) / alignment) * alignment;
+		m_orderedLeaves[n]->m_slotSizeV = ((m_orderedLeaves[n]->getSizeV() + 2 * gutter + alignment - 1) / alignment) * alignment;
+	}
 
 	// On attribue ensuite à chaque feuille non vide une position dans la texture générée.
 	// On commence par placer le patch le plus grand. Celui-ci définit la taille verticale de la texture.
 
-	m_totalSizeU = 0;
-	m_totalSizeV = m_orderedLeaves[0]->getSizeV();
+	m_totalSizeU = m_orderedLeaves[0]->m_slotSizeU;
+	m_totalSizeV = m_orderedLeaves[0]->m_slotSizeV;
 	m_orderedLeaves[0]->m_u = 0;
 	m_orderedLeaves[0]->m_v = 0;
 
@@ -345,25 +465,25 @@ BYTE *QuadTree::generateTexture(bool powerOfTwo)
 	{
 		QuadTree *leaf = m_orderedLeaves[i];
 		// s'il ne reste pas suffisament d'espace en dessous de la pile actuelle,
-		if (leftV < m_orderedLeaves[i]->getSizeV())
+		if (leftV < m_orderedLeaves[i]->m_slotSizeV)
 		{
 			// on examine l'espace disponible à droite des piles précédentes jusqu'à en trouver suffisamment, où on  démarre une nouvelle pile;
-			while (leftU[stackSize - 1] != -1 && leftU[stackSize - 1] < m_orderedLeaves[i]->getSizeU())
+			while (leftU[stackSize - 1] != -1 && leftU[stackSize - 1] < (int)m_orderedLeaves[i]->m_slotSizeU)
 			{
 				stackSize--;
 			}
 			if (leftU[stackSize - 1] == -1)
 			{
-				m_orderedLeaves[i]->m_u = stack[0]->getU() + stack[0]->getSizeU();
+				m_orderedLeaves[i]->m_u = stack[0]->getU() + stack[0]->m_slotSizeU;
 				m_orderedLeaves[i]->m_v = 0;
 				stack[0] = m_orderedLeaves[i];
 			}
-			else if(leftU[stackSize - 1] >= m_orderedLeaves[i]->getSizeU())
+			else if(leftU[stackSize - 1] >= (int)m_orderedLeaves[i]->m_slotSizeU)
 			{
-				m_orderedLeaves[i]->m_u = stack[stackSize - 1]->getU() + stack[stackSize - 1]->getSizeU();
+				m_orderedLeaves[i]->m_u = stack[stackSize - 1]->getU() + stack[stackSize - 1]->m_slotSizeU;
 				m_orderedLeaves[i]->m_v = stack[stackSize - 1]->getV();
 				stack[stackSize - 1] = m_orderedLeaves[i];
-				leftU[stackSize - 1] -= m_orderedLeaves[i]->getSizeU();
+				leftU[stackSize - 1] -= m_orderedLeaves[i]->m_slotSizeU;
 			}
 		}
 		// s'il en reste suffisament, 
@@ -371,17 +491,17 @@ BYTE *QuadTree::generateTexture(bool powerOfTwo)
 		{
 			// on place lep atch actuel en dessous de la pile,
 			m_orderedLeaves[i]->m_u = m_orderedLeaves[i - 1]->getU();
-			m_orderedLeaves[i]->m_v = m_orderedLeaves[i - 1]->getV() + m_orderedLeaves[i - 1]->getSizeV();
+			m_orderedLeaves[i]->m_v = m_orderedLeaves[i - 1]->getV() + m_orderedLeaves[i - 1]->m_slotSizeV;
 			// si le patch actuel n'a pas la même taille que le précédent, il commence une nouvelle pile.
 			if (m_orderedLeaves[i]->getDepth() != m_orderedLeaves[i - 1]->getDepth())
 			{
 				stack[stackSize++] = m_orderedLeaves[i];
-				leftU[stackSize - 1] = m_orderedLeaves[i - 1]->getSizeU() - m_orderedLeaves[i]->getSizeU();
+				leftU[stackSize - 1] = m_orderedLeaves[i - 1]->m_slotSizeU - m_orderedLeaves[i]->m_slotSizeU;
 			}
 		}
 		// On enregistre la nouvelle largeur de la texture.
-		m_totalSizeU = max(m_totalSizeU, m_orderedLeaves[i]->getU() + m_orderedLeaves[i]->getSizeU());
-		leftV = m_totalSizeV - (m_orderedLeaves[i]->getV() + m_orderedLeaves[i]->getSizeV());
+		m_totalSizeU = max(m_totalSizeU, m_orderedLeaves[i]->getU() + m_orderedLeaves[i]->m_slotSizeU);
+		leftV = m_totalSizeV - (m_orderedLeaves[i]->getV() + m_orderedLeaves[i]->m_slotSizeV);
 	}
 
 	// Si besoin, on augmente les dimensions de la texture aux puissances de deux supérieures.
@@ -391,29 +511,98 @@ BYTE *QuadTree::generateTexture(bool powerOfTwo)
 		m_totalSizeV = nextPowerOfTwo(m_totalSizeV);
 	}
 
-	// On aloue l'espace pour stocker la texture.
-	BYTE *texture = new BYTE[m_totalSizeU * m_totalSizeV];
-	memset(texture, 0, m_totalSizeU * m_totalSizeV);
-
-	// Pour chaque feuille non vide, on copie le contenu du patch dans la texture à l'emplacement précedemment déterminé.
+	// Les patches sont placés à l'intérieur de leur emplacement, après la bordure.
 	for (unsigned int n = 0; n < getNLeaves(); ++n)
 	{
+		m_orderedLeaves[n]->m_u += gutter;
+		m_orderedLeaves[n]->m_v += gutter;
 		m_orderedLeaves[n]->m_totalSizeU = m_totalSizeU;
 		m_orderedLeaves[n]->m_totalSizeV = m_totalSizeV;
-		for (unsigned int i = 0; i < m_orderedLeaves[n]->getSizeU(); ++i)
-			for (unsigned int j = 0; j < m_orderedLeaves[n]->getSizeV(); ++j)
-			{
-				unsigned int u = m_orderedLeaves[n]->getU() + i;
-				unsigned int v = m_orderedLeaves[n]->getV() + j;
-				unsigned int x = m_orderedLeaves[n]->getX() + i;
-				unsigned int y = m_orderedLeaves[n]->getY() + j;
-				texture[packXY(u, v, m_totalSizeU)] = m_data[packXY(x, y, m_totalSizeX)];
-			}
 	}
+	QUADTREE_PROFILE_END(STAGE_PACK);
+
+#ifdef QUADTREE_PROFILING
+	// On comptabilise les texels de la texture non couverts par un patch.
+	unsigned int usedTexels = 0;
+	for (unsigned int n = 0; n < getNLeaves(); ++n)
+	{
+		usedTexels += m_orderedLeaves[n]->getSizeU() * m_orderedLeaves[n]->getSizeV();
+	}
+	QUADTREE_PROFILE_COUNT(COUNTER_ATLAS_WASTE, m_totalSizeU * m_totalSizeV - usedTexels);
+#endif
 
 	delete[] leftU;
 	delete[] stack;
-	return texture;
+}
+
+/// <summary>
+/// Pour la racine, après <c>packTexture</c>, écrit la texture dans une destination quelconque (tableau, tampon OpenGL projeté en mémoire...),
+/// les patches étant copiés directement depuis l'image, qui doit encore être valide.
+/// </summary>
+/// <param name="texture">Pointeur vers une destination de <c>getTotalSizeU() * getTotalSizeV()</c> octets, dont le contenu initial est indifférent.</param>
+void QuadTree::writeTexture(BYTE *texture) const
+{
+	QUADTREE_PROFILE_SCOPE(STAGE_BLIT);
+
+	// La destination n'étant pas nécessairement initialisée, on la remet à zéro avant d'y copier les patches.
+	memset(texture, 0, m_totalSizeU * m_totalSizeV);
+
+	// Pour chaque feuille non vide, on copie le contenu du patch dans la texture à l'emplacement précedemment déterminé.
+	for (unsigned int n = 0; n < getNLeaves(); ++n)
+	{
+		m_orderedLeaves[n]->copyPatch(texture, m_totalSizeU, m_gutter);
+	}
+}
+
+/// <summary>
+/// Pour une feuille placée, copie le contenu de son patch dans une texture (la partie hors de l'image reste noire).
+/// Le reste de l'emplacement (bordure et alignement) reproduit le bord le plus proche du patch.
+/// </summary>
+/// <param name="texture">Pointeur vers les données de la texture (ou de la page de texture) contenant la feuille.</param>
+/// <param name="textureWidth">Largeur de la texture.</param>
+/// <param name="gutter">Largeur de la bordure entourant le patch.</param>
+void QuadTree::copyPatch(BYTE *texture, unsigned int textureWidth, unsigned int gutter) const
+{
+	for (unsigned int i = 0; i < m_slotSizeU; ++i)
+		for (unsigned int j = 0; j < m_slotSizeV; ++j)
+		{
+			int di = min(max((int)i - (int)gutter, 0), (int)getSizeU() - 1);
+			int dj = min(max((int)j - (int)gutter, 0), (int)getSizeV() - 1);
+			if (di >= (int)getVisibleSizeU() || dj >= (int)getVisibleSizeV()) continue;
+			unsigned int u = getU() - gutter + i;
+			unsigned int v = getV() - gutter + j;
+			unsigned int x = getX() + di;
+			unsigned int y = getY() + dj;
+			texture[packXY(u, v, textureWidth)] = m_data[packXY(x, y, m_totalSizeX)];
+		}
+}
+
+/// <summary>
+/// Calcule le niveau de mipmap suivant d'une texture générée par <c>generateTexture</c> en moyennant les blocs de 2x2 texels.
+/// Les emplacements des patches étant alignés, aucun bloc ne mélange deux patches tant que le niveau reste inférieur au <c>mipLevels</c> utilisé.
+/// </summary>
+/// <param name="level">Pointeur vers les données du niveau courant.</param>
+/// <param name="width">Largeur du niveau courant.</param>
+/// <param name="height">Hauteur du niveau courant.</param>
+/// <returns>Pointeur vers les données du niveau suivant, de dimensions divisées par 2.</returns>
+BYTE *QuadTree::generateMipmapLevel(const BYTE *level, unsigned int width, unsigned int height)
+{
+	unsigned int nextWidth = max(width / 2, 1u);
+	unsigned int nextHeight = max(height / 2, 1u);
+	BYTE *next = new BYTE[nextWidth * nextHeight];
+	for (unsigned int j = 0; j < nextHeight; ++j)
+	{
+		for (unsigned int i = 0; i < nextWidth; ++i)
+		{
+			unsigned int i0 = min(2 * i, width - 1);
+			unsigned int i1 = min(2 * i + 1, width - 1);
+			unsigned int j0 = min(2 * j, height - 1);
+			unsigned int j1 = min(2 * j + 1, height - 1);
+			unsigned int sum = level[packXY(i0, j0, width)] + level[packXY(i1, j0, width)] + level[packXY(i0, j1, width)] + level[packXY(i1, j1, width)];
+			next[packXY(i, j, nextWidth)] = (BYTE)((sum + 2) / 4);
+		}
+	}
+	return next;
 }
 
 /// <summary>
@@ -442,11 +631,15 @@ unsigned int QuadTree::getTotalSizeV(void) const
 /// <returns>Pointeur vers les données de l'indirection pool.</returns>
 float *QuadTree::generateIndirectionPool(bool powerOfTwo, unsigned int maxWidth)
 {
+	QUADTREE_PROFILE_SCOPE(STAGE_POOL_FILL);
+
 	// Si besoin, on diminue la largeur maximale à la puissance de 2 inférieure.
 	if (powerOfTwo) maxWidth = previousPowerOfTwo(maxWidth);
 
-	// On calcul le contenu de l'indirection pool codant l'arbre.
-	unsigned int nPools = computeIndirectionPoolData(maxWidth);
+	// On calcul le contenu de l'indirection pool codant l'arbre. Une racine qui est une feuille occupe tout de même une indirection pool locale.
+	unsigned int nPools = 1;
+	if (!isLeaf()) nPools = computeIndirectionPoolData(maxWidth);
+	else m_poolIndexI = m_poolIndexJ = 0;
 	m_indirectionPoolWidth = min(2 * nPools, maxWidth);
 	m_indirectionPoolHeight = 2 * ((2 * nPools) / maxWidth + 1);
 
@@ -460,7 +653,21 @@ float *QuadTree::generateIndirectionPool(bool powerOfTwo, unsigned int maxWidth)
 	// On aloue l'espace pour stocker l'indirection pool puis on la remplie.
 	float *pool = new float[m_indirectionPoolWidth * m_indirectionPoolHeight * 4];
 	memset(pool, 0, m_indirectionPoolWidth * m_indirectionPoolHeight * 4 * sizeof(float));
-	fillIndirectionPool(pool, m_indirectionPoolWidth, m_indirectionPoolHeight);
+	if (!isLeaf()) fillIndirectionPool(pool, m_indirectionPoolWidth, m_indirectionPoolHeight);
+	else if (!isEmpty())
+	{
+		// Chaque case de l'indirection pool d'une racine feuille désigne le quart correspondant de son patch (comme QuadTreeAtlas::fillLeafRoot).
+		unsigned int sizeU0 = min(m_sizeU - m_sizeU / 2, m_sizeU - 1);
+		unsigned int sizeV0 = min(m_sizeV - m_sizeV / 2, m_sizeV - 1);
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			pool[packXYZ(0, xFromXY(i, 2), yFromXY(i, 2), 4, m_indirectionPoolWidth)] = 1.f;
+			pool[packXYZ(1, xFromXY(i, 2), yFromXY(i, 2), 4, m_indirectionPoolWidth)] = (float)((m_u + xFromXY(i, 2) * sizeU0) / (double)m_totalSizeU);
+			pool[packXYZ(2, xFromXY(i, 2), yFromXY(i, 2), 4, m_indirectionPoolWidth)] = (float)((m_v + yFromXY(i, 2) * sizeV0) / (double)m_totalSizeV);
+			pool[packXYZ(3, xFromXY(i, 2), yFromXY(i, 2), 4, m_indirectionPoolWidth)] = getLayer() / 255.f;
+		}
+	}
+	QUADTREE_PROFILE_COUNT(COUNTER_POOL_CELLS, m_indirectionPoolWidth * m_indirectionPoolHeight);
 	return pool;
 }
 
@@ -472,13 +679,14 @@ float *QuadTree::generateIndirectionPool(bool powerOfTwo, unsigned int maxWidth)
 /// <param name="height">Hauteur de l'indirection pool globale.</param>
 void QuadTree::fillIndirectionPool(float *pool, unsigned int width, unsigned int height)
 {
-	// Afin de représenter l'indirection pool comme une texture en RGBA, on ajoute 0 en quatrième coordonée à chaque case.
+	// Afin de représenter l'indirection pool comme une texture en RGBA, on ajoute une quatrième coordonnée à chaque case :
+	// l'indice de la page de texture contenant le patch divisé par 255 pour une feuille non vide, 0 sinon.
 	for (unsigned int i = 0; i < 4; ++i)
 	{
 		pool[packXYZ(0, m_poolIndexI + xFromXY(i, 2), m_poolIndexJ + yFromXY(i, 2), 4, width)] = m_pool[packXYZ(xFromXY(i, 2), yFromXY(i, 2), 0, 2, 2)];
 		pool[packXYZ(1, m_poolIndexI + xFromXY(i, 2), m_poolIndexJ + yFromXY(i, 2), 4, width)] = m_pool[packXYZ(xFromXY(i, 2), yFromXY(i, 2), 1, 2, 2)];
 		pool[packXYZ(2, m_poolIndexI + xFromXY(i, 2), m_poolIndexJ + yFromXY(i, 2), 4, width)] = m_pool[packXYZ(xFromXY(i, 2), yFromXY(i, 2), 2, 2, 2)];
-		pool[packXYZ(3, m_poolIndexI + xFromXY(i, 2), m_poolIndexJ + yFromXY(i, 2), 4, width)] = 0.f;
+		pool[packXYZ(3, m_poolIndexI + xFromXY(i, 2), m_poolIndexJ + yFromXY(i, 2), 4, width)] = (m_children[i]->isLeaf() && !m_children[i]->isEmpty()) ? m_children[i]->getLayer() / 255.f : 0.f;
 		
 		if (!m_children[i]->isEmpty() && !m_children[i]->isLeaf())
 		{
@@ -553,6 +761,111 @@ unsigned int QuadTree::getIndirectionPoolHeight(void) const
 	return m_indirectionPoolHeight;
 }
 
+/// <summary>
+/// Pour la racine, renvoie le nombre de profondeurs possibles (taille du tableau du nombre de feuilles par profondeur).
+/// </summary>
+/// <returns>Nombre de profondeurs possibles.</returns>
+unsigned int QuadTree::getNDepths(void) const
+{
+	return m_nDepths;
+}
+
+/// <summary>
+/// Pour la racine, renvoie le nombre de feuilles non vides d'une profondeur donnée.
+/// </summary>
+/// <param name="depth">Profondeur en question.</param>
+/// <returns>Nombre de feuilles non vides de profondeur <c>depth</c>.</returns>
+unsigned int QuadTree::getNLeavesAtDepth(unsigned int depth) const
+{
+	return (depth < m_nDepths) ? m_nLeavesAtDepth[depth] : 0;
+}
+
+/// <summary>
+/// Pour la racine, calcule les statistiques de l'arbre : nombre de noeuds par profondeur, tailles des données générées, profondeur de parcours et nombre d'accès mémoire du fragment shader.
+/// Les tailles de la texture et de l'indirection pool ne sont renseignées que si celles-ci ont été générées.
+/// </summary>
+/// <param name="stats">Référence vers la structure à remplir.</param>
+void QuadTree::computeStats(QuadTreeStats &stats) const
+{
+	memset(&stats, 0, sizeof(QuadTreeStats));
+
+	double weightedDepth = 0.;
+	double weightedFetches = 0.;
+	accumulateStats(stats, weightedDepth, weightedFetches);
+
+	// Les moyennes sont pondérées par la surface couverte par chaque feuille, c'est à dire par le nombre de pixels parcourant l'arbre jusqu'à elle.
+	double area = (double)m_totalSizeX * m_totalSizeY;
+	stats.averageLookupDepth = weightedDepth / area;
+	stats.fetchesPerPixel = weightedFetches / area;
+
+	stats.sourceBytes = m_totalSizeX * m_totalSizeY * sizeof(BYTE);
+	stats.atlasBytes = m_totalSizeU * m_totalSizeV * sizeof(BYTE);
+	stats.indirectionPoolBytes = m_indirectionPoolWidth * m_indirectionPoolHeight * 4 * sizeof(float);
+	stats.compressionRatio = (stats.atlasBytes + stats.indirectionPoolBytes) / (double)stats.sourceBytes;
+}
+
+/// <summary>
+/// Ajoute la contribution du noeud et de ses descendants aux statistiques de l'arbre.
+/// </summary>
+/// <param name="stats">Référence vers la structure à remplir.</param>
+/// <param name="weightedDepth">Somme des profondeurs de parcours pondérées par la surface.</param>
+/// <param name="weightedFetches">Somme des accès mémoire pondérés par la surface.</param>
+void QuadTree::accumulateStats(QuadTreeStats &stats, double &weightedDepth, double &weightedFetches) const
+{
+	unsigned int depth = min(m_depth, QuadTreeStats::MAX_DEPTH - 1);
+	stats.nDepths = max(stats.nDepths, depth + 1);
+	++stats.nNodesAtDepth[depth];
+	++stats.nNodes;
+
+	if (isLeaf())
+	{
+		// Le fragment shader lit une case de l'indirection pool par niveau traversé, puis un texel de la texture si la feuille n'est pas vide.
+		double area = (double)getVisibleSizeU() * getVisibleSizeV();
+		unsigned int fetches = max(m_depth, 1u);
+		if (isEmpty())
+		{
+			++stats.nEmptyAtDepth[depth];
+			++stats.nEmpty;
+		}
+		else
+		{
+			++stats.nLeavesAtDepth[depth];
+			++stats.nLeaves;
+			++fetches;
+		}
+		weightedDepth += area * m_depth;
+		weightedFetches += area * fetches;
+		stats.worstLookupDepth = max(stats.worstLookupDepth, m_depth);
+		return;
+	}
+
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		m_children[i]->accumulateStats(stats, weightedDepth, weightedFetches);
+	}
+}
+
+/// <summary>
+/// Affiche un rapport de statistiques.
+/// </summary>
+/// <param name="stats">Statistiques à afficher.</param>
+/// <param name="file">Fichier de destination.</param>
+void QuadTree::printStats(const QuadTreeStats &stats, FILE *file)
+{
+	fprintf(file, "depth    nodes   leaves    empty\n");
+	for (unsigned int d = 0; d < stats.nDepths; ++d)
+	{
+		fprintf(file, "%5u %8u %8u %8u\n", d, stats.nNodesAtDepth[d], stats.nLeavesAtDepth[d], stats.nEmptyAtDepth[d]);
+	}
+	fprintf(file, "total %8u %8u %8u\n", stats.nNodes, stats.nLeaves, stats.nEmpty);
+	fprintf(file, "source bytes           : %u\n", stats.sourceBytes);
+	fprintf(file, "atlas bytes            : %u\n", stats.atlasBytes);
+	fprintf(file, "indirection pool bytes : %u\n", stats.indirectionPoolBytes);
+	fprintf(file, "compression ratio      : %.3f\n", stats.compressionRatio);
+	fprintf(file, "lookup depth (avg/max) : %.3f / %u\n", stats.averageLookupDepth, stats.worstLookupDepth);
+	fprintf(file, "fetches per pixel      : %.3f\n", stats.fetchesPerPixel);
+}
+
 /// <summary>
 /// Calcul la plus grande puissance entière de 2 inférieure ou égale à un nombre.
 /// </summary>
@@ -1,18 +1,66 @@
 ﻿#pragma once
 #include "stdafx.h"
+#include "QuadTreeProfiler.h"
+
+/// <summary>
+/// Critère de subdivision des noeuds d'un quad tree.
+/// Les valeurs par défaut reproduisent le critère exact : un noeud est subdivisé dès qu'il contient à la fois du fond et autre chose que du fond.
+/// </summary>
+struct QuadTreeSplitPolicy
+{
+	/// <summary>Taille minimale (en pixels) du côté d'une feuille : un noeud n'est subdivisé que si ses fils respectent cette taille.</summary>
+	unsigned int minLeafSize;
+	/// <summary>Taille maximale (en pixels) du côté d'une feuille non vide : un noeud plus grand est subdivisé même s'il ne contient pas de fond.</summary>
+	unsigned int maxLeafSize;
+	/// <summary>Profondeur maximale de l'arbre.</summary>
+	unsigned int maxDepth;
+	/// <summary>Proportion de pixels de fond tolérée dans une feuille non vide (ces pixels sont stockés dans le patch).</summary>
+	double maxBackgroundFraction;
+	/// <summary>Intensité moyenne en dessous de laquelle un noeud est considéré vide (erreur absolue moyenne tolérée sur les niveaux de gris).</summary>
+	double maxEmptyError;
+
+	QuadTreeSplitPolicy(void) : minLeafSize(1), maxLeafSize(0xFFFFFFFF), maxDepth(0xFFFFFFFF), maxBackgroundFraction(0.), maxEmptyError(0.) {}
+};
+
+/// <summary>
+/// Statistiques d'un quad tree permettant de juger de l'intérêt de l'encodage pour une image donnée.
+/// </summary>
+struct QuadTreeStats
+{
+	static const unsigned int MAX_DEPTH = 32;
+	unsigned int nDepths;
+	unsigned int nNodesAtDepth[MAX_DEPTH];
+	unsigned int nLeavesAtDepth[MAX_DEPTH];
+	unsigned int nEmptyAtDepth[MAX_DEPTH];
+	unsigned int nNodes;
+	unsigned int nLeaves;
+	unsigned int nEmpty;
+	unsigned int sourceBytes;
+	unsigned int atlasBytes;
+	unsigned int indirectionPoolBytes;
+	double averageLookupDepth;
+	unsigned int worstLookupDepth;
+	double fetchesPerPixel;
+	double compressionRatio;
+};
 
 /// <summary>
 /// Classe représentant un noeud d'un quad tree.
 /// </summary>
 class QuadTree
 {
+	friend class QuadTreeAtlas;
+	friend class QuadTreePageCache;
+
 public:
 	QuadTree(void);
-	QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int totalSizeY);
+	QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int totalSizeY, const QuadTreeSplitPolicy &splitPolicy = QuadTreeSplitPolicy(), bool powerOfTwoRoot = false);
 	~QuadTree(void);
 	bool isLeaf(void) const;
 	bool isEmpty(void) const; 
-	BYTE *generateTexture(bool powerOfTwo = true);
+	BYTE *generateTexture(bool powerOfTwo = true, unsigned int gutter = 0, unsigned int mipLevels = 0, unsigned int blockSize = 1);
+	void packTexture(bool powerOfTwo = true, unsigned int gutter = 0, unsigned int mipLevels = 0, unsigned int blockSize = 1);
+	void writeTexture(BYTE *texture) const;
 	float *generateIndirectionPool(bool powerOfTwo = true, unsigned int maxWidth = 2048);
 	unsigned int getNLeaves(void) const;
 	unsigned int getSizeU(void) const;
@@ -32,16 +80,27 @@ public:
 	unsigned int getX(void) const;
 	unsigned int getY(void) const;
 	unsigned int getDepth(void) const;	
+	unsigned int getLayer(void) const;
 	const QuadTree *getLeaf(unsigned int i) const;
+	unsigned int getVisibleLeaves(double x0, double y0, double x1, double y1, const QuadTree **leaves) const;
 	unsigned int getIndirectionPoolWidth(void) const;
 	unsigned int getIndirectionPoolHeight(void) const;
+	unsigned int getNDepths(void) const;
+	unsigned int getNLeavesAtDepth(unsigned int depth) const;
+	void computeStats(QuadTreeStats &stats) const;
+	static void printStats(const QuadTreeStats &stats, FILE *file = stdout);
+	static BYTE *generateMipmapLevel(const BYTE *level, unsigned int width, unsigned int height);
 	static unsigned int nextPowerOfTwo(double n);
 	static unsigned int previousPowerOfTwo(double n);
 
 private:
-	QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int totalSizeY, unsigned int sizeX, unsigned int sizeY, unsigned int x, unsigned int y, unsigned int *nLeavesAtDepth, unsigned int depth);
+	QuadTree(const BYTE *data, unsigned int totalSizeX, unsigned int totalSizeY, unsigned int sizeX, unsigned int sizeY, unsigned int x, unsigned int y, unsigned int *nLeavesAtDepth, unsigned int depth, const QuadTreeSplitPolicy *splitPolicy);
 	void initNode();
+	unsigned int getVisibleSizeU(void) const;
+	unsigned int getVisibleSizeV(void) const;
 	void orderLeaves(QuadTree **orderedLeaves);
+	void accumulateStats(QuadTreeStats &stats, double &weightedDepth, double &weightedFetches) const;
+	void copyPatch(BYTE *texture, unsigned int textureWidth, unsigned int gutter) const;
 	void fillIndirectionPool(float *pool, unsigned int width, unsigned int height);
 	unsigned int computeIndirectionPoolData(unsigned int maxWidth, unsigned int index = 0);
 	unsigned int m_indirectionPoolWidth;
@@ -51,6 +110,8 @@ private:
 	float m_pool[12];
 	QuadTree **m_orderedLeaves;
 	unsigned int *m_nLeavesAtDepth;
+	unsigned int m_nDepths;
+	const QuadTreeSplitPolicy *m_splitPolicy;
 	unsigned int m_nLeaves;
 	unsigned int m_depth;
 	bool m_isRoot;
@@ -68,5 +129,9 @@ private:
 	unsigned int m_v;
 	unsigned int m_sizeU;
 	unsigned int m_sizeV;
+	unsigned int m_slotSizeU;
+	unsigned int m_slotSizeV;
+	unsigned int m_layer;
+	unsigned int m_gutter;
 };
 
@@ -0,0 +1,320 @@
+﻿#include "QuadTreeAtlas.h"
+
+/// <summary>
+/// Crée un atlas vide.
+/// </summary>
+/// <param name="pageWidth">Largeur souhaitée des pages (augmentée si un patch est plus large).</param>
+/// <param name="pageHeight">Hauteur souhaitée des pages (augmentée si un patch est plus haut).</param>
+QuadTreeAtlas::QuadTreeAtlas(unsigned int pageWidth, unsigned int pageHeight)
+	: m_trees(NULL), m_nTrees(0), m_treesCapacity(0), m_leaves(NULL), m_nLeaves(0), m_nPages(0), m_pageWidth(pageWidth), m_pageHeight(pageHeight), m_indirectionPoolWidth(0), m_indirectionPoolHeight(0)
+{
+}
+
+/// <summary>
+/// Détruit l'atlas ainsi que les quad trees qui lui ont été ajoutés.
+/// </summary>
+QuadTreeAtlas::~QuadTreeAtlas(void)
+{
+	for (unsigned int i = 0; i < m_nTrees; ++i)
+	{
+		delete m_trees[i];
+	}
+	delete[] m_trees;
+	delete[] m_leaves;
+}
+
+/// <summary>
+/// Ajoute un quad tree à l'atlas, qui en devient propriétaire. Les données de l'image doivent rester valides jusqu'à l'appel de <c>generateTexture</c>.
+/// </summary>
+/// <param name="tree">Racine du quad tree à ajouter.</param>
+/// <returns>Indice de l'image dans l'atlas.</returns>
+unsigned int QuadTreeAtlas::addTree(QuadTree *tree)
+{
+	if (m_nTrees == m_treesCapacity)
+	{
+		m_treesCapacity = max(2 * m_treesCapacity, 64u);
+		QuadTree **trees = new QuadTree*[m_treesCapacity];
+		if (m_trees != NULL) memcpy(trees, m_trees, m_nTrees * sizeof(QuadTree*));
+		delete[] m_trees;
+		m_trees = trees;
+	}
+	m_trees[m_nTrees] = tree;
+	return m_nTrees++;
+}
+
+/// <summary>
+/// Compare deux feuilles par hauteur puis par largeur d'emplacement décroissantes (fonction de comparaison de <c>qsort</c>).
+/// </summary>
+int QuadTreeAtlas::compareSlots(const void *a, const void *b)
+{
+	const QuadTree *leafA = *(const QuadTree* const*)a;
+	const QuadTree *leafB = *(const QuadTree* const*)b;
+	if (leafA->m_slotSizeV != leafB->m_slotSizeV) return (leafA->m_slotSizeV > leafB->m_slotSizeV) ? -1 : 1;
+	if (leafA->m_slotSizeU != leafB->m_slotSizeU) return (leafA->m_slotSizeU > leafB->m_slotSizeU) ? -1 : 1;
+	return 0;
+}
+
+/// <summary>
+/// Génère les pages de texture contenant les patches de toutes les images.
+/// Les feuilles de tous les arbres sont triées par hauteur décroissante puis rangées par étagères, une nouvelle page étant commencée lorsque la page courante est pleine.
+/// </summary>
+/// <returns>Pointeur vers les données des pages, stockées les unes à la suite des autres (<c>NULL</c> si le nombre de pages dépasse <c>MAX_PAGES</c>).</returns>
+BYTE *QuadTreeAtlas::generateTexture(void)
+{
+	QUADTREE_PROFILE_BEGIN(STAGE_ORDER);
+	// On rassemble les feuilles non vides de tous les arbres.
+	m_nLeaves = 0;
+	for (unsigned int t = 0; t < m_nTrees; ++t)
+	{
+		m_nLeaves += m_trees[t]->getNLeaves();
+	}
+	delete[] m_leaves;
+	m_leaves = new QuadTree*[max(m_nLeaves, 1u)];
+
+	unsigned int n = 0;
+	for (unsigned int t = 0; t < m_nTrees; ++t)
+	{
+		QuadTree *tree = m_trees[t];
+		if (tree->getNLeaves() == 0) continue;
+		if (tree->m_orderedLeaves == NULL)
+		{
+			tree->m_orderedLeaves = new QuadTree*[tree->getNLeaves()];
+			memset(tree->m_orderedLeaves, NULL, tree->getNLeaves() * sizeof(QuadTree*));
+			tree->orderLeaves(tree->m_orderedLeaves);
+		}
+		memcpy(m_leaves + n, tree->m_orderedLeaves, tree->getNLeaves() * sizeof(QuadTree*));
+		n += tree->getNLeaves();
+	}
+
+	// Chaque patch occupe un emplacement de sa taille, les pages étant agrandies si besoin pour contenir le plus grand.
+	for (unsigned int i = 0; i < m_nLeaves; ++i)
+	{
+		m_leaves[i]->m_slotSizeU = m_leaves[i]->getSizeU();
+		m_leaves[i]->m_slotSizeV = m_leaves[i]->getSizeV();
+		m_pageWidth = max(m_pageWidth, QuadTree::nextPowerOfTwo(m_leaves[i]->m_slotSizeU));
+		m_pageHeight = max(m_pageHeight, QuadTree::nextPowerOfTwo(m_leaves[i]->m_slotSizeV));
+	}
+	qsort(m_leaves, m_nLeaves, sizeof(QuadTree*), compareSlots);
+	QUADTREE_PROFILE_END(STAGE_ORDER);
+
+	QUADTREE_PROFILE_BEGIN(STAGE_PACK);
+	// On range les patches de gauche à droite sur des étagères dont la hauteur est celle de leur premier patch (le plus haut).
+	unsigned int shelfU = 0;
+	unsigned int shelfV = 0;
+	unsigned int shelfHeight = 0;
+	unsigned int page = 0;
+	for (unsigned int i = 0; i < m_nLeaves; ++i)
+	{
+		QuadTree *leaf = m_leaves[i];
+		if (shelfU + leaf->m_slotSizeU > m_pageWidth)
+		{
+			shelfV += shelfHeight;
+			shelfU = 0;
+			shelfHeight = 0;
+		}
+		if (shelfV + leaf->m_slotSizeV > m_pageHeight)
+		{
+			++page;
+			shelfU = 0;
+			shelfV = 0;
+			shelfHeight = 0;
+		}
+		leaf->m_u = shelfU;
+		leaf->m_v = shelfV;
+		leaf->m_layer = page;
+		leaf->m_totalSizeU = m_pageWidth;
+		leaf->m_totalSizeV = m_pageHeight;
+		shelfU += leaf->m_slotSizeU;
+		shelfHeight = max(shelfHeight, leaf->m_slotSizeV);
+	}
+	m_nPages = (m_nLeaves > 0) ? page + 1 : 0;
+	QUADTREE_PROFILE_END(STAGE_PACK);
+
+	if (m_nPages > MAX_PAGES)
+	{
+		fprintf(stderr, "[ERROR] %u texture pages needed (at most %u)\n", m_nPages, MAX_PAGES);
+		return NULL;
+	}
+	for (unsigned int t = 0; t < m_nTrees; ++t)
+	{
+		m_trees[t]->m_totalSizeU = m_pageWidth;
+		m_trees[t]->m_totalSizeV = m_pageHeight;
+	}
+
+	QUADTREE_PROFILE_BEGIN(STAGE_BLIT);
+	// On copie chaque patch dans sa page.
+	unsigned int pageSize = m_pageWidth * m_pageHeight;
+	BYTE *texture = new BYTE[max(m_nPages, 1u) * pageSize];
+	memset(texture, 0, max(m_nPages, 1u) * pageSize);
+	for (unsigned int i = 0; i < m_nLeaves; ++i)
+	{
+		m_leaves[i]->copyPatch(texture + m_leaves[i]->m_layer * pageSize, m_pageWidth, 0);
+	}
+	QUADTREE_PROFILE_END(STAGE_BLIT);
+
+#ifdef QUADTREE_PROFILING
+	// On comptabilise les texels des pages non couverts par un patch.
+	unsigned int usedTexels = 0;
+	for (unsigned int i = 0; i < m_nLeaves; ++i)
+	{
+		usedTexels += m_leaves[i]->getSizeU() * m_leaves[i]->getSizeV();
+	}
+	QUADTREE_PROFILE_COUNT(COUNTER_ATLAS_WASTE, m_nPages * pageSize - usedTexels);
+#endif
+
+	return texture;
+}
+
+/// <summary>
+/// Génère l'indirection pool commune à toutes les images, les indirection pools locales des arbres étant placées les unes à la suite des autres.
+/// Doit être appelée après <c>generateTexture</c>.
+/// </summary>
+/// <param name="powerOfTwo">Spécifie si les dimensions de l'indirection pool doivent être des puissances entières de 2.</param>
+/// <param name="maxWidth">Largeur maximale de l'indirection pool.</param>
+/// <returns>Pointeur vers les données de l'indirection pool.</returns>
+float *QuadTreeAtlas::generateIndirectionPool(bool powerOfTwo, unsigned int maxWidth)
+{
+	QUADTREE_PROFILE_SCOPE(STAGE_POOL_FILL);
+
+	if (powerOfTwo) maxWidth = QuadTree::previousPowerOfTwo(maxWidth);
+
+	// On place les arbres les uns à la suite des autres. Une racine qui est une feuille occupe tout de même une indirection pool locale.
+	unsigned int index = 0;
+	for (unsigned int t = 0; t < m_nTrees; ++t)
+	{
+		QuadTree *tree = m_trees[t];
+		if (!tree->isLeaf())
+		{
+			index = tree->computeIndirectionPoolData(maxWidth, index);
+		}
+		else
+		{
+			tree->m_poolIndexI = 2 * xFromXY(index, maxWidth / 2);
+			tree->m_poolIndexJ = 2 * yFromXY(index, maxWidth / 2);
+			++index;
+		}
+	}
+	m_indirectionPoolWidth = min(2 * index, maxWidth);
+	m_indirectionPoolHeight = 2 * ((2 * index) / maxWidth + 1);
+
+	if (powerOfTwo)
+	{
+		m_indirectionPoolWidth = QuadTree::nextPowerOfTwo(m_indirectionPoolWidth);
+		m_indirectionPoolHeight = QuadTree::nextPowerOfTwo(m_indirectionPoolHeight);
+	}
+
+	float *pool = new float[m_indirectionPoolWidth * m_indirectionPoolHeight * 4];
+	memset(pool, 0, m_indirectionPoolWidth * m_indirectionPoolHeight * 4 * sizeof(float));
+	for (unsigned int t = 0; t < m_nTrees; ++t)
+	{
+		QuadTree *tree = m_trees[t];
+		if (!tree->isLeaf()) tree->fillIndirectionPool(pool, m_indirectionPoolWidth, m_indirectionPoolHeight);
+		else if (!tree->isEmpty()) fillLeafRoot(tree, pool);
+	}
+	QUADTREE_PROFILE_COUNT(COUNTER_POOL_CELLS, m_indirectionPoolWidth * m_indirectionPoolHeight);
+	return pool;
+}
+
+/// <summary>
+/// Remplit l'indirection pool locale d'une racine qui est une feuille non vide : chaque case désigne le quart correspondant de son patch.
+/// </summary>
+/// <param name="tree">Racine en question.</param>
+/// <param name="pool">Pointeur vers les données de l'indirection pool commune.</param>
+void QuadTreeAtlas::fillLeafRoot(const QuadTree *tree, float *pool) const
+{
+	unsigned int sizeU0 = min(tree->getSizeU() - tree->getSizeU() / 2, tree->getSizeU() - 1);
+	unsigned int sizeV0 = min(tree->getSizeV() - tree->getSizeV() / 2, tree->getSizeV() - 1);
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		unsigned int poolI = tree->m_poolIndexI + xFromXY(i, 2);
+		unsigned int poolJ = tree->m_poolIndexJ + yFromXY(i, 2);
+		pool[packXYZ(0, poolI, poolJ, 4, m_indirectionPoolWidth)] = 1.f;
+		pool[packXYZ(1, poolI, poolJ, 4, m_indirectionPoolWidth)] = (tree->getU() + xFromXY(i, 2) * sizeU0) / (float)m_pageWidth;
+		pool[packXYZ(2, poolI, poolJ, 4, m_indirectionPoolWidth)] = (tree->getV() + yFromXY(i, 2) * sizeV0) / (float)m_pageHeight;
+		pool[packXYZ(3, poolI, poolJ, 4, m_indirectionPoolWidth)] = tree->getLayer() / 255.f;
+	}
+}
+
+/// <summary>
+/// Renvoie le nombre d'images de l'atlas.
+/// </summary>
+/// <returns>Nombre d'images.</returns>
+unsigned int QuadTreeAtlas::getNTrees(void) const
+{
+	return m_nTrees;
+}
+
+/// <summary>
+/// Renvoie la racine du quad tree d'une image.
+/// </summary>
+/// <param name="i">Indice de l'image.</param>
+/// <returns>Racine du quad tree de l'image.</returns>
+QuadTree *QuadTreeAtlas::getTree(unsigned int i) const
+{
+	return m_trees[i];
+}
+
+/// <summary>
+/// Renvoie le nombre de pages de texture générées.
+/// </summary>
+/// <returns>Nombre de pages.</returns>
+unsigned int QuadTreeAtlas::getNPages(void) const
+{
+	return m_nPages;
+}
+
+/// <summary>
+/// Renvoie la largeur des pages de texture.
+/// </summary>
+/// <returns>Largeur des pages.</returns>
+unsigned int QuadTreeAtlas::getPageWidth(void) const
+{
+	return m_pageWidth;
+}
+
+/// <summary>
+/// Renvoie la hauteur des pages de texture.
+/// </summary>
+/// <returns>Hauteur des pages.</returns>
+unsigned int QuadTreeAtlas::getPageHeight(void) const
+{
+	return m_pageHeight;
+}
+
+/// <summary>
+/// Renvoie la largeur de l'indirection pool commune.
+/// </summary>
+/// <returns>Largeur de l'indirection pool.</returns>
+unsigned int QuadTreeAtlas::getIndirectionPoolWidth(void) const
+{
+	return m_indirectionPoolWidth;
+}
+
+/// <summary>
+/// Renvoie la hauteur de l'indirection pool commune.
+/// </summary>
+/// <returns>Hauteur de l'indirection pool.</returns>
+unsigned int QuadTreeAtlas::getIndirectionPoolHeight(void) const
+{
+	return m_indirectionPoolHeight;
+}
+
+/// <summary>
+/// Renvoie la première coordonnée de l'indirection pool locale de la racine d'une image dans l'indirection pool commune.
+/// </summary>
+/// <param name="i">Indice de l'image.</param>
+/// <returns>Première coordonnée de la racine.</returns>
+unsigned int QuadTreeAtlas::getRootIndexI(unsigned int i) const
+{
+	return m_trees[i]->m_poolIndexI;
+}
+
+/// <summary>
+/// Renvoie la seconde coordonnée de l'indirection pool locale de la racine d'une image dans l'indirection pool commune.
+/// </summary>
+/// <param name="i">Indice de l'image.</param>
+/// <returns>Seconde coordonnée de la racine.</returns>
+unsigned int QuadTreeAtlas::getRootIndexJ(unsigned int i) const
+{
+	return m_trees[i]->m_poolIndexJ;
+}
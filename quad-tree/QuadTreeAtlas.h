@@ -0,0 +1,45 @@
+﻿/*! \file */
+#pragma once
+#include "stdafx.h"
+#include "QuadTree.h"
+
+/// <summary>
+/// Regroupe les patches de plusieurs quad trees dans des pages de texture communes (destinées à un tableau de textures)
+/// et leurs arbres dans une indirection pool commune, chaque image étant repérée par la position de sa racine dans l'indirection pool.
+/// Toutes les images peuvent ainsi être affichées avec les mêmes textures, en un seul appel de dessin.
+/// </summary>
+class QuadTreeAtlas
+{
+public:
+	/// <summary>Nombre maximal de pages, l'indice de page étant stocké sur 8 bits dans l'indirection pool.</summary>
+	static const unsigned int MAX_PAGES = 256;
+
+	QuadTreeAtlas(unsigned int pageWidth = 1024, unsigned int pageHeight = 1024);
+	~QuadTreeAtlas(void);
+	unsigned int addTree(QuadTree *tree);
+	BYTE *generateTexture(void);
+	float *generateIndirectionPool(bool powerOfTwo = true, unsigned int maxWidth = 2048);
+	unsigned int getNTrees(void) const;
+	QuadTree *getTree(unsigned int i) const;
+	unsigned int getNPages(void) const;
+	unsigned int getPageWidth(void) const;
+	unsigned int getPageHeight(void) const;
+	unsigned int getIndirectionPoolWidth(void) const;
+	unsigned int getIndirectionPoolHeight(void) const;
+	unsigned int getRootIndexI(unsigned int i) const;
+	unsigned int getRootIndexJ(unsigned int i) const;
+
+private:
+	static int compareSlots(const void *a, const void *b);
+	void fillLeafRoot(const QuadTree *tree, float *pool) const;
+	QuadTree **m_trees;
+	unsigned int m_nTrees;
+	unsigned int m_treesCapacity;
+	QuadTree **m_leaves;
+	unsigned int m_nLeaves;
+	unsigned int m_nPages;
+	unsigned int m_pageWidth;
+	unsigned int m_pageHeight;
+	unsigned int m_indirectionPoolWidth;
+	unsigned int m_indirectionPoolHeight;
+};
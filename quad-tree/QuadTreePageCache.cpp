@@ -0,0 +1,504 @@
+﻿#include "QuadTreePageCache.h"
+
+/// <summary>
+/// Crée la texture virtuelle d'un quad tree : découpe l'arbre en pages et génère l'indirection pool, dans laquelle toutes les pages sont absentes.
+/// Les données de l'image doivent rester valides tant que des pages sont chargées.
+/// </summary>
+/// <param name="root">Racine du quad tree, qui ne doit pas être une feuille. Ses feuilles non vides ne doivent pas dépasser <c>pageSize</c> (voir <c>QuadTreeSplitPolicy::maxLeafSize</c>)
+/// et il ne doit pas compter plus de <c>MAX_PAGES</c> pages (voir <c>countPages</c>).</param>
+/// <param name="pageSize">Côté des pages et des emplacements de la texture cache.</param>
+/// <param name="cacheWidth">Largeur de la texture cache.</param>
+/// <param name="cacheHeight">Hauteur de la texture cache.</param>
+/// <param name="powerOfTwo">Spécifie si les dimensions de l'indirection pool doivent être des puissances entières de 2.</param>
+/// <param name="maxPoolWidth">Largeur maximale de l'indirection pool.</param>
+QuadTreePageCache::QuadTreePageCache(QuadTree *root, unsigned int pageSize, unsigned int cacheWidth, unsigned int cacheHeight, bool powerOfTwo, unsigned int maxPoolWidth)
+	: m_root(root), m_pageSize(pageSize), m_cacheWidth(cacheWidth), m_cacheHeight(cacheHeight), m_nPages(0), m_nResident(0), m_nEvictions(0), m_nRequests(0), m_nUploads(0), m_frame(1), m_dirty(false)
+{
+	// On découpe l'arbre en pages, en comptant d'abord leur nombre. Au-delà de MAX_PAGES, les indices de page ne seraient plus représentables dans l'indirection pool.
+	unsigned int nPages = countPages(m_root, m_pageSize);
+	if (nPages > MAX_PAGES)
+	{
+		fprintf(stderr, "[ERROR] %u pages (at most %u are addressable, increase the page size)\n", nPages, MAX_PAGES);
+		exit(1);
+	}
+	m_pages = new Page[max(nPages, 1u)];
+	m_nPages = nPages;
+	nPages = 0;
+	collectPages(m_root, nPages);
+
+	// La texture cache est découpée en emplacements de la taille d'une page.
+	m_slotsPerRow = m_cacheWidth / m_pageSize;
+	m_nSlots = m_slotsPerRow * (m_cacheHeight / m_pageSize);
+	if (m_nSlots == 0) fprintf(stderr, "[ERROR] Texture cache %ux%u smaller than a page (%u)\n", m_cacheWidth, m_cacheHeight, m_pageSize);
+	m_slotPages = new unsigned int[max(m_nSlots, 1u)];
+	m_slotFrames = new unsigned int[max(m_nSlots, 1u)];
+	for (unsigned int i = 0; i < m_nSlots; ++i)
+	{
+		m_slotPages[i] = NONE;
+		m_slotFrames[i] = 0;
+	}
+	m_requests = new unsigned int[max(m_nPages, 1u)];
+	m_uploads = new unsigned int[max(m_nSlots, 1u)];
+
+	// On génère l'indirection pool de l'arbre entier (les feuilles des pages étant provisoirement placées à l'origine de la texture cache).
+	if (powerOfTwo) maxPoolWidth = QuadTree::previousPowerOfTwo(maxPoolWidth);
+	unsigned int nPools = m_root->computeIndirectionPoolData(maxPoolWidth);
+	m_poolWidth = min(2 * nPools, maxPoolWidth);
+	m_poolHeight = 2 * ((2 * nPools) / maxPoolWidth + 1);
+	if (powerOfTwo)
+	{
+		m_poolWidth = QuadTree::nextPowerOfTwo(m_poolWidth);
+		m_poolHeight = QuadTree::nextPowerOfTwo(m_poolHeight);
+	}
+	m_pool = new float[m_poolWidth * m_poolHeight * 4];
+	memset(m_pool, 0, m_poolWidth * m_poolHeight * 4 * sizeof(float));
+	m_root->fillIndirectionPool(m_pool, m_poolWidth, m_poolHeight);
+
+	// Toutes les pages sont initialement absentes.
+	for (unsigned int p = 0; p < m_nPages; ++p)
+	{
+		writePageEntry(p);
+	}
+}
+
+QuadTreePageCache::~QuadTreePageCache(void)
+{
+	delete[] m_pages;
+	delete[] m_slotPages;
+	delete[] m_slotFrames;
+	delete[] m_requests;
+	delete[] m_uploads;
+	delete[] m_pool;
+}
+
+/// <summary>
+/// Compte les pages d'un quad tree : un fils non vide est une page s'il ne dépasse pas la taille d'une page ou s'il est une feuille.
+/// Permet de vérifier, avant de créer la texture virtuelle, que les pages sont adressables (au plus <c>MAX_PAGES</c>).
+/// </summary>
+/// <param name="node">Noeud en question, qui ne doit pas être une feuille.</param>
+/// <param name="pageSize">Côté des pages.</param>
+/// <returns>Nombre de pages sous le noeud.</returns>
+unsigned int QuadTreePageCache::countPages(const QuadTree *node, unsigned int pageSize)
+{
+	unsigned int nPages = 0;
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		const QuadTree *child = node->m_children[i];
+		if (child->isEmpty()) continue;
+		if (max(child->getSizeU(), child->getSizeV()) > pageSize && !child->isLeaf()) nPages += countPages(child, pageSize);
+		else ++nPages;
+	}
+	return nPages;
+}
+
+/// <summary>
+/// Parcourt les fils d'un noeud à la recherche des pages (voir <c>countPages</c>) et les enregistre.
+/// </summary>
+/// <param name="node">Noeud en question.</param>
+/// <param name="nPages">Nombre de pages déjà trouvées.</param>
+void QuadTreePageCache::collectPages(QuadTree *node, unsigned int &nPages)
+{
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		QuadTree *child = node->m_children[i];
+		if (child->isEmpty()) continue;
+		if (max(child->getSizeU(), child->getSizeV()) > m_pageSize && !child->isLeaf())
+		{
+			collectPages(child, nPages);
+			continue;
+		}
+
+		if (max(child->getSizeU(), child->getSizeV()) > m_pageSize) fprintf(stderr, "[WARNING] Leaf of size %ux%u larger than a page, cropped\n", child->getSizeU(), child->getSizeV());
+		m_pages[nPages].node = child;
+		m_pages[nPages].parent = node;
+		m_pages[nPages].child = i;
+		m_pages[nPages].slot = NONE;
+		m_pages[nPages].requestFrame = 0;
+		initPageLeaves(child);
+		++nPages;
+	}
+}
+
+/// <summary>
+/// Place provisoirement les feuilles d'une page à l'origine de la texture cache, avant la génération de l'indirection pool.
+/// </summary>
+/// <param name="node">Noeud de la page en question.</param>
+void QuadTreePageCache::initPageLeaves(QuadTree *node)
+{
+	if (node->isLeaf())
+	{
+		node->m_u = 0;
+		node->m_v = 0;
+		node->m_totalSizeU = m_cacheWidth;
+		node->m_totalSizeV = m_cacheHeight;
+		return;
+	}
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		initPageLeaves(node->m_children[i]);
+	}
+}
+
+/// <summary>
+/// Renvoie la case de l'indirection pool décrivant un fils d'un noeud.
+/// </summary>
+/// <param name="node">Noeud en question.</param>
+/// <param name="child">Indice du fils.</param>
+/// <returns>Pointeur vers les 4 coordonnées de la case.</returns>
+float *QuadTreePageCache::getCell(const QuadTree *node, unsigned int child)
+{
+	return m_pool + packXYZ(0, node->m_poolIndexI + xFromXY(child, 2), node->m_poolIndexJ + yFromXY(child, 2), 4, m_poolWidth);
+}
+
+/// <summary>
+/// Etend le rectangle modifié de l'indirection pool à la case décrivant un fils d'un noeud.
+/// </summary>
+/// <param name="node">Noeud en question.</param>
+/// <param name="child">Indice du fils.</param>
+void QuadTreePageCache::markDirty(const QuadTree *node, unsigned int child)
+{
+	unsigned int i = node->m_poolIndexI + xFromXY(child, 2);
+	unsigned int j = node->m_poolIndexJ + yFromXY(child, 2);
+	if (!m_dirty)
+	{
+		m_dirty = true;
+		m_dirtyI0 = m_dirtyI1 = i;
+		m_dirtyJ0 = m_dirtyJ1 = j;
+		return;
+	}
+	m_dirtyI0 = min(m_dirtyI0, i);
+	m_dirtyJ0 = min(m_dirtyJ0, j);
+	m_dirtyI1 = max(m_dirtyI1, i);
+	m_dirtyJ1 = max(m_dirtyJ1, j);
+}
+
+/// <summary>
+/// Réécrit l'entrée de l'indirection pool désignant une page : vide si la page est absente, sinon pointant vers son emplacement (feuille) ou vers son indirection pool locale.
+/// Dans ce dernier cas, les entrées des feuilles de la page sont également réécrites.
+/// </summary>
+/// <param name="page">Indice de la page.</param>
+void QuadTreePageCache::writePageEntry(unsigned int page)
+{
+	const Page &p = m_pages[page];
+	float *cell = getCell(p.parent, p.child);
+	markDirty(p.parent, p.child);
+	cell[3] = (page + 1) / 65535.f;
+	if (p.slot == NONE)
+	{
+		cell[0] = cell[1] = cell[2] = 0.f;
+	}
+	else if (p.node->isLeaf())
+	{
+		cell[0] = 1.f;
+		cell[1] = getSlotU(p.slot) / (float)m_cacheWidth;
+		cell[2] = getSlotV(p.slot) / (float)m_cacheHeight;
+	}
+	else
+	{
+		cell[0] = .5f;
+		cell[1] = p.node->m_poolIndexI / (float)m_poolWidth;
+		cell[2] = p.node->m_poolIndexJ / (float)m_poolHeight;
+		writeLeafEntries(p.node, p.node, getSlotU(p.slot), getSlotV(p.slot));
+	}
+}
+
+/// <summary>
+/// Réécrit les entrées des feuilles non vides descendant d'un noeud d'une page, dont les patches sont placés dans l'emplacement de la page à leur position relative.
+/// </summary>
+/// <param name="node">Noeud en question.</param>
+/// <param name="pageNode">Noeud de la page.</param>
+/// <param name="slotU">Première coordonnée de l'emplacement de la page.</param>
+/// <param name="slotV">Seconde coordonnée de l'emplacement de la page.</param>
+void QuadTreePageCache::writeLeafEntries(const QuadTree *node, const QuadTree *pageNode, unsigned int slotU, unsigned int slotV)
+{
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		const QuadTree *child = node->m_children[i];
+		if (child->isEmpty()) continue;
+		if (!child->isLeaf())
+		{
+			writeLeafEntries(child, pageNode, slotU, slotV);
+			continue;
+		}
+		float *cell = getCell(node, i);
+		markDirty(node, i);
+		cell[1] = (slotU + child->getX() - pageNode->getX()) / (float)m_cacheWidth;
+		cell[2] = (slotV + child->getY() - pageNode->getY()) / (float)m_cacheHeight;
+	}
+}
+
+/// <summary>
+/// Signale qu'une page est nécessaire à l'image courante. Une page déjà présente est marquée comme utilisée.
+/// </summary>
+/// <param name="page">Indice de la page (ignoré s'il est invalide).</param>
+void QuadTreePageCache::request(unsigned int page)
+{
+	if (page >= m_nPages || m_pages[page].requestFrame == m_frame) return;
+	m_pages[page].requestFrame = m_frame;
+	m_requests[m_nRequests++] = page;
+	if (m_pages[page].slot != NONE) m_slotFrames[m_pages[page].slot] = m_frame;
+}
+
+/// <summary>
+/// Signale que toutes les pages intersectant une région de l'image sont nécessaires (alternative à la passe de rendu déterminant les pages visibles).
+/// </summary>
+/// <param name="x0">Première coordonnée horizontale normalisée de la région.</param>
+/// <param name="y0">Première coordonnée verticale normalisée de la région.</param>
+/// <param name="x1">Dernière coordonnée horizontale normalisée de la région.</param>
+/// <param name="y1">Dernière coordonnée verticale normalisée de la région.</param>
+/// <returns>Nombre de pages intersectant la région.</returns>
+unsigned int QuadTreePageCache::requestRegion(double x0, double y0, double x1, double y1)
+{
+	unsigned int n = 0;
+	for (unsigned int p = 0; p < m_nPages; ++p)
+	{
+		const QuadTree *node = m_pages[p].node;
+		if (node->getX0d() >= x1 || node->getX1d() <= x0 || node->getY0d() >= y1 || node->getY1d() <= y0) continue;
+		request(p);
+		++n;
+	}
+	return n;
+}
+
+/// <summary>
+/// Renvoie l'emplacement à attribuer à une nouvelle page : un emplacement libre, sinon le moins récemment utilisé parmi ceux qui ne sont pas utilisés par l'image courante.
+/// </summary>
+/// <returns>Indice de l'emplacement, <c>NONE</c> si tous sont utilisés par l'image courante.</returns>
+unsigned int QuadTreePageCache::findSlot(void) const
+{
+	unsigned int slot = NONE;
+	for (unsigned int i = 0; i < m_nSlots; ++i)
+	{
+		if (m_slotFrames[i] < m_frame && (slot == NONE || m_slotFrames[i] < m_slotFrames[slot])) slot = i;
+	}
+	return slot;
+}
+
+/// <summary>
+/// Termine l'image courante : charge au plus <c>maxUploads</c> pages demandées et absentes, en évinçant si besoin les moins récemment utilisées.
+/// Les pages non chargées faute de place ou de budget restent absentes et doivent être redemandées.
+/// </summary>
+/// <param name="maxUploads">Nombre maximal de pages chargées.</param>
+/// <returns>Nombre de pages chargées, dont les indices sont donnés par <c>getUploadPage</c>.</returns>
+unsigned int QuadTreePageCache::update(unsigned int maxUploads)
+{
+	m_nUploads = 0;
+	for (unsigned int r = 0; r < m_nRequests && m_nUploads < maxUploads; ++r)
+	{
+		unsigned int page = m_requests[r];
+		if (m_pages[page].slot != NONE) continue;
+		unsigned int slot = findSlot();
+		if (slot == NONE) break;
+
+		// On évince la page occupant l'emplacement.
+		unsigned int evicted = m_slotPages[slot];
+		if (evicted != NONE)
+		{
+			m_pages[evicted].slot = NONE;
+			writePageEntry(evicted);
+			++m_nEvictions;
+			--m_nResident;
+		}
+
+		m_slotPages[slot] = page;
+		m_slotFrames[slot] = m_frame;
+		m_pages[page].slot = slot;
+		writePageEntry(page);
+		++m_nResident;
+		m_uploads[m_nUploads++] = page;
+	}
+	m_nRequests = 0;
+	++m_frame;
+	return m_nUploads;
+}
+
+/// <summary>
+/// Renvoie le nombre de pages chargées lors du dernier appel à <c>update</c>.
+/// </summary>
+/// <returns>Nombre de pages chargées.</returns>
+unsigned int QuadTreePageCache::getNUploads(void) const
+{
+	return m_nUploads;
+}
+
+/// <summary>
+/// Renvoie l'indice d'une page chargée lors du dernier appel à <c>update</c>.
+/// </summary>
+/// <param name="i">Indice du chargement.</param>
+/// <returns>Indice de la page, à copier dans son emplacement (<c>getSlot</c>).</returns>
+unsigned int QuadTreePageCache::getUploadPage(unsigned int i) const
+{
+	return m_uploads[i];
+}
+
+/// <summary>
+/// Copie le contenu d'une page (la partie hors de l'image restant noire).
+/// </summary>
+/// <param name="page">Indice de la page.</param>
+/// <param name="buffer">Pointeur vers un tableau de <c>pageSize * pageSize</c> octets.</param>
+void QuadTreePageCache::copyPage(unsigned int page, BYTE *buffer) const
+{
+	const QuadTree *node = m_pages[page].node;
+	memset(buffer, 0, m_pageSize * m_pageSize);
+	unsigned int sizeU = min(node->getVisibleSizeU(), m_pageSize);
+	unsigned int sizeV = min(node->getVisibleSizeV(), m_pageSize);
+	for (unsigned int j = 0; j < sizeV; ++j)
+	{
+		memcpy(buffer + packXY(0, j, m_pageSize), node->m_data + packXY(node->getX(), node->getY() + j, node->m_totalSizeX), sizeU);
+	}
+}
+
+/// <summary>
+/// Indique si une page est présente dans la texture cache.
+/// </summary>
+/// <param name="page">Indice de la page.</param>
+/// <returns><c>true</c> si la page est présente, <c>false</c> sinon.</returns>
+bool QuadTreePageCache::isResident(unsigned int page) const
+{
+	return m_pages[page].slot != NONE;
+}
+
+/// <summary>
+/// Renvoie l'emplacement occupé par une page.
+/// </summary>
+/// <param name="page">Indice de la page.</param>
+/// <returns>Indice de l'emplacement, <c>NONE</c> si la page est absente.</returns>
+unsigned int QuadTreePageCache::getSlot(unsigned int page) const
+{
+	return m_pages[page].slot;
+}
+
+/// <summary>
+/// Renvoie la première coordonnée d'un emplacement dans la texture cache.
+/// </summary>
+/// <param name="slot">Indice de l'emplacement.</param>
+/// <returns>Première coordonnée de l'emplacement.</returns>
+unsigned int QuadTreePageCache::getSlotU(unsigned int slot) const
+{
+	return xFromXY(slot, m_slotsPerRow) * m_pageSize;
+}
+
+/// <summary>
+/// Renvoie la seconde coordonnée d'un emplacement dans la texture cache.
+/// </summary>
+/// <param name="slot">Indice de l'emplacement.</param>
+/// <returns>Seconde coordonnée de l'emplacement.</returns>
+unsigned int QuadTreePageCache::getSlotV(unsigned int slot) const
+{
+	return yFromXY(slot, m_slotsPerRow) * m_pageSize;
+}
+
+/// <summary>
+/// Renvoie le nombre de pages.
+/// </summary>
+/// <returns>Nombre de pages.</returns>
+unsigned int QuadTreePageCache::getNPages(void) const
+{
+	return m_nPages;
+}
+
+/// <summary>
+/// Renvoie le nombre d'emplacements de la texture cache.
+/// </summary>
+/// <returns>Nombre d'emplacements.</returns>
+unsigned int QuadTreePageCache::getNSlots(void) const
+{
+	return m_nSlots;
+}
+
+/// <summary>
+/// Renvoie le nombre de pages présentes dans la texture cache.
+/// </summary>
+/// <returns>Nombre de pages présentes.</returns>
+unsigned int QuadTreePageCache::getNResidentPages(void) const
+{
+	return m_nResident;
+}
+
+/// <summary>
+/// Renvoie le nombre total de pages évincées.
+/// </summary>
+/// <returns>Nombre de pages évincées.</returns>
+unsigned int QuadTreePageCache::getNEvictions(void) const
+{
+	return m_nEvictions;
+}
+
+/// <summary>
+/// Renvoie le côté des pages.
+/// </summary>
+/// <returns>Côté des pages.</returns>
+unsigned int QuadTreePageCache::getPageSize(void) const
+{
+	return m_pageSize;
+}
+
+/// <summary>
+/// Renvoie la largeur de la texture cache.
+/// </summary>
+/// <returns>Largeur de la texture cache.</returns>
+unsigned int QuadTreePageCache::getCacheWidth(void) const
+{
+	return m_cacheWidth;
+}
+
+/// <summary>
+/// Renvoie la hauteur de la texture cache.
+/// </summary>
+/// <returns>Hauteur de la texture cache.</returns>
+unsigned int QuadTreePageCache::getCacheHeight(void) const
+{
+	return m_cacheHeight;
+}
+
+/// <summary>
+/// Renvoie les données de l'indirection pool, mise à jour à chaque chargement ou éviction.
+/// </summary>
+/// <returns>Pointeur vers les données de l'indirection pool.</returns>
+const float *QuadTreePageCache::getIndirectionPool(void) const
+{
+	return m_pool;
+}
+
+/// <summary>
+/// Renvoie la largeur de l'indirection pool.
+/// </summary>
+/// <returns>Largeur de l'indirection pool.</returns>
+unsigned int QuadTreePageCache::getIndirectionPoolWidth(void) const
+{
+	return m_poolWidth;
+}
+
+/// <summary>
+/// Renvoie la hauteur de l'indirection pool.
+/// </summary>
+/// <returns>Hauteur de l'indirection pool.</returns>
+unsigned int QuadTreePageCache::getIndirectionPoolHeight(void) const
+{
+	return m_poolHeight;
+}
+
+/// <summary>
+/// Renvoie le rectangle de l'indirection pool modifié depuis le dernier appel à <c>clearDirtyRegion</c>.
+/// </summary>
+/// <param name="i0">Reference vers la première colonne modifiée.</param>
+/// <param name="j0">Reference vers la première ligne modifiée.</param>
+/// <param name="i1">Reference vers la dernière colonne modifiée.</param>
+/// <param name="j1">Reference vers la dernière ligne modifiée.</param>
+/// <returns><c>true</c> si l'indirection pool a été modifiée, <c>false</c> sinon.</returns>
+bool QuadTreePageCache::getDirtyRegion(unsigned int &i0, unsigned int &j0, unsigned int &i1, unsigned int &j1) const
+{
+	i0 = m_dirtyI0;
+	j0 = m_dirtyJ0;
+	i1 = m_dirtyI1;
+	j1 = m_dirtyJ1;
+	return m_dirty;
+}
+
+/// <summary>
+/// Indique que les modifications de l'indirection pool ont été transmises.
+/// </summary>
+void QuadTreePageCache::clearDirtyRegion(void)
+{
+	m_dirty = false;
+}
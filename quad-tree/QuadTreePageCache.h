@@ -0,0 +1,92 @@
+﻿/*! \file */
+#pragma once
+#include "stdafx.h"
+#include "QuadTree.h"
+
+/// <summary>
+/// Texture virtuelle : au lieu de générer la texture contenant tous les patches, les sous-arbres de taille inférieure ou égale à <c>pageSize</c> (les pages)
+/// sont chargés à la demande dans les emplacements d'une texture cache de taille fixe, les moins récemment utilisés étant évincés.
+/// L'indirection pool est réécrite à chaque chargement ou éviction : l'entrée désignant une page absente est vide (la zone s'affiche en fond jusqu'au chargement).
+/// La quatrième coordonnée de cette entrée contient toujours (indice de page + 1) / 65535, ce qui permet à une passe de rendu de déterminer les pages nécessaires.
+/// Cette classe ne fait aucun appel OpenGL : les transferts à effectuer sont décrits par <c>getUploadPage</c>, <c>copyPage</c> et le rectangle modifié de l'indirection pool.
+/// </summary>
+class QuadTreePageCache
+{
+public:
+	/// <summary>Valeur désignant l'absence de page ou d'emplacement.</summary>
+	static const unsigned int NONE = 0xFFFFFFFF;
+	/// <summary>Nombre maximal de pages, l'indice de page étant stocké sur 16 bits.</summary>
+	static const unsigned int MAX_PAGES = 65534;
+
+	QuadTreePageCache(QuadTree *root, unsigned int pageSize, unsigned int cacheWidth, unsigned int cacheHeight, bool powerOfTwo = true, unsigned int maxPoolWidth = 2048);
+	~QuadTreePageCache(void);
+	static unsigned int countPages(const QuadTree *root, unsigned int pageSize);
+	void request(unsigned int page);
+	unsigned int requestRegion(double x0, double y0, double x1, double y1);
+	unsigned int update(unsigned int maxUploads);
+	unsigned int getNUploads(void) const;
+	unsigned int getUploadPage(unsigned int i) const;
+	void copyPage(unsigned int page, BYTE *buffer) const;
+	bool isResident(unsigned int page) const;
+	unsigned int getSlot(unsigned int page) const;
+	unsigned int getSlotU(unsigned int slot) const;
+	unsigned int getSlotV(unsigned int slot) const;
+	unsigned int getNPages(void) const;
+	unsigned int getNSlots(void) const;
+	unsigned int getNResidentPages(void) const;
+	unsigned int getNEvictions(void) const;
+	unsigned int getPageSize(void) const;
+	unsigned int getCacheWidth(void) const;
+	unsigned int getCacheHeight(void) const;
+	const float *getIndirectionPool(void) const;
+	unsigned int getIndirectionPoolWidth(void) const;
+	unsigned int getIndirectionPoolHeight(void) const;
+	bool getDirtyRegion(unsigned int &i0, unsigned int &j0, unsigned int &i1, unsigned int &j1) const;
+	void clearDirtyRegion(void);
+
+private:
+	/// <summary>
+	/// Page : sous-arbre chargé d'un bloc, repéré par son père et sa position parmi les fils de celui-ci.
+	/// </summary>
+	struct Page
+	{
+		const QuadTree *node;
+		const QuadTree *parent;
+		unsigned int child;
+		unsigned int slot;
+		unsigned int requestFrame;
+	};
+
+	void collectPages(QuadTree *node, unsigned int &nPages);
+	void initPageLeaves(QuadTree *node);
+	float *getCell(const QuadTree *node, unsigned int child);
+	void markDirty(const QuadTree *node, unsigned int child);
+	void writePageEntry(unsigned int page);
+	void writeLeafEntries(const QuadTree *node, const QuadTree *pageNode, unsigned int slotU, unsigned int slotV);
+	unsigned int findSlot(void) const;
+	QuadTree *m_root;
+	unsigned int m_pageSize;
+	unsigned int m_cacheWidth;
+	unsigned int m_cacheHeight;
+	Page *m_pages;
+	unsigned int m_nPages;
+	unsigned int *m_slotPages;
+	unsigned int *m_slotFrames;
+	unsigned int m_nSlots;
+	unsigned int m_slotsPerRow;
+	unsigned int m_nResident;
+	unsigned int m_nEvictions;
+	unsigned int *m_requests;
+	unsigned int m_nRequests;
+	unsigned int *m_uploads;
+	unsigned int m_nUploads;
+	unsigned int m_frame;
+	float *m_pool;
+	unsigned int m_poolWidth;
+	unsigned int m_poolHeight;
+	bool m_dirty;
+	unsigned int m_dirtyI0;
+	unsigned int m_dirtyJ0;
+	unsigned int m_dirtyI1;
+	unsigned int m_dirtyJ1;
+};
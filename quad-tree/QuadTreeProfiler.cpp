@@ -0,0 +1,176 @@
+﻿#include "QuadTreeProfiler.h"
+#include "QuadTree.h"
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+double QuadTreeProfiler::s_stageStart[QuadTreeProfiler::N_STAGES];
+double QuadTreeProfiler::s_stageTime[QuadTreeProfiler::N_STAGES];
+unsigned long long QuadTreeProfiler::s_counters[QuadTreeProfiler::N_COUNTERS];
+QuadTreeProfiler::Event QuadTreeProfiler::s_events[QuadTreeProfiler::MAX_EVENTS];
+unsigned int QuadTreeProfiler::s_nEvents = 0;
+
+/// <summary>
+/// Renvoie l'instant présent en microsecondes.
+/// </summary>
+/// <returns>Instant présent en microsecondes.</returns>
+double QuadTreeProfiler::now(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = {0};
+	if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart * 1e6 / (double)frequency.QuadPart;
+#else
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+#endif
+}
+
+/// <summary>
+/// Remet à zéro les chronomètres, les compteurs et la liste des évènements.
+/// </summary>
+void QuadTreeProfiler::reset(void)
+{
+	memset(s_stageStart, 0, sizeof(s_stageStart));
+	memset(s_stageTime, 0, sizeof(s_stageTime));
+	memset(s_counters, 0, sizeof(s_counters));
+	s_nEvents = 0;
+}
+
+/// <summary>
+/// Démarre le chronomètre d'une étape.
+/// </summary>
+/// <param name="stage">Etape chronométrée.</param>
+void QuadTreeProfiler::begin(Stage stage)
+{
+	s_stageStart[stage] = now();
+}
+
+/// <summary>
+/// Arrête le chronomètre d'une étape, cumule sa durée et enregistre l'évènement correspondant.
+/// </summary>
+/// <param name="stage">Etape chronométrée.</param>
+void QuadTreeProfiler::end(Stage stage)
+{
+	double duration = now() - s_stageStart[stage];
+	s_stageTime[stage] += duration;
+	if (s_nEvents < MAX_EVENTS)
+	{
+		s_events[s_nEvents].stage = stage;
+		s_events[s_nEvents].start = s_stageStart[stage];
+		s_events[s_nEvents].duration = duration;
+		++s_nEvents;
+	}
+}
+
+/// <summary>
+/// Incrémente un compteur.
+/// </summary>
+/// <param name="counter">Compteur à incrémenter.</param>
+/// <param name="value">Valeur à ajouter.</param>
+void QuadTreeProfiler::add(Counter counter, unsigned long long value)
+{
+	s_counters[counter] += value;
+}
+
+/// <summary>
+/// Renvoie la durée cumulée d'une étape.
+/// </summary>
+/// <param name="stage">Etape en question.</param>
+/// <returns>Durée cumulée en microsecondes.</returns>
+double QuadTreeProfiler::getStageTime(Stage stage)
+{
+	return s_stageTime[stage];
+}
+
+/// <summary>
+/// Renvoie la valeur d'un compteur.
+/// </summary>
+/// <param name="counter">Compteur en question.</param>
+/// <returns>Valeur du compteur.</returns>
+unsigned long long QuadTreeProfiler::getCounter(Counter counter)
+{
+	return s_counters[counter];
+}
+
+/// <summary>
+/// Renvoie le nom d'une étape.
+/// </summary>
+/// <param name="stage">Etape en question.</param>
+/// <returns>Nom de l'étape.</returns>
+const char *QuadTreeProfiler::getStageName(Stage stage)
+{
+	static const char *names[N_STAGES] = {"build", "order", "pack", "blit", "poolFill"};
+	return names[stage];
+}
+
+/// <summary>
+/// Renvoie le nom d'un compteur.
+/// </summary>
+/// <param name="counter">Compteur en question.</param>
+/// <returns>Nom du compteur.</returns>
+const char *QuadTreeProfiler::getCounterName(Counter counter)
+{
+	static const char *names[N_COUNTERS] = {"nodesVisited", "pixelsScanned", "atlasWaste", "poolCells"};
+	return names[counter];
+}
+
+/// <summary>
+/// Exporte les durées, les compteurs et éventuellement le nombre de feuilles par profondeur au format JSON.
+/// </summary>
+/// <param name="filename">Nom du fichier.</param>
+/// <param name="root">Racine du quad tree dont on exporte le nombre de feuilles par profondeur (ignorée si nulle).</param>
+/// <returns><c>true</c> si le fichier a pu être écrit, <c>false</c> sinon.</returns>
+bool QuadTreeProfiler::exportJSON(const char *filename, const QuadTree *root)
+{
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) return false;
+
+	fprintf(file, "{\n  \"stages\": {");
+	for (unsigned int i = 0; i < N_STAGES; ++i)
+	{
+		fprintf(file, "%s\n    \"%s\": %.3f", (i > 0) ? "," : "", getStageName((Stage)i), s_stageTime[i]);
+	}
+	fprintf(file, "\n  },\n  \"counters\": {");
+	for (unsigned int i = 0; i < N_COUNTERS; ++i)
+	{
+		fprintf(file, "%s\n    \"%s\": %llu", (i > 0) ? "," : "", getCounterName((Counter)i), s_counters[i]);
+	}
+	fprintf(file, "\n  }");
+	if (root != NULL)
+	{
+		fprintf(file, ",\n  \"leavesAtDepth\": [");
+		for (unsigned int d = 0; d < root->getNDepths(); ++d)
+		{
+			fprintf(file, "%s%u", (d > 0) ? ", " : "", root->getNLeavesAtDepth(d));
+		}
+		fprintf(file, "]");
+	}
+	fprintf(file, "\n}\n");
+	fclose(file);
+	return true;
+}
+
+/// <summary>
+/// Exporte les évènements enregistrés au format Chrome trace (chrome://tracing).
+/// </summary>
+/// <param name="filename">Nom du fichier.</param>
+/// <returns><c>true</c> si le fichier a pu être écrit, <c>false</c> sinon.</returns>
+bool QuadTreeProfiler::exportChromeTrace(const char *filename)
+{
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) return false;
+
+	fprintf(file, "{\"traceEvents\": [");
+	for (unsigned int i = 0; i < s_nEvents; ++i)
+	{
+		fprintf(file, "%s\n  {\"name\": \"%s\", \"cat\": \"quadtree\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": 0}",
+			(i > 0) ? "," : "", getStageName(s_events[i].stage), s_events[i].start, s_events[i].duration);
+	}
+	fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+	fclose(file);
+	return true;
+}
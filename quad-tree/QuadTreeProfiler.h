@@ -0,0 +1,90 @@
+﻿/*! \file */
+#pragma once
+#include "stdafx.h"
+
+class QuadTree;
+
+/// <summary>
+/// Instrumentation de la construction d'un quad tree : chronomètres par étape et compteurs.
+/// Les macros <c>QUADTREE_PROFILE_*</c> ne génèrent du code que si <c>QUADTREE_PROFILING</c> est défini.
+/// </summary>
+class QuadTreeProfiler
+{
+public:
+	/// <summary>
+	/// Etapes chronométrées.
+	/// </summary>
+	enum Stage
+	{
+		STAGE_BUILD,
+		STAGE_ORDER,
+		STAGE_PACK,
+		STAGE_BLIT,
+		STAGE_POOL_FILL,
+		N_STAGES
+	};
+
+	/// <summary>
+	/// Compteurs cumulés.
+	/// </summary>
+	enum Counter
+	{
+		COUNTER_NODES_VISITED,
+		COUNTER_PIXELS_SCANNED,
+		COUNTER_ATLAS_WASTE,
+		COUNTER_POOL_CELLS,
+		N_COUNTERS
+	};
+
+	static void reset(void);
+	static void begin(Stage stage);
+	static void end(Stage stage);
+	static void add(Counter counter, unsigned long long value);
+	static double getStageTime(Stage stage);
+	static unsigned long long getCounter(Counter counter);
+	static const char *getStageName(Stage stage);
+	static const char *getCounterName(Counter counter);
+	static bool exportJSON(const char *filename, const QuadTree *root = NULL);
+	static bool exportChromeTrace(const char *filename);
+	static double now(void);
+
+private:
+	static const unsigned int MAX_EVENTS = 1024;
+	struct Event
+	{
+		Stage stage;
+		double start;
+		double duration;
+	};
+	static double s_stageStart[N_STAGES];
+	static double s_stageTime[N_STAGES];
+	static unsigned long long s_counters[N_COUNTERS];
+	static Event s_events[MAX_EVENTS];
+	static unsigned int s_nEvents;
+};
+
+/// <summary>
+/// Chronomètre une étape pendant la durée de vie de l'objet.
+/// </summary>
+class QuadTreeScopedTimer
+{
+public:
+	QuadTreeScopedTimer(QuadTreeProfiler::Stage stage) : m_stage(stage) { QuadTreeProfiler::begin(m_stage); }
+	~QuadTreeScopedTimer(void) { QuadTreeProfiler::end(m_stage); }
+private:
+	QuadTreeProfiler::Stage m_stage;
+};
+
+#ifdef QUADTREE_PROFILING
+#define QUADTREE_PROFILE_CONCAT_(a, b) a##b
+#define QUADTREE_PROFILE_CONCAT(a, b) QUADTREE_PROFILE_CONCAT_(a, b)
+#define QUADTREE_PROFILE_SCOPE(stage) QuadTreeScopedTimer QUADTREE_PROFILE_CONCAT(_quadTreeTimer, __LINE__)(QuadTreeProfiler::stage)
+#define QUADTREE_PROFILE_BEGIN(stage) QuadTreeProfiler::begin(QuadTreeProfiler::stage)
+#define QUADTREE_PROFILE_END(stage) QuadTreeProfiler::end(QuadTreeProfiler::stage)
+#define QUADTREE_PROFILE_COUNT(counter, value) QuadTreeProfiler::add(QuadTreeProfiler::counter, (unsigned long long)(value))
+#else
+#define QUADTREE_PROFILE_SCOPE(stage) ((void)0)
+#define QUADTREE_PROFILE_BEGIN(stage) ((void)0)
+#define QUADTREE_PROFILE_END(stage) ((void)0)
+#define QUADTREE_PROFILE_COUNT(counter, value) ((void)0)
+#endif
@@ -0,0 +1,203 @@
+﻿#include "RenderProfiler.h"
+#include "QuadTreeProfiler.h"
+#include "GL_ARB_multitexture.h"
+#include "GL_ARB_timer_query.h"
+GLUX_LOAD(GL_ARB_timer_query);
+
+/// <summary>
+/// Crée un profileur pour un nombre donné de tâches de rendu. Les objets OpenGL ne sont créés que par <c>init</c>.
+/// </summary>
+/// <param name="nTasks">Nombre de tâches de rendu.</param>
+RenderProfiler::RenderProfiler(unsigned int nTasks)
+	: m_nTasks(nTasks), m_gpuTimers(false), m_queries(NULL), m_frame(0), m_currentTask(0), m_taskStart(0.), m_samples(NULL), m_nSamples(0), m_samplesCapacity(0)
+{
+	m_queryFrames = new unsigned int[m_nTasks * N_QUERIES];
+	m_queryCpuTimes = new double[m_nTasks * N_QUERIES];
+	m_queryPending = new bool[m_nTasks * N_QUERIES];
+	m_lastCpuTime = new double[m_nTasks];
+	m_lastGpuTime = new double[m_nTasks];
+	memset(m_queryPending, 0, m_nTasks * N_QUERIES * sizeof(bool));
+	memset(m_lastCpuTime, 0, m_nTasks * sizeof(double));
+	memset(m_lastGpuTime, 0, m_nTasks * sizeof(double));
+}
+
+RenderProfiler::~RenderProfiler(void)
+{
+	if (m_queries != NULL)
+	{
+		glDeleteQueries(m_nTasks * N_QUERIES, m_queries);
+		delete[] m_queries;
+	}
+	delete[] m_queryFrames;
+	delete[] m_queryCpuTimes;
+	delete[] m_queryPending;
+	delete[] m_lastCpuTime;
+	delete[] m_lastGpuTime;
+	delete[] m_samples;
+}
+
+/// <summary>
+/// Crée les requêtes de mesure du temps GPU, si l'extension <c>GL_ARB_timer_query</c> est disponible (seul le temps CPU est mesuré sinon).
+/// </summary>
+void RenderProfiler::init(void)
+{
+	m_gpuTimers = GLUX_IS_AVAILABLE(GL_ARB_timer_query);
+	if (!m_gpuTimers) return;
+	m_queries = new GLuint[m_nTasks * N_QUERIES];
+	glGenQueries(m_nTasks * N_QUERIES, m_queries);
+}
+
+/// <summary>
+/// Démarre la mesure d'une tâche de rendu pour l'image courante.
+/// </summary>
+/// <param name="task">Indice de la tâche.</param>
+void RenderProfiler::beginTask(unsigned int task)
+{
+	m_currentTask = task;
+	unsigned int slot = packXY(m_frame % N_QUERIES, task, N_QUERIES);
+	// Si la requête de ce slot n'a toujours pas de résultat après N_QUERIES images, elle est abandonnée plutôt que d'attendre.
+	m_queryPending[slot] = false;
+	if (m_gpuTimers) glBeginQuery(GL_TIME_ELAPSED, m_queries[slot]);
+	m_taskStart = QuadTreeProfiler::now();
+}
+
+/// <summary>
+/// Termine la mesure de la tâche de rendu courante.
+/// </summary>
+void RenderProfiler::endTask(void)
+{
+	unsigned int slot = packXY(m_frame % N_QUERIES, m_currentTask, N_QUERIES);
+	double cpuTime = (QuadTreeProfiler::now() - m_taskStart) / 1000.;
+	m_lastCpuTime[m_currentTask] = cpuTime;
+	if (m_gpuTimers)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_queryFrames[slot] = m_frame;
+		m_queryCpuTimes[slot] = cpuTime;
+		m_queryPending[slot] = true;
+	}
+	else
+	{
+		addSample(m_frame, m_currentTask, cpuTime, -1.);
+	}
+}
+
+/// <summary>
+/// Termine l'image courante : récupère les résultats des requêtes disponibles, sans attendre celles qui ne le sont pas.
+/// </summary>
+void RenderProfiler::endFrame(void)
+{
+	for (unsigned int slot = 0; slot < m_nTasks * N_QUERIES; ++slot)
+	{
+		if (!m_queryPending[slot]) continue;
+		GLint available = 0;
+		glGetQueryObjectiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue;
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(m_queries[slot], GL_QUERY_RESULT, &elapsed);
+		unsigned int task = yFromXY(slot, N_QUERIES);
+		m_lastGpuTime[task] = elapsed / 1e6;
+		m_queryPending[slot] = false;
+		addSample(m_queryFrames[slot], task, m_queryCpuTimes[slot], m_lastGpuTime[task]);
+	}
+	++m_frame;
+}
+
+/// <summary>
+/// Affiche en surimpression les derniers temps mesurés d'une tâche, dans le coin inférieur gauche de la fenêtre quelle que soit la projection courante.
+/// </summary>
+/// <param name="task">Indice de la tâche.</param>
+void RenderProfiler::drawOverlay(unsigned int task) const
+{
+	char text[128];
+	if (m_gpuTimers) sprintf(text, "tache %u : CPU %.3f ms, GPU %.3f ms", task, m_lastCpuTime[task], m_lastGpuTime[task]);
+	else sprintf(text, "tache %u : CPU %.3f ms", task, m_lastCpuTime[task]);
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	glActiveTextureARB(GL_TEXTURE1_ARB);
+	glDisable(GL_TEXTURE_2D);
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_DEPTH_TEST);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	gluOrtho2D(0.0, 1.0, 0.0, 1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	glColor3f(1.f, 1.f, 0.f);
+	glRasterPos2d(0.01, 0.01);
+	for (const char *c = text; *c != '\0'; ++c)
+	{
+		glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+	}
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+}
+
+/// <summary>
+/// Renvoie le dernier temps CPU mesuré pour une tâche.
+/// </summary>
+/// <param name="task">Indice de la tâche.</param>
+/// <returns>Temps CPU en millisecondes.</returns>
+double RenderProfiler::getCpuTime(unsigned int task) const
+{
+	return m_lastCpuTime[task];
+}
+
+/// <summary>
+/// Renvoie le dernier temps GPU mesuré pour une tâche.
+/// </summary>
+/// <param name="task">Indice de la tâche.</param>
+/// <returns>Temps GPU en millisecondes.</returns>
+double RenderProfiler::getGpuTime(unsigned int task) const
+{
+	return m_lastGpuTime[task];
+}
+
+/// <summary>
+/// Enregistre une mesure.
+/// </summary>
+/// <param name="frame">Numéro de l'image.</param>
+/// <param name="task">Indice de la tâche.</param>
+/// <param name="cpuTime">Temps CPU en millisecondes.</param>
+/// <param name="gpuTime">Temps GPU en millisecondes (négatif si non mesuré).</param>
+void RenderProfiler::addSample(unsigned int frame, unsigned int task, double cpuTime, double gpuTime)
+{
+	if (m_nSamples == m_samplesCapacity)
+	{
+		m_samplesCapacity = max(2 * m_samplesCapacity, 1024u);
+		Sample *samples = new Sample[m_samplesCapacity];
+		if (m_samples != NULL) memcpy(samples, m_samples, m_nSamples * sizeof(Sample));
+		delete[] m_samples;
+		m_samples = samples;
+	}
+	m_samples[m_nSamples].frame = frame;
+	m_samples[m_nSamples].task = task;
+	m_samples[m_nSamples].cpuTime = cpuTime;
+	m_samples[m_nSamples].gpuTime = gpuTime;
+	++m_nSamples;
+}
+
+/// <summary>
+/// Exporte toutes les mesures au format CSV (une ligne par image et par tâche).
+/// </summary>
+/// <param name="filename">Nom du fichier.</param>
+/// <returns><c>true</c> si le fichier a pu être écrit, <c>false</c> sinon.</returns>
+bool RenderProfiler::exportCSV(const char *filename) const
+{
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) return false;
+	fprintf(file, "frame,task,cpu_ms,gpu_ms\n");
+	for (unsigned int i = 0; i < m_nSamples; ++i)
+	{
+		if (m_samples[i].gpuTime >= 0.) fprintf(file, "%u,%u,%.4f,%.4f\n", m_samples[i].frame, m_samples[i].task, m_samples[i].cpuTime, m_samples[i].gpuTime);
+		else fprintf(file, "%u,%u,%.4f,\n", m_samples[i].frame, m_samples[i].task, m_samples[i].cpuTime);
+	}
+	fclose(file);
+	return true;
+}
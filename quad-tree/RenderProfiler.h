@@ -0,0 +1,51 @@
+﻿/*! \file */
+#pragma once
+#include "stdafx.h"
+#include <GL/gl.h>
+#include <GL/glu.h>
+#include <GL/glut.h>
+#include <glux.h>
+
+/// <summary>
+/// Mesure les temps CPU et GPU de chaque tâche de rendu, les affiche en surimpression et les exporte au format CSV.
+/// Les requêtes <c>GL_TIME_ELAPSED</c> sont réparties dans un tampon circulant sur plusieurs images, de sorte que leurs résultats ne soient lus qu'une fois disponibles, sans bloquer le pipeline.
+/// </summary>
+class RenderProfiler
+{
+public:
+	RenderProfiler(unsigned int nTasks);
+	~RenderProfiler(void);
+	void init(void);
+	void beginTask(unsigned int task);
+	void endTask(void);
+	void endFrame(void);
+	void drawOverlay(unsigned int task) const;
+	double getCpuTime(unsigned int task) const;
+	double getGpuTime(unsigned int task) const;
+	bool exportCSV(const char *filename) const;
+
+private:
+	static const unsigned int N_QUERIES = 4;
+	struct Sample
+	{
+		unsigned int frame;
+		unsigned int task;
+		double cpuTime;
+		double gpuTime;
+	};
+	void addSample(unsigned int frame, unsigned int task, double cpuTime, double gpuTime);
+	unsigned int m_nTasks;
+	bool m_gpuTimers;
+	GLuint *m_queries;
+	unsigned int *m_queryFrames;
+	double *m_queryCpuTimes;
+	bool *m_queryPending;
+	double *m_lastCpuTime;
+	double *m_lastGpuTime;
+	unsigned int m_frame;
+	unsigned int m_currentTask;
+	double m_taskStart;
+	Sample *m_samples;
+	unsigned int m_nSamples;
+	unsigned int m_samplesCapacity;
+};
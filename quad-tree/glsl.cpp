@@ -39,6 +39,22 @@ GLUX_REQUIRE(GL_ARB_fragment_shader);
 GLUX_REQUIRE(GL_ARB_vertex_program);
 #include "GL_ARB_multitexture.h"
 GLUX_REQUIRE(GL_ARB_multitexture);
+// cached and asynchronous programs are core objects (glCreateProgram),
+// as required by the program binary and parallel compile entry points
+#include "GL_VERSION_2_0.h"
+GLUX_REQUIRE(GL_VERSION_2_0);
+#include "GL_ARB_get_program_binary.h"
+GLUX_LOAD(GL_ARB_get_program_binary);
+#include "GL_ARB_parallel_shader_compile.h"
+GLUX_LOAD(GL_ARB_parallel_shader_compile);
+
+#include "glsl.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
 
 /* -------------------------------------------------------- */
 
@@ -148,12 +164,29 @@ GLuint createGLSLProgram(const char *vp_code,const char *fp_code)
   Returned string must be deleted with delete[]()
 */
 const char *loadStringFromFile(const char *fname)
+{
+  const char *str = tryLoadStringFromFile(fname);
+  if (str == NULL) {
+	  fprintf(stderr,"[ERROR] Cannot open file '%s'\n",fname);
+	  exit (-1);
+  }
+  return (str);
+}
+
+/* -------------------------------------------------------- */
+
+/*
+  Load a string from a file, returns NULL if the file
+  cannot be read
+
+  Returned string must be deleted with delete[]()
+*/
+const char *tryLoadStringFromFile(const char *fname)
 {
   // open file
   FILE *f=fopen(fname,"rb");
   if (f == NULL) {
-	  fprintf(stderr,"[ERROR] Cannot open file '%s'\n",fname);
-	  exit (-1);
+    return (NULL);
   }
   // get file size
   fseek(f,0,SEEK_END);    // goto end
@@ -162,7 +195,11 @@ const char *loadStringFromFile(const char *fname)
   // allocate string
   char *str=new char[fsize+1];
   // read
-  fread(str,fsize,sizeof(char),f);
+  if (fsize < 0 || fread(str,1,fsize,f) != (size_t)fsize) {
+    delete [](str);
+    fclose(f);
+    return (NULL);
+  }
   str[fsize]='\0';
   // close file
   fclose(f);
@@ -171,3 +208,398 @@ const char *loadStringFromFile(const char *fname)
 }
 
 /* -------------------------------------------------------- */
+
+/*
+  GLSLPreamble - definitions prepended to a shader source
+*/
+void initGLSLPreamble(t_glslPreamble *preamble)
+{
+  preamble->capacity = 256;
+  preamble->length   = 0;
+  preamble->text     = new char[preamble->capacity];
+  preamble->text[0]  = '\0';
+}
+
+void addGLSLDefine(t_glslPreamble *preamble,const char *name,int value)
+{
+  char line[256];
+  int n = sprintf(line,"#define %s %d\n",name,value);
+  // grow geometrically so that adding defines stays linear
+  if (preamble->length + n + 1 > preamble->capacity) {
+    unsigned int capacity = 2 * (preamble->length + n + 1);
+    char *text = new char[capacity];
+    memcpy(text,preamble->text,preamble->length + 1);
+    delete [](preamble->text);
+    preamble->text     = text;
+    preamble->capacity = capacity;
+  }
+  memcpy(preamble->text + preamble->length,line,n + 1);
+  preamble->length += n;
+}
+
+void freeGLSLPreamble(t_glslPreamble *preamble)
+{
+  delete [](preamble->text);
+  preamble->text     = NULL;
+  preamble->length   = 0;
+  preamble->capacity = 0;
+}
+
+const char *assembleGLSLSource(const t_glslPreamble *preamble,const char *body)
+{
+  unsigned int bodyLength = strlen(body);
+  char *str = new char[preamble->length + bodyLength + 1];
+  memcpy(str,preamble->text,preamble->length);
+  memcpy(str + preamble->length,body,bodyLength + 1);
+  return (str);
+}
+
+/* -------------------------------------------------------- */
+
+static unsigned long long fnv1a(unsigned long long h,const char *str)
+{
+  if (str == NULL) {
+    return (h);
+  }
+  for (const unsigned char *c = (const unsigned char *)str ; *c ; c++) {
+    h ^= *c;
+    h *= 1099511628211ULL;
+  }
+  // separator, so that ("ab","c") and ("a","bc") differ
+  h ^= 0xff;
+  h *= 1099511628211ULL;
+  return (h);
+}
+
+unsigned long long hashGLSLSource(const char *vp_code,const char *fp_code)
+{
+  unsigned long long h = 14695981039346656037ULL;
+  h = fnv1a(h,(const char *)glGetString(GL_VENDOR));
+  h = fnv1a(h,(const char *)glGetString(GL_RENDERER));
+  h = fnv1a(h,(const char *)glGetString(GL_VERSION));
+  h = fnv1a(h,vp_code);
+  h = fnv1a(h,fp_code);
+  return (h);
+}
+
+/* -------------------------------------------------------- */
+
+// header of a cached program binary
+typedef struct s_glslBinaryHeader
+{
+  unsigned int       magic;
+  unsigned long long hash;
+  GLenum             format;
+  GLint              length;
+} t_glslBinaryHeader;
+
+static const unsigned int GLSL_BINARY_MAGIC = 0x42534C47; // 'GLSB'
+
+// One cache file per prefix: a binary built from other sources (or for
+// another driver) fails the hash check and is overwritten, so the cache
+// never grows beyond the number of programs. Path separators of the
+// prefix are replaced, every file lands in GLSL_CACHE_DIR.
+static bool getGLSLCacheFile(const char *cachePrefix,char *fname,size_t size)
+{
+  // '<dir>/<prefix>.glslbin'
+  if (strlen(GLSL_CACHE_DIR) + strlen(cachePrefix) + 10 > size) {
+    return (false);
+  }
+  sprintf(fname,"%s/%s.glslbin",GLSL_CACHE_DIR,cachePrefix);
+  for (char *c = fname + strlen(GLSL_CACHE_DIR) + 1 ; *c != '\0' ; c++) {
+    if (*c == '/' || *c == '\\' || *c == ':') {
+      *c = '_';
+    }
+  }
+  return (true);
+}
+
+static GLuint loadGLSLProgramBinary(const char *fname,unsigned long long hash)
+{
+  FILE *f=fopen(fname,"rb");
+  if (f == NULL) {
+    return (0);
+  }
+  t_glslBinaryHeader header;
+  GLuint id = 0;
+  if (fread(&header,sizeof(header),1,f) == 1
+    && header.magic == GLSL_BINARY_MAGIC && header.hash == hash && header.length > 0) {
+    char *binary = new char[header.length];
+    if (fread(binary,header.length,1,f) == 1) {
+      id = glCreateProgram();
+      glProgramBinary(id,header.format,binary,header.length);
+      // the driver may reject a binary (e.g. after an update)
+      GLint linked;
+      glGetProgramiv(id,GL_LINK_STATUS,&linked);
+      if (!linked) {
+        glDeleteProgram(id);
+        id = 0;
+      }
+    }
+    delete [](binary);
+  }
+  fclose(f);
+  return (id);
+}
+
+static void saveGLSLProgramBinary(const char *fname,unsigned long long hash,GLuint id)
+{
+  t_glslBinaryHeader header;
+  header.magic = GLSL_BINARY_MAGIC;
+  header.hash  = hash;
+  glGetProgramiv(id,GL_PROGRAM_BINARY_LENGTH,&header.length);
+  if (header.length <= 0) {
+    return;
+  }
+  char *binary = new char[header.length];
+  glGetProgramBinary(id,header.length,NULL,&header.format,binary);
+  // failing to write the cache is not an error (the directory may already exist)
+#ifdef _WIN32
+  _mkdir(GLSL_CACHE_DIR);
+#else
+  mkdir(GLSL_CACHE_DIR,0777);
+#endif
+  FILE *f=fopen(fname,"wb");
+  if (f != NULL) {
+    fwrite(&header,sizeof(header),1,f);
+    fwrite(binary,header.length,1,f);
+    fclose(f);
+  }
+  delete [](binary);
+}
+
+/* -------------------------------------------------------- */
+
+/*
+  Asynchronous, non-fatal program creation
+*/
+
+static bool g_glslParallelCompile = false;
+
+void initGLSLParallelCompile()
+{
+  if (GLUX_IS_AVAILABLE(GL_ARB_parallel_shader_compile)) {
+    // let the driver pick the number of compiler threads
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    g_glslParallelCompile = true;
+  }
+}
+
+// returns the info log of a shader or program (delete[] it)
+static char *getGLSLInfoLog(GLuint id,bool program)
+{
+  GLint maxLength = 0;
+  if (program) {
+    glGetProgramiv(id,GL_INFO_LOG_LENGTH,&maxLength);
+  } else {
+    glGetShaderiv(id,GL_INFO_LOG_LENGTH,&maxLength);
+  }
+  char *infoLog = new char[maxLength+1];
+  infoLog[0] = '\0';
+  if (program) {
+    glGetProgramInfoLog(id,maxLength,NULL,infoLog);
+  } else {
+    glGetShaderInfoLog(id,maxLength,NULL,infoLog);
+  }
+  return (infoLog);
+}
+
+static GLuint submitGLSLShader(const char *prg,GLuint type)
+{
+  GLuint id = glCreateShader(type);
+  glShaderSource(id,1,&prg,NULL);
+  // no status query here: it would wait for the compilation
+  glCompileShader(id);
+  return (id);
+}
+
+void submitGLSLProgram(t_glslJob *job,const char *vp_code,const char *fp_code,const char *cachePrefix)
+{
+  job->program      = 0;
+  job->vp           = 0;
+  job->fp           = 0;
+  job->status       = GLSL_JOB_PENDING;
+  job->error        = GLSL_ERROR_NONE;
+  job->log          = NULL;
+  job->cacheFile[0] = '\0';
+  job->hash         = 0;
+  // try the binary cache first
+  bool cache = (cachePrefix != NULL && GLUX_IS_AVAILABLE(GL_ARB_get_program_binary));
+  if (cache && !getGLSLCacheFile(cachePrefix,job->cacheFile,sizeof(job->cacheFile))) {
+    fprintf(stderr,"[WARNING] Cache prefix '%s' is too long, shader cache disabled\n",cachePrefix);
+    job->cacheFile[0] = '\0';
+    cache = false;
+  }
+  if (cache) {
+    job->hash = hashGLSLSource(vp_code,fp_code);
+    job->program = loadGLSLProgramBinary(job->cacheFile,job->hash);
+    if (job->program != 0) {
+      job->status = GLSL_JOB_READY;
+      return;
+    }
+  }
+  // issue compilation and link, status is checked by pollGLSLProgram
+  job->program = glCreateProgram();
+  if (cache) {
+    // ask the driver to keep the binary around (must be set before linking)
+    glProgramParameteri(job->program,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
+  }
+  if (vp_code) {
+    job->vp = submitGLSLShader(vp_code,GL_VERTEX_SHADER);
+    glAttachShader(job->program,job->vp);
+  }
+  if (fp_code) {
+    job->fp = submitGLSLShader(fp_code,GL_FRAGMENT_SHADER);
+    glAttachShader(job->program,job->fp);
+  }
+  glLinkProgram(job->program);
+}
+
+bool pollGLSLProgram(t_glslJob *job)
+{
+  if (job->status != GLSL_JOB_PENDING) {
+    return (true);
+  }
+  // without the parallel compile extension, querying the status blocks
+  if (g_glslParallelCompile) {
+    GLint completed = GL_FALSE;
+    glGetProgramiv(job->program,GL_COMPLETION_STATUS_ARB,&completed);
+    if (!completed) {
+      return (false);
+    }
+  }
+  // check compilation, then link
+  GLint ok;
+  GLuint shaders[2] = { job->vp, job->fp };
+  int    errors[2]  = { GLSL_ERROR_VERTEX, GLSL_ERROR_FRAGMENT };
+  for (int i = 0 ; i < 2 && job->error == GLSL_ERROR_NONE ; i++) {
+    if (shaders[i] == 0) {
+      continue;
+    }
+    glGetShaderiv(shaders[i],GL_COMPILE_STATUS,&ok);
+    if (!ok) {
+      job->error = errors[i];
+      job->log   = getGLSLInfoLog(shaders[i],false);
+    }
+  }
+  if (job->error == GLSL_ERROR_NONE) {
+    glGetProgramiv(job->program,GL_LINK_STATUS,&ok);
+    if (!ok) {
+      job->error = GLSL_ERROR_LINK;
+      job->log   = getGLSLInfoLog(job->program,true);
+    }
+  }
+  // free compiled shaders (they are now embbeded into the program)
+  if (job->vp) {
+    glDeleteShader(job->vp);
+    job->vp = 0;
+  }
+  if (job->fp) {
+    glDeleteShader(job->fp);
+    job->fp = 0;
+  }
+  if (job->error != GLSL_ERROR_NONE) {
+    glDeleteProgram(job->program);
+    job->program = 0;
+    job->status  = GLSL_JOB_FAILED;
+  } else {
+    if (job->cacheFile[0] != '\0') {
+      saveGLSLProgramBinary(job->cacheFile,job->hash,job->program);
+    }
+    job->status = GLSL_JOB_READY;
+  }
+  return (true);
+}
+
+void waitGLSLPrograms(t_glslJob *jobs,int num)
+{
+  bool done;
+  do {
+    done = true;
+    for (int i = 0 ; i < num ; i++) {
+      done = pollGLSLProgram(&jobs[i]) && done;
+    }
+    // let the driver compile on its own threads
+    if (!done) {
+      Sleep(1);
+    }
+  } while (!done);
+}
+
+void freeGLSLJob(t_glslJob *job)
+{
+  delete [](job->log);
+  job->log = NULL;
+}
+
+/* -------------------------------------------------------- */
+
+/*
+  File watch
+*/
+
+// Modification time (100 ns units on Windows, nanoseconds elsewhere) and size,
+// false if the file is missing. stat's st_mtime alone only has 1 s resolution.
+static bool getFileStamp(const char *fname,unsigned long long *mtime,unsigned long long *size)
+{
+#ifdef _WIN32
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesExA(fname,GetFileExInfoStandard,&data)) {
+    return (false);
+  }
+  *mtime = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+  *size  = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+  struct stat st;
+  if (stat(fname,&st) != 0) {
+    return (false);
+  }
+  *mtime = (unsigned long long)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+  *size  = (unsigned long long)st.st_size;
+#endif
+  return (true);
+}
+
+void initGLSLFileWatch(t_glslFileWatch *watch,const char *fname)
+{
+  strncpy(watch->fname,fname,sizeof(watch->fname)-1);
+  watch->fname[sizeof(watch->fname)-1] = '\0';
+  if (!getFileStamp(watch->fname,&watch->mtime,&watch->size)) {
+    watch->mtime = 0;
+    watch->size  = 0;
+  }
+}
+
+bool checkGLSLFileWatch(t_glslFileWatch *watch)
+{
+  unsigned long long mtime,size;
+  // a missing file (editor saving in progress) is not a change
+  if (!getFileStamp(watch->fname,&mtime,&size)) {
+    return (false);
+  }
+  if (mtime == watch->mtime && size == watch->size) {
+    return (false);
+  }
+  watch->mtime = mtime;
+  watch->size  = size;
+  return (true);
+}
+
+/* -------------------------------------------------------- */
+
+GLuint createGLSLProgramCached(const char *vp_code,const char *fp_code,const char *cachePrefix)
+{
+  t_glslJob job;
+  submitGLSLProgram(&job,vp_code,fp_code,cachePrefix);
+  waitGLSLPrograms(&job,1);
+  if (job.status == GLSL_JOB_FAILED) {
+    fprintf(stderr,"\n\n**** GLSL program failed to build ****\n%s",job.log);
+    freeGLSLJob(&job);
+    // exit on error
+    exit (0);
+  }
+  freeGLSLJob(&job);
+  return (job.program);
+}
+
+/* -------------------------------------------------------- */
@@ -26,6 +26,8 @@ Helper functions for GLSL - header
 #include <GL/glu.h>         // OpenGL Utilities header
 #include <GL/glut.h>        // OpenGL Utility Toolkit header
 
+#include <time.h>
+
 /* -------------------------------------------------------- */
 
 /*
@@ -62,3 +64,136 @@ GLuint createGLSLProgram(const char *vp_code,const char *fp_code);
   Returned string must be deleted with delete[]()
 */
 const char *loadStringFromFile(const char *fname);
+
+/*
+  Load a string from a file, returns NULL if the file
+  cannot be read (does not exit)
+
+  Returned string must be deleted with delete[]()
+*/
+const char *tryLoadStringFromFile(const char *fname);
+
+/* -------------------------------------------------------- */
+
+/*
+  GLSLPreamble
+
+  Growable buffer of preprocessor definitions prepended to
+  a shader source. The whole source is assembled once, in a
+  single allocation, by assembleGLSLSource.
+*/
+typedef struct s_glslPreamble
+{
+  char         *text;
+  unsigned int  length;
+  unsigned int  capacity;
+} t_glslPreamble;
+
+void initGLSLPreamble(t_glslPreamble *preamble);
+void addGLSLDefine(t_glslPreamble *preamble,const char *name,int value);
+void freeGLSLPreamble(t_glslPreamble *preamble);
+
+/*
+  assembleGLSLSource
+
+  Concatenates a preamble and a shader body.
+
+  Returned string must be deleted with delete[]()
+*/
+const char *assembleGLSLSource(const t_glslPreamble *preamble,const char *body);
+
+/*
+  hashGLSLSource
+
+  64 bits FNV-1a hash of the given sources (NULL allowed)
+  and of the OpenGL vendor/renderer/version strings, since
+  program binaries are only valid for a given driver.
+*/
+unsigned long long hashGLSLSource(const char *vp_code,const char *fp_code);
+
+/*
+  createGLSLProgramCached
+
+  Same as createGLSLProgram (exits on error), but first tries to load the
+  linked program binary from 'GLSL_CACHE_DIR/<cachePrefix>.glslbin'
+  (GL_ARB_get_program_binary). The file stores a hash of the sources
+  and driver: on a missing, outdated or rejected binary the program
+  is compiled from source and the file is overwritten for the next
+  launch.
+
+  * Inputs
+    - vp_code     : null terminated string for vertex program
+    - fp_code     : null terminated string for fragment program
+    - cachePrefix : name of the cache file, one per program
+                    (path separators are replaced)
+  * Output
+    - program GL id
+
+*/
+#define GLSL_CACHE_DIR "glslCache"
+
+GLuint createGLSLProgramCached(const char *vp_code,const char *fp_code,const char *cachePrefix);
+
+/* -------------------------------------------------------- */
+
+/*
+  Asynchronous, non-fatal program creation
+
+  submitGLSLProgram issues the compilation and link of a
+  program without waiting for them, so that several programs
+  can be submitted at once. pollGLSLProgram returns true once
+  the job is done; on GL_ARB_parallel_shader_compile drivers
+  it never blocks, otherwise it waits for the driver. Errors
+  are reported in the job instead of terminating the process.
+  Programs built by a job or by createGLSLProgramCached are core
+  objects: use glUseProgram, glUniform* and glDeleteProgram on them.
+
+  Usage:
+    initGLSLParallelCompile();            // once, after gluxInit
+    submitGLSLProgram(&job,vp,fp,NULL);   // cachePrefix may be NULL
+    ...                                   // other work
+    waitGLSLPrograms(&job,1);             // or poll from idle
+    if (job.status == GLSL_JOB_FAILED) fprintf(stderr,"%s",job.log);
+    freeGLSLJob(&job);
+*/
+
+enum { GLSL_JOB_PENDING, GLSL_JOB_READY, GLSL_JOB_FAILED };
+enum { GLSL_ERROR_NONE, GLSL_ERROR_VERTEX, GLSL_ERROR_FRAGMENT, GLSL_ERROR_LINK };
+
+typedef struct s_glslJob
+{
+  GLuint              program;        // program GL id (0 on failure)
+  GLuint              vp,fp;          // shaders being compiled
+  int                 status;         // GLSL_JOB_*
+  int                 error;          // GLSL_ERROR_*
+  char               *log;            // info log on failure
+  char                cacheFile[1024];// binary cache file ('\0' if none)
+  unsigned long long  hash;           // source hash
+} t_glslJob;
+
+void initGLSLParallelCompile();
+void submitGLSLProgram(t_glslJob *job,const char *vp_code,const char *fp_code,const char *cachePrefix);
+bool pollGLSLProgram(t_glslJob *job);
+void waitGLSLPrograms(t_glslJob *jobs,int num);
+void freeGLSLJob(t_glslJob *job);
+
+/* -------------------------------------------------------- */
+
+/*
+  File watch
+
+  Detects modifications of a shader file by polling its
+  modification time, at sub-second resolution, and its size
+  (portable replacement for inotify / ReadDirectoryChangesW). Call checkGLSLFileWatch regularly,
+  e.g. from the glut idle callback; it returns true once per
+  modification.
+*/
+typedef struct s_glslFileWatch
+{
+  char                fname[1024];
+  unsigned long long  mtime;          // 0 if the file is missing
+  unsigned long long  size;
+} t_glslFileWatch;
+
+void initGLSLFileWatch(t_glslFileWatch *watch,const char *fname);
+bool checkGLSLFileWatch(t_glslFileWatch *watch);
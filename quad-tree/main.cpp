@@ -15,11 +15,37 @@ GLUX_REQUIRE(GL_ARB_fragment_shader);
 GLUX_REQUIRE(GL_ARB_vertex_program);
 #include "GL_ARB_multitexture.h"
 GLUX_REQUIRE(GL_ARB_multitexture);
+#include "GL_VERSION_2_0.h"
+GLUX_REQUIRE(GL_VERSION_2_0);
 
 #include "glsl.h"
 #include "QuadTree.h"
+#include "QuadTreeAtlas.h"
+#include "QuadTreePageCache.h"
+#include "MappedImage.h"
+#include "BC4Codec.h"
+#include "RenderProfiler.h"
+#include "GL_ARB_framebuffer_object.h"
+GLUX_LOAD(GL_ARB_framebuffer_object);
+#include "GL_ARB_vertex_buffer_object.h"
+GLUX_LOAD(GL_ARB_vertex_buffer_object);
+#include "GL_ARB_pixel_buffer_object.h"
+GLUX_LOAD(GL_ARB_pixel_buffer_object);
+#include "GL_EXT_texture3D.h"
+GLUX_LOAD(GL_EXT_texture3D);
+#include "GL_EXT_texture_array.h"
+GLUX_LOAD(GL_EXT_texture_array);
+#include "GL_ARB_texture_compression.h"
+GLUX_LOAD(GL_ARB_texture_compression);
+#include "GL_ARB_texture_compression_rgtc.h"
+GLUX_LOAD(GL_ARB_texture_compression_rgtc);
+#include "GL_ARB_texture_swizzle.h"
+GLUX_LOAD(GL_ARB_texture_swizzle);
 
 unsigned int g_task = 0;
+RenderProfiler *g_renderProfiler = NULL;
+bool g_showOverlay = true;
+unsigned int g_benchmarkFrames = 0;
 int g_mainWindow;
 int g_mainWindowWidth = 640;
 int g_mainWindowHeight = 480;
@@ -30,63 +56,276 @@ unsigned int g_textureHeight = 0;
 unsigned int g_imageWidth = 0;
 unsigned int g_imageHeight = 0;
 GLuint g_indirectionPool;
-GLuint g_glslProgram;
+unsigned int g_indirectionPoolWidth = 0;
+unsigned int g_indirectionPoolHeight = 0;
+unsigned int g_mipLevels = 0;
+bool g_compressTexture = false;
+GLuint g_glslProgram = 0;
+
+// Mode atlas : plusieurs images partagent un tableau de textures et une indirection pool, et sont affichées en un seul appel.
+QuadTreeAtlas *g_atlas = NULL;
+GLuint g_atlasTexture;
+GLuint g_atlasIndirectionPool;
+GLuint g_atlasProgram = 0;
+
+// Mode texture virtuelle : les pages de l'arbre sont chargées à la demande dans une texture cache de taille fixe,
+// d'après une passe de rendu de résolution réduite indiquant les pages visibles.
+QuadTreePageCache *g_pageCache = NULL;
+GLuint g_feedbackProgram = 0;
+GLuint g_feedbackFramebuffer = 0;
+GLuint g_feedbackRenderbuffer = 0;
+unsigned int g_feedbackWidth = 0;
+unsigned int g_feedbackHeight = 0;
+BYTE *g_feedbackData = NULL;
+BYTE *g_pageData = NULL;
+const unsigned int FEEDBACK_SCALE = 4;
+const unsigned int MAX_PAGE_UPLOADS = 16;
+
+// Mode visionneuse : la fenêtre conserve sa taille et affiche une région de l'image déplacée et agrandie à la souris.
+bool g_viewMode = false;
+double g_viewCenterX = 0.5;
+double g_viewCenterY = 0.5;
+double g_viewZoom = 1.;
+int g_mouseButton = -1;
+int g_mouseX = 0;
+int g_mouseY = 0;
+const QuadTree **g_visibleLeaves = NULL;
+
+/// <summary>
+/// Variante du fragment shader de reconstruction, recompilée en arrière-plan lorsque son fichier source est modifié.
+/// </summary>
+struct LookupVariant
+{
+	const char *filename;
+	GLuint program;
+	t_glslJob job;
+	bool pending;
+	t_glslFileWatch watch;
+};
+
+const unsigned int MAX_LOOKUP_VARIANTS = 8;
+LookupVariant g_lookupVariants[MAX_LOOKUP_VARIANTS];
+unsigned int g_nLookupVariants = 0;
+unsigned int g_lookupVariant = 0;
+int g_lastWatchTime = 0;
 GLuint g_glslTexture;
 GLuint g_glslIndirectionPool;
 
 /// <summary>
-/// Lit une image en niveaux de gris depuis un fichier PGM.
+/// Charge le premier niveau de la texture contenant les patchs via un tampon de transfert projeté en mémoire (pixel buffer object) :
+/// les patches y sont écrits directement depuis l'image, sans qu'aucune copie de la texture ne soit allouée.
+/// La texture doit être liée et l'arbre placé (<c>QuadTree::packTexture</c>).
+/// </summary>
+/// <returns><c>false</c> si les pixel buffer objects ne sont pas disponibles ou si le tampon n'a pas pu être projeté, <c>true</c> sinon.</returns>
+bool uploadTextureFromBuffer(void)
+{
+	if (!GLUX_IS_AVAILABLE(GL_ARB_pixel_buffer_object)) return false;
+
+	GLuint buffer;
+	glGenBuffersARB(1, &buffer);
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, buffer);
+	glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, g_textureWidth * g_textureHeight, NULL, GL_STREAM_DRAW_ARB);
+	BYTE *destination = (BYTE*)glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+	bool mapped = (destination != NULL);
+	if (mapped)
+	{
+		g_tree->writeTexture(destination);
+		mapped = (glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB) == GL_TRUE);
+	}
+	// Les données sont lues depuis le tampon lié (le pointeur est un décalage dans celui-ci).
+	if (mapped) glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, g_textureWidth, g_textureHeight, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, (const GLvoid*)0);
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	glDeleteBuffersARB(1, &buffer);
+	return mapped;
+}
+
+/// <summary>
+/// Charge la texture contenant les patchs compressée au format BC4 (RGTC1), ainsi que ses niveaux de mipmap, chacun étant compressé après avoir été calculé.
+/// La texture n'ayant qu'une composante rouge, celle-ci est répétée sur les composantes verte et bleue afin d'être affichée en niveaux de gris comme une texture de luminance.
+/// L'erreur de compression du premier niveau est mesurée à l'aide du décodeur CPU.
+/// La texture doit être liée et l'arbre placé avec des blocs de 4 texels (<c>QuadTree::packTexture</c>).
 /// </summary>
-/// <param name="filename">Nom du fichier</param>
-/// <param name="width">Reference vers une variable contenant la largeur de l'image.</param>
-/// <param name="height">Reference vers une variable contenant la hauteur de l'image.</param>
-/// <returns>Pointeur vers un tableau contenant les données de l'image.</returns>
-BYTE *readPgm(const char *filename, unsigned int &width, unsigned int &height)
+/// <returns><c>false</c> si le format ou la permutation des composantes ne sont pas disponibles, <c>true</c> sinon.</returns>
+bool uploadCompressedTexture(void)
 {
-	FILE *file = fopen(filename, "rb");
-	char line[10];
-	do
-	{
-		fgets(line, 10, file);
-	}
-	while (sscanf(line, "%d %d", &width, &height) != 2);	
-	BYTE *data = new BYTE[width * height];
-	fseek(file, -1 * width * height, SEEK_END);
-	fread(data, 1, width * height, file);
-	fclose(file);
-	return data;
+	if (!GLUX_IS_AVAILABLE(GL_ARB_texture_compression) || !GLUX_IS_AVAILABLE(GL_ARB_texture_compression_rgtc) || !GLUX_IS_AVAILABLE(GL_ARB_texture_swizzle))
+	{
+		fprintf(stderr, "[WARNING] BC4 texture compression unavailable, loading uncompressed texture\n");
+		return false;
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+
+	BYTE *textureData = new BYTE[g_textureWidth * g_textureHeight];
+	g_tree->writeTexture(textureData);
+	unsigned int levelWidth = g_textureWidth;
+	unsigned int levelHeight = g_textureHeight;
+	unsigned int compressedSize = 0;
+	unsigned int uncompressedSize = 0;
+	for (unsigned int level = 0; level <= g_mipLevels; ++level)
+	{
+		if (level > 0)
+		{
+			BYTE *levelData = QuadTree::generateMipmapLevel(textureData, levelWidth, levelHeight);
+			delete[] textureData;
+			textureData = levelData;
+			levelWidth = max(levelWidth / 2, 1u);
+			levelHeight = max(levelHeight / 2, 1u);
+		}
+		BYTE *blocks = BC4Codec::encode(textureData, levelWidth, levelHeight);
+		unsigned int size = BC4Codec::getCompressedSize(levelWidth, levelHeight);
+		glCompressedTexImage2DARB(GL_TEXTURE_2D, level, GL_COMPRESSED_RED_RGTC1, levelWidth, levelHeight, 0, size, blocks);
+		compressedSize += size;
+		uncompressedSize += levelWidth * levelHeight;
+
+		if (level == 0)
+		{
+			BYTE *decoded = BC4Codec::decode(blocks, levelWidth, levelHeight);
+			unsigned int maxError = 0;
+			double squaredError = 0.;
+			for (unsigned int n = 0; n < levelWidth * levelHeight; ++n)
+			{
+				unsigned int error = abs((int)decoded[n] - (int)textureData[n]);
+				maxError = max(maxError, error);
+				squaredError += error * error;
+			}
+			delete[] decoded;
+			double mse = squaredError / (levelWidth * levelHeight);
+			if (mse > 0.) printf("BC4 texture: max error %u, PSNR %.2f dB\n", maxError, 10. * log10(255. * 255. / mse));
+			else printf("BC4 texture: lossless\n");
+		}
+		delete[] blocks;
+	}
+	delete[] textureData;
+	printf("BC4 texture: %u bytes (%u uncompressed)\n", compressedSize, uncompressedSize);
+	return true;
 }
 
 /// <summary>
-/// Insert une chaîne de caractères au début d'une autre.
+/// Lance la compilation d'un fragment shader de reconstruction, dont la source est précédée des définitions des différents paramètres.
+/// Le programme lié est mis en cache sur le disque, dans un fichier propre à la variante (remplacé lorsque la source change).
 /// </summary>
-/// <param name="source">Chaîne de départ.</param>
-/// <param name="text">Chaîne à insérer.</param>
-/// <param name="freeAfter">Spécifie si la chaîne de départ doit être désalouée.</param>
-/// <returns>Pointeur vers la nouvelle chaîne.</returns>
-const char *insertStringBefore(const char *&source, const char *text, bool freeAfter = true)
+/// <param name="job">Pointeur vers la compilation à lancer.</param>
+/// <param name="filename">Nom du fichier source.</param>
+/// <returns><c>false</c> si la source n'a pas pu être lue, <c>true</c> sinon.</returns>
+bool submitLookupProgram(t_glslJob *job, const char *filename)
 {
-	unsigned int n = strlen(text) + strlen(source) + 1;
-	char *res = new char[n];
-	strcpy(res, text);
-	strcat(res, source);
-	if (freeAfter) delete[] source;
-	return res;
+	const char *fpBody = tryLoadStringFromFile(filename);
+	if (fpBody == NULL)
+	{
+		fprintf(stderr, "[ERROR] Cannot open file '%s'\n", filename);
+		return false;
+	}
+
+	t_glslPreamble preamble;
+	initGLSLPreamble(&preamble);
+	addGLSLDefine(&preamble, "imageWidth", (int)g_imageWidth);
+	addGLSLDefine(&preamble, "imageHeight", (int)g_imageHeight);
+	addGLSLDefine(&preamble, "rootWidth", (int)g_tree->getSizeU());
+	addGLSLDefine(&preamble, "rootHeight", (int)g_tree->getSizeV());
+	addGLSLDefine(&preamble, "mipLevels", (int)g_mipLevels);
+	addGLSLDefine(&preamble, "textureWidth", (int)g_textureWidth);
+	addGLSLDefine(&preamble, "textureHeight", (int)g_textureHeight);
+	addGLSLDefine(&preamble, "indirectionPoolWidth", (int)g_indirectionPoolWidth);
+	addGLSLDefine(&preamble, "indirectionPoolHeight", (int)g_indirectionPoolHeight);
+	const char *fpCode = assembleGLSLSource(&preamble, fpBody);
+	submitGLSLProgram(job, NULL, fpCode, filename);
+	delete[] fpCode;
+	delete[] fpBody;
+	freeGLSLPreamble(&preamble);
+	return true;
 }
 
 /// <summary>
-/// Insert une définition de constante entière de préprocesseur au début d'une chaîne de caractères.
+/// Associe les échantillonneurs d'un programme de reconstruction compilé aux unités de texture.
 /// </summary>
-/// <param name="source">Chaîne de départ.</param>
-/// <param name="varaible">Nom de la constante.</param>
-/// <param name="value">Valeur de la constante.</param>
-/// <param name="freeAfter">Spécifie si la chaîne de départ doit être désalouée.</param>
-/// <returns>Pointeur vers la nouvelle chaîne.</returns>
-const char *insertDefine(const char *source, const char *variable, int value, bool freeAfter = true)
+/// <param name="program">Programme en question.</param>
+void bindLookupProgram(GLuint program)
 {
-	char line[100];
-	sprintf(line, "%s %s %d\n", "#define", variable, value);
-	return insertStringBefore(source, line, freeAfter);
+	glUseProgram(program);
+
+	g_glslTexture = glGetUniformLocation(program, "u_texture");
+	g_glslIndirectionPool = glGetUniformLocation(program, "u_indirectionPool");
+
+	glUniform1i(g_glslTexture, 0);
+	glUniform1i(g_glslIndirectionPool, 1); 
+	glUseProgram(0);
+}
+
+/// <summary>
+/// Termine la compilation d'une variante si elle est achevée : en cas de succès, le nouveau programme remplace l'ancien, sinon l'ancien est conservé.
+/// </summary>
+/// <param name="variant">Variante en question.</param>
+void updateLookupVariant(LookupVariant &variant)
+{
+	if (!variant.pending || !pollGLSLProgram(&variant.job)) return;
+	variant.pending = false;
+
+	if (variant.job.status == GLSL_JOB_READY)
+	{
+		bindLookupProgram(variant.job.program);
+		if (variant.program != 0) glDeleteProgram(variant.program);
+		variant.program = variant.job.program;
+		printf("'%s' loaded\n", variant.filename);
+	}
+	else if (variant.job.log != NULL)
+	{
+		fprintf(stderr, "[ERROR] '%s' (previous program kept) :\n%s\n", variant.filename, variant.job.log);
+	}
+	freeGLSLJob(&variant.job);
+
+	g_glslProgram = g_lookupVariants[g_lookupVariant].program;
+}
+
+/// <summary>
+/// Relance la compilation des variantes dont le fichier source a été modifié.
+/// </summary>
+void watchLookupVariants(void)
+{
+	for (unsigned int i = 0; i < g_nLookupVariants; ++i)
+	{
+		LookupVariant &variant = g_lookupVariants[i];
+		if (checkGLSLFileWatch(&variant.watch) && !variant.pending)
+		{
+			variant.pending = submitLookupProgram(&variant.job, variant.filename);
+		}
+		updateLookupVariant(variant);
+	}
+}
+
+/// <summary>
+/// Calcule la région de l'image visible dans la fenêtre, en coordonnées normalisées : en mode visionneuse,
+/// un pixel de la fenêtre couvre 1 / <c>g_viewZoom</c> pixel de l'image, sinon l'image entière est affichée.
+/// </summary>
+/// <param name="x0">Reference vers l'abscisse minimale de la région.</param>
+/// <param name="y0">Reference vers l'ordonnée minimale de la région.</param>
+/// <param name="x1">Reference vers l'abscisse maximale de la région.</param>
+/// <param name="y1">Reference vers l'ordonnée maximale de la région.</param>
+void getViewRegion(double &x0, double &y0, double &x1, double &y1)
+{
+	if (!g_viewMode)
+	{
+		x0 = y0 = 0.;
+		x1 = y1 = 1.;
+		return;
+	}
+	double halfWidth = g_mainWindowWidth / (2. * g_viewZoom * g_imageWidth);
+	double halfHeight = g_mainWindowHeight / (2. * g_viewZoom * g_imageHeight);
+	x0 = g_viewCenterX - halfWidth;
+	x1 = g_viewCenterX + halfWidth;
+	y0 = g_viewCenterY - halfHeight;
+	y1 = g_viewCenterY + halfHeight;
+}
+
+/// <summary>
+/// Redimensionne la fenêtre, sauf en mode visionneuse où sa taille est laissée à l'utilisateur.
+/// </summary>
+/// <param name="width">Largeur souhaitée.</param>
+/// <param name="height">Hauteur souhaitée.</param>
+void fitWindow(unsigned int width, unsigned int height)
+{
+	if (!g_viewMode) glutReshapeWindow(width, height);
 }
 
 /// <summary>
@@ -94,7 +333,7 @@ const char *insertDefine(const char *source, const char *variable, int value, bo
 /// </summary>
 void task0(void)
 {
-	glutReshapeWindow(g_textureWidth, g_textureHeight);
+	fitWindow(g_textureWidth, g_textureHeight);
 	glutSetWindowTitle("Texture stockant les patches de l'image initiale (appuyer sur 't' pour continuer)");
 	glEnable(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, g_texture);
@@ -117,23 +356,35 @@ void task0(void)
 
 /// <summary>
 /// Affiche l'image de départ à partir de la texture générée à l'aide d'un <c>GL_QUADS</c> par patch, en surimposant éventuellement des couleurs représentant l'arbre.
+/// Seuls les patches intersectant la région visible sont envoyés, le coût du rendu étant ainsi proportionnel à la surface affichée.
 /// </summary>
 /// <param name="drawTree">Spécifie si l'arbre doit être représenté.</param>
-void drawImage(bool drawTree = false)
+/// <param name="x0">Abscisse minimale de la région visible.</param>
+/// <param name="y0">Ordonnée minimale de la région visible.</param>
+/// <param name="x1">Abscisse maximale de la région visible.</param>
+/// <param name="y1">Ordonnée maximale de la région visible.</param>
+void drawImage(bool drawTree = false, double x0 = 0., double y0 = 0., double x1 = 1., double y1 = 1.)
 {
-	glutReshapeWindow(g_imageWidth, g_imageHeight);
-
 	unsigned int color = 0;
 
+	// Si l'image n'est pas entièrement visible, on ne parcourt que les branches de l'arbre intersectant la région.
+	bool culled = (x0 > 0. || y0 > 0. || x1 < 1. || y1 < 1.);
+	unsigned int nLeaves = g_tree->getNLeaves();
+	if (culled)
+	{
+		if (g_visibleLeaves == NULL) g_visibleLeaves = new const QuadTree*[nLeaves];
+		nLeaves = g_tree->getVisibleLeaves(x0, y0, x1, y1, g_visibleLeaves);
+	}
+
 	glEnable(GL_TEXTURE_2D);
 	glBindTexture(GL_TEXTURE_2D, g_texture);
 
 	glBegin(GL_QUADS);
 
-	for (unsigned int i = 0; i < g_tree->getNLeaves(); ++i)
+	for (unsigned int i = 0; i < nLeaves; ++i)
 	{
 
-		const QuadTree *leaf = g_tree->getLeaf(i);
+		const QuadTree *leaf = culled ? g_visibleLeaves[i] : g_tree->getLeaf(i);
 		if (drawTree) glColor3f((float)((color % 3) == 0), (float)((color % 3) == 1), (float)((++color % 3) == 2));
 
 		glTexCoord2d(leaf->getU0d(),leaf->getV0d());
@@ -157,7 +408,10 @@ void drawImage(bool drawTree = false)
 void task1(void)
 {
 	glutSetWindowTitle("Image reconstruite par le CPU avec un GL_QUAD par patch (appuyer sur 't' pour continuer)");
-	drawImage();
+	fitWindow(g_imageWidth, g_imageHeight);
+	double x0, y0, x1, y1;
+	getViewRegion(x0, y0, x1, y1);
+	drawImage(false, x0, y0, x1, y1);
 }
 
 /// <summary>
@@ -166,18 +420,30 @@ void task1(void)
 void task2(void)
 {
 	glutSetWindowTitle("QuadTree décriavnt les patches (appuyer sur 't' pour continuer)");
-	drawImage(true);
+	fitWindow(g_imageWidth, g_imageHeight);
+	double x0, y0, x1, y1;
+	getViewRegion(x0, y0, x1, y1);
+	drawImage(true, x0, y0, x1, y1);
 }
 
 /// <summary>
-/// Quatrième tâche : on affiche l'image de départ à partir de la texture générée à l'aide d'un unique <c>GL_QUADS</c> à l'aide du fragment shader et de l'indirection pool.
+/// Affiche l'image de départ à l'aide d'un unique <c>GL_QUADS</c>, reconstruite par le fragment shader à partir de la texture générée et de l'indirection pool.
+/// Le quad est restreint à l'intersection de la région visible et de l'image, afin que seuls les pixels affichés soient reconstruits.
 /// </summary>
-void task3(void)
+/// <param name="program">Programme de reconstruction (ou de détermination des pages visibles) à utiliser.</param>
+/// <param name="x0">Abscisse minimale de la région visible.</param>
+/// <param name="y0">Ordonnée minimale de la région visible.</param>
+/// <param name="x1">Abscisse maximale de la région visible.</param>
+/// <param name="y1">Ordonnée maximale de la région visible.</param>
+void drawLookupQuad(GLuint program, double x0 = 0., double y0 = 0., double x1 = 1., double y1 = 1.)
 {
-	glutSetWindowTitle("Image reconstruite via le fragment shader sur un unique GL_QUAD (appuyer sur 't' pour quitter)");
-	glutReshapeWindow(g_imageWidth, g_imageHeight);
+	x0 = max(x0, 0.);
+	y0 = max(y0, 0.);
+	x1 = min(x1, 1.);
+	y1 = min(y1, 1.);
+	if (x0 >= x1 || y0 >= y1) return;
 
-	glUseProgramObjectARB(g_glslProgram);
+	glUseProgram(program);
 	glEnable(GL_TEXTURE_2D);
 
 	glActiveTextureARB(GL_TEXTURE0_ARB);
@@ -188,21 +454,344 @@ void task3(void)
 
 	glBegin(GL_QUADS);
 
-	glTexCoord2d(0., 0.);
-	glVertex2d(0., 0.);
+	glTexCoord2d(x0, y0);
+	glVertex2d(x0, y0);
 
-	glTexCoord2d(1., 0.);
-	glVertex2d(1., 0.);
+	glTexCoord2d(x1, y0);
+	glVertex2d(x1, y0);
 
-	glTexCoord2d(1., 1.);
-	glVertex2d(1., 1.);
+	glTexCoord2d(x1, y1);
+	glVertex2d(x1, y1);
 
-	glTexCoord2d(0., 1.);
-	glVertex2d(0., 1.);
+	glTexCoord2d(x0, y1);
+	glVertex2d(x0, y1);
+
+	glEnd();
+	glUseProgram(0);
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+}
+
+/// <summary>
+/// Quatrième tâche : on affiche l'image de départ à partir de la texture générée à l'aide d'un unique <c>GL_QUADS</c> à l'aide du fragment shader et de l'indirection pool.
+/// </summary>
+void task3(void)
+{
+	glutSetWindowTitle("Image reconstruite via le fragment shader sur un unique GL_QUAD (appuyer sur 't' pour quitter)");
+	fitWindow(g_imageWidth, g_imageHeight);
+	double x0, y0, x1, y1;
+	getViewRegion(x0, y0, x1, y1);
+
+	// Si le fragment shader n'a pas pu être compilé, on affiche l'image à l'aide d'un GL_QUAD par patch (impossible en mode texture virtuelle, les patches n'étant pas tous présents).
+	if (g_glslProgram != 0) drawLookupQuad(g_glslProgram, x0, y0, x1, y1);
+	else if (g_pageCache == NULL) drawImage(false, x0, y0, x1, y1);
+}
+
+/// <summary>
+/// En mode atlas, affiche toutes les images sur une grille à l'aide d'un unique <c>glBegin</c>, reconstruites par le fragment shader à partir du tableau de textures et de l'indirection pool communs.
+/// La position de la racine de chaque image dans l'indirection pool est transmise par sommet (deuxième coordonnée de texture).
+/// </summary>
+void drawAtlas(void)
+{
+	unsigned int nTrees = g_atlas->getNTrees();
+	unsigned int nColumns = (unsigned int)ceil(sqrt((double)nTrees));
+	unsigned int nRows = (nTrees + nColumns - 1) / nColumns;
+	double cellWidth = 1. / nColumns;
+	double cellHeight = 1. / nRows;
+
+	glUseProgram(g_atlasProgram);
+
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, g_atlasTexture);
+
+	glActiveTextureARB(GL_TEXTURE1_ARB);
+	glBindTexture(GL_TEXTURE_2D, g_atlasIndirectionPool);
+
+	glBegin(GL_QUADS);
+
+	for (unsigned int n = 0; n < nTrees; ++n)
+	{
+		// Les coordonnées de texture sont exprimées par rapport à la racine, qui peut déborder de l'image.
+		const QuadTree *tree = g_atlas->getTree(n);
+		double s1 = 1. / tree->getX1d();
+		double t1 = 1. / tree->getY1d();
+		double x0 = xFromXY(n, nColumns) * cellWidth;
+		double y0 = yFromXY(n, nColumns) * cellHeight;
+		glMultiTexCoord4dARB(GL_TEXTURE1_ARB,
+			g_atlas->getRootIndexI(n) / (double)g_atlas->getIndirectionPoolWidth(), g_atlas->getRootIndexJ(n) / (double)g_atlas->getIndirectionPoolHeight(),
+			tree->getSizeU(), tree->getSizeV());
+
+		glTexCoord2d(0., 0.);
+		glVertex2d(x0, y0);
+
+		glTexCoord2d(s1, 0.);
+		glVertex2d(x0 + cellWidth, y0);
+
+		glTexCoord2d(s1, t1);
+		glVertex2d(x0 + cellWidth, y0 + cellHeight);
+
+		glTexCoord2d(0., t1);
+		glVertex2d(x0, y0 + cellHeight);
+	}
 
 	glEnd();
-	glUseProgramObjectARB(0);
+	glUseProgram(0);
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+}
+
+/// <summary>
+/// Lit plusieurs images, construit leurs quad trees et les regroupe dans un atlas, puis charge les pages de texture (tableau de textures),
+/// l'indirection pool commune et le fragment shader correspondant.
+/// </summary>
+/// <param name="filenames">Noms des fichiers des images.</param>
+/// <param name="nFilenames">Nombre d'images.</param>
+/// <param name="splitPolicy">Critère de subdivision des noeuds.</param>
+/// <param name="powerOfTwoRoot">Spécifie si les racines doivent être complétées à une puissance de 2.</param>
+/// <param name="pageSize">Côté souhaité des pages de texture.</param>
+void loadAtlas(const char **filenames, unsigned int nFilenames, const QuadTreeSplitPolicy &splitPolicy, bool powerOfTwoRoot, unsigned int pageSize)
+{
+	// Les images restent projetées en mémoire jusqu'à la génération des pages. Les fichiers illisibles sont ignorés.
+	MappedImage *images = new MappedImage[nFilenames];
+	g_atlas = new QuadTreeAtlas(pageSize, pageSize);
+	for (unsigned int i = 0; i < nFilenames; ++i)
+	{
+		if (!images[i].open(filenames[i]))
+		{
+			fprintf(stderr, "[WARNING] Cannot open file '%s', image skipped\n", filenames[i]);
+			continue;
+		}
+		g_atlas->addTree(new QuadTree(images[i].getData(), images[i].getWidth(), images[i].getHeight(), splitPolicy, powerOfTwoRoot));
+	}
+	if (g_atlas->getNTrees() == 0)
+	{
+		fprintf(stderr, "[ERROR] No image could be loaded\n");
+		exit(1);
+	}
+	BYTE *textureData = g_atlas->generateTexture();
+	delete[] images;
+	if (textureData == NULL) exit(1);
+
+	float *indirectionPool = g_atlas->generateIndirectionPool(true, 1024);
+	printf("%u images, %u pages of %ux%u, indirection pool %ux%u\n", g_atlas->getNTrees(), g_atlas->getNPages(), g_atlas->getPageWidth(), g_atlas->getPageHeight(),
+		g_atlas->getIndirectionPoolWidth(), g_atlas->getIndirectionPoolHeight());
+
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS_EXT, &maxLayers);
+	if (g_atlas->getNPages() > (unsigned int)maxLayers)
+	{
+		fprintf(stderr, "[ERROR] %u texture pages needed (at most %d layers)\n", g_atlas->getNPages(), maxLayers);
+		exit(1);
+	}
+
+	// On charge les pages dans les couches d'un tableau de textures.
+	glGenTextures(1, &g_atlasTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, g_atlasTexture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage3DEXT(GL_TEXTURE_2D_ARRAY_EXT, 0, GL_LUMINANCE, g_atlas->getPageWidth(), g_atlas->getPageHeight(), max(g_atlas->getNPages(), 1u), 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, textureData);
+	delete[] textureData;
+
+	// L'indirection pool commune est grande : on la stocke sur 16 bits par composante afin que les coordonnées et les indices de page restent exacts.
+	glGenTextures(1, &g_atlasIndirectionPool);
+	glBindTexture(GL_TEXTURE_2D, g_atlasIndirectionPool);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, g_atlas->getIndirectionPoolWidth(), g_atlas->getIndirectionPoolHeight(), 0, GL_RGBA, GL_FLOAT, indirectionPool);
+	delete[] indirectionPool;
+
+	// On compile le fragment shader de reconstruction dédié à l'atlas.
+	t_glslPreamble preamble;
+	initGLSLPreamble(&preamble);
+	addGLSLDefine(&preamble, "textureWidth", (int)g_atlas->getPageWidth());
+	addGLSLDefine(&preamble, "textureHeight", (int)g_atlas->getPageHeight());
+	addGLSLDefine(&preamble, "indirectionPoolWidth", (int)g_atlas->getIndirectionPoolWidth());
+	addGLSLDefine(&preamble, "indirectionPoolHeight", (int)g_atlas->getIndirectionPoolHeight());
+	const char *fpBody = loadStringFromFile("quadTreeAtlasLookup.fp");
+	const char *fpCode = assembleGLSLSource(&preamble, fpBody);
+	g_atlasProgram = createGLSLProgramCached(NULL, fpCode, "quadTreeAtlasLookup");
+	bindLookupProgram(g_atlasProgram);
+	delete[] fpCode;
+	delete[] fpBody;
+	freeGLSLPreamble(&preamble);
+}
+
+/// <summary>
+/// En mode texture virtuelle, compile le programme déterminant les pages visibles et crée le tampon hors écran dans lequel il est rendu.
+/// Sans <c>GL_ARB_framebuffer_object</c>, les pages sont déterminées sur le CPU à partir de la région visible.
+/// </summary>
+void initPageCache(void)
+{
+	t_glslPreamble preamble;
+	initGLSLPreamble(&preamble);
+	addGLSLDefine(&preamble, "imageWidth", (int)g_imageWidth);
+	addGLSLDefine(&preamble, "imageHeight", (int)g_imageHeight);
+	addGLSLDefine(&preamble, "rootWidth", (int)g_tree->getSizeU());
+	addGLSLDefine(&preamble, "rootHeight", (int)g_tree->getSizeV());
+	addGLSLDefine(&preamble, "indirectionPoolWidth", (int)g_indirectionPoolWidth);
+	addGLSLDefine(&preamble, "indirectionPoolHeight", (int)g_indirectionPoolHeight);
+	const char *fpBody = loadStringFromFile("quadTreeFeedback.fp");
+	const char *fpCode = assembleGLSLSource(&preamble, fpBody);
+	g_feedbackProgram = createGLSLProgramCached(NULL, fpCode, "quadTreeFeedback");
+	bindLookupProgram(g_feedbackProgram);
+	delete[] fpCode;
+	delete[] fpBody;
+	freeGLSLPreamble(&preamble);
+
+	if (GLUX_IS_AVAILABLE(GL_ARB_framebuffer_object))
+	{
+		glGenFramebuffers(1, &g_feedbackFramebuffer);
+		glGenRenderbuffers(1, &g_feedbackRenderbuffer);
+	}
+	g_pageData = new BYTE[g_pageCache->getPageSize() * g_pageCache->getPageSize()];
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+}
+
+/// <summary>
+/// En mode texture virtuelle, détermine les pages nécessaires à l'affichage d'une région, charge celles qui sont absentes
+/// et transmet la partie modifiée de l'indirection pool.
+/// </summary>
+/// <param name="x0">Abscisse minimale de la région visible.</param>
+/// <param name="y0">Ordonnée minimale de la région visible.</param>
+/// <param name="x1">Abscisse maximale de la région visible.</param>
+/// <param name="y1">Ordonnée maximale de la région visible.</param>
+void updatePageCache(double x0, double y0, double x1, double y1)
+{
+	if (g_feedbackFramebuffer != 0)
+	{
+		// On rend les indices des pages visibles dans un tampon de résolution réduite, puis on les relit.
+		unsigned int width = max(g_mainWindowWidth / (int)FEEDBACK_SCALE, 1);
+		unsigned int height = max(g_mainWindowHeight / (int)FEEDBACK_SCALE, 1);
+		glBindFramebuffer(GL_FRAMEBUFFER, g_feedbackFramebuffer);
+		if (width != g_feedbackWidth || height != g_feedbackHeight)
+		{
+			g_feedbackWidth = width;
+			g_feedbackHeight = height;
+			glBindRenderbuffer(GL_RENDERBUFFER, g_feedbackRenderbuffer);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_feedbackRenderbuffer);
+			delete[] g_feedbackData;
+			g_feedbackData = new BYTE[width * height * 4];
+		}
+		glViewport(0, 0, width, height);
+		glClear(GL_COLOR_BUFFER_BIT);
+		drawLookupQuad(g_feedbackProgram, x0, y0, x1, y1);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, g_feedbackData);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, g_mainWindowWidth, g_mainWindowHeight);
+
+		for (unsigned int i = 0; i < width * height; ++i)
+		{
+			unsigned int page = g_feedbackData[4 * i] + 256 * g_feedbackData[4 * i + 1];
+			if (page > 0) g_pageCache->request(page - 1);
+		}
+	}
+	else
+	{
+		g_pageCache->requestRegion(x0, y0, x1, y1);
+	}
 
+	// On copie les pages chargées dans leurs emplacements de la texture cache.
+	unsigned int nUploads = g_pageCache->update(MAX_PAGE_UPLOADS);
+	unsigned int pageSize = g_pageCache->getPageSize();
+	glBindTexture(GL_TEXTURE_2D, g_texture);
+	for (unsigned int i = 0; i < nUploads; ++i)
+	{
+		unsigned int page = g_pageCache->getUploadPage(i);
+		unsigned int slot = g_pageCache->getSlot(page);
+		g_pageCache->copyPage(page, g_pageData);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, g_pageCache->getSlotU(slot), g_pageCache->getSlotV(slot), pageSize, pageSize, GL_LUMINANCE, GL_UNSIGNED_BYTE, g_pageData);
+	}
+
+	// On transmet le rectangle modifié de l'indirection pool.
+	unsigned int i0, j0, i1, j1;
+	if (g_pageCache->getDirtyRegion(i0, j0, i1, j1))
+	{
+		glBindTexture(GL_TEXTURE_2D, g_indirectionPool);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, g_indirectionPoolWidth);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, i0, j0, i1 - i0 + 1, j1 - j0 + 1, GL_RGBA, GL_FLOAT, g_pageCache->getIndirectionPool() + packXYZ(0, i0, j0, 4, g_indirectionPoolWidth));
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		g_pageCache->clearDirtyRegion();
+	}
+}
+
+/// <summary>
+/// Compare les deux stratégies de reconstruction (un <c>GL_QUADS</c> par patch et fragment shader avec indirection pool) en les rendant hors écran,
+/// pour plusieurs tailles de fenêtre et niveaux de zoom, et affiche le temps par image et le débit en pixels.
+/// Peut être exécuté sur le rasteriseur logiciel de Mesa (<c>LIBGL_ALWAYS_SOFTWARE=1</c>).
+/// </summary>
+/// <param name="nFrames">Nombre d'images rendues par mesure.</param>
+void runBenchmark(unsigned int nFrames)
+{
+	static const unsigned int sizes[] = {256, 512, 1024, 2048};
+	static const double zooms[] = {1., 2., 4.};
+	static const char *strategies[] = {"geometry", "shader"};
+
+	// Le rendu hors écran nécessite les framebuffer objects.
+	if (!GLUX_IS_AVAILABLE(GL_ARB_framebuffer_object))
+	{
+		fprintf(stderr, "[ERROR] GL_ARB_framebuffer_object unavailable, cannot run the benchmark\n");
+		exit(1);
+	}
+
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+
+	GLuint framebuffer, renderbuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glGenRenderbuffers(1, &renderbuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	printf("%-10s %6s %6s %5s %10s %12s\n", "strategy", "width", "height", "zoom", "ms/frame", "Mpixels/s");
+	for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		// La fenêtre hors écran conserve les proportions de l'image.
+		unsigned int width = min(sizes[s], (unsigned int)maxSize);
+		unsigned int height = max(min((unsigned int)(width * (double)g_imageHeight / g_imageWidth), (unsigned int)maxSize), 1u);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) continue;
+		glViewport(0, 0, width, height);
+
+		for (unsigned int z = 0; z < sizeof(zooms) / sizeof(zooms[0]); ++z)
+		{
+			glMatrixMode(GL_PROJECTION);
+			glLoadIdentity();
+			gluOrtho2D(0.0, 1.0 / zooms[z], 0.0, 1.0 / zooms[z]);
+			glMatrixMode(GL_MODELVIEW);
+			glLoadIdentity();
+
+			for (unsigned int strategy = 0; strategy < 2; ++strategy)
+			{
+				if (strategy == 1 && g_glslProgram == 0) continue;
+				if (strategy == 0 && g_pageCache != NULL) continue;
+
+				// Une première image, non mesurée, permet d'écarter les coûts d'initialisation du pilote.
+				double start = 0.;
+				for (unsigned int frame = 0; frame <= nFrames; ++frame)
+				{
+					if (frame == 1)
+					{
+						glFinish();
+						start = QuadTreeProfiler::now();
+					}
+					glClear(GL_COLOR_BUFFER_BIT);
+					if (strategy == 0) drawImage(false, 0., 0., 1. / zooms[z], 1. / zooms[z]);
+					else drawLookupQuad(g_glslProgram, 0., 0., 1. / zooms[z], 1. / zooms[z]);
+				}
+				glFinish();
+				double time = (QuadTreeProfiler::now() - start) / 1000. / nFrames;
+				printf("%-10s %6u %6u %5.1f %10.3f %12.2f\n", strategies[strategy], width, height, zooms[z], time, width * height / (time * 1000.));
+			}
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &renderbuffer);
+	glDeleteFramebuffers(1, &framebuffer);
 }
 
 void mainKeyboard(unsigned char key, int x, int y) 
@@ -212,11 +801,63 @@ void mainKeyboard(unsigned char key, int x, int y)
 	case 't':
 		++g_task;		
 		break;
+	case 'v':
+		// On passe à la variante suivante du fragment shader.
+		if (g_nLookupVariants > 0)
+		{
+			g_lookupVariant = (g_lookupVariant + 1) % g_nLookupVariants;
+			g_glslProgram = g_lookupVariants[g_lookupVariant].program;
+			printf("using '%s'\n", g_lookupVariants[g_lookupVariant].filename);
+		}
+		break;
+	case 'o':
+		g_showOverlay = !g_showOverlay;
+		break;
+	case '+':
+		g_viewZoom *= 1.25;
+		break;
+	case '-':
+		g_viewZoom /= 1.25;
+		break;
+	case 'r':
+		// On revient à l'image entière, à l'échelle 1.
+		g_viewCenterX = g_viewCenterY = 0.5;
+		g_viewZoom = 1.;
+		break;
 	case 'q':
 		exit(0);
 	}
 }
 
+/// <summary>
+/// En mode visionneuse, le bouton gauche déplace l'image et le bouton droit modifie le zoom.
+/// </summary>
+void mainMouse(int button, int state, int x, int y)
+{
+	g_mouseButton = (state == GLUT_DOWN) ? button : -1;
+	g_mouseX = x;
+	g_mouseY = y;
+}
+
+void mainMotion(int x, int y)
+{
+	int dx = x - g_mouseX;
+	int dy = y - g_mouseY;
+	g_mouseX = x;
+	g_mouseY = y;
+
+	if (g_mouseButton == GLUT_LEFT_BUTTON)
+	{
+		// L'axe vertical de la fenêtre est orienté vers le bas.
+		g_viewCenterX -= dx / (g_viewZoom * g_imageWidth);
+		g_viewCenterY += dy / (g_viewZoom * g_imageHeight);
+	}
+	else if (g_mouseButton == GLUT_RIGHT_BUTTON)
+	{
+		g_viewZoom = min(max(g_viewZoom * exp(-0.01 * dy), 1. / 64.), 256.);
+	}
+}
+
 void mainReshape(int w, int h)
 {
 	g_mainWindowWidth = w;
@@ -229,10 +870,30 @@ void mainRender()
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	gluOrtho2D(0.0, 1.0, 0.0, 1.0); 
+	double x0, y0, x1, y1;
+	getViewRegion(x0, y0, x1, y1);
+	gluOrtho2D(x0, x1, y0, y1); 
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
+	// En mode atlas, l'unique tâche consiste à afficher toutes les images.
+	if (g_atlas != NULL)
+	{
+		glutSetWindowTitle("Images reconstruites depuis un atlas commun en un seul appel (appuyer sur 'q' pour quitter)");
+		g_renderProfiler->beginTask(0);
+		drawAtlas();
+		g_renderProfiler->endTask();
+		if (g_showOverlay) g_renderProfiler->drawOverlay(0);
+		glutSwapBuffers();
+		g_renderProfiler->endFrame();
+		return;
+	}
+
+	// En mode texture virtuelle, on charge les pages nécessaires avant l'affichage.
+	if (g_pageCache != NULL) updatePageCache(x0, y0, x1, y1);
+
+	// Chaque tâche est chronométrée (temps CPU et GPU).
+	if (g_task % 5 < 4) g_renderProfiler->beginTask(g_task % 5);
 	switch (g_task % 5)
 	{
 	case 0:
@@ -250,32 +911,174 @@ void mainRender()
 	case 4:
 		exit(0);
 	}
+	g_renderProfiler->endTask();
+	if (g_showOverlay) g_renderProfiler->drawOverlay(g_task % 5);
 
 	glutSwapBuffers();
+	g_renderProfiler->endFrame();
+}
+
+/// <summary>
+/// Exporte les mesures des tâches de rendu à la fermeture du programme (<c>glutMainLoop</c> ne rendant jamais la main).
+/// </summary>
+void exportRenderProfile(void)
+{
+	g_renderProfiler->exportCSV("renderProfile.csv");
 }
 
 void idle(void)
 {
+	// On vérifie régulièrement si les sources des fragment shaders ont été modifiées.
+	int time = glutGet(GLUT_ELAPSED_TIME);
+	if (time - g_lastWatchTime > 250)
+	{
+		g_lastWatchTime = time;
+		watchLookupVariants();
+	}
 	glutPostRedisplay();
 }
 
 int main(int argc, char **argv)
 {
-	// On lit l'image et on crée le quad tree correspondant.
-	BYTE *imageData = readPgm(argv[1], g_imageWidth, g_imageHeight);
-	g_tree = new QuadTree(imageData, g_imageWidth, g_imageHeight);
+	// On lit les options de la ligne de commande :
+	//	- -minLeafSize, -maxLeafSize, -maxDepth, -maxBackground et -maxError définissent le critère de subdivision,
+	//	- -pot impose une racine carrée de côté puissance de 2,
+	//	- -fp ajoute une variante du fragment shader (par défaut quadTreeLookup.fp), 'v' permettant de passer de l'une à l'autre,
+	//	- -benchmark n compare les stratégies de reconstruction hors écran sur n images par mesure, puis quitte,
+	//	- -view active le mode visionneuse (déplacement et zoom à la souris, '+', '-' et 'r'), la fenêtre n'étant plus redimensionnée à la taille de l'image,
+	//	- -virtual n active le mode texture virtuelle avec des pages de côté n, chargées dans une texture cache de côté -cacheSize (implique -view),
+	//	- -pageSize définit le côté des pages de texture du mode atlas,
+	//	- -gutter et -mipLevels définissent la bordure des patches et le nombre de niveaux de mipmap de la texture (filtrage activé si -mipLevels est non nul),
+	//	- -compress charge la texture compressée au format BC4 (4 fois moins de mémoire vidéo), les patches étant alignés sur les blocs de 4x4 texels,
+	// les arguments qui ne sont pas des options étant les noms des images. Si plusieurs images sont données, elles sont regroupées dans un atlas.
+	const char **filenames = new const char*[argc];
+	unsigned int nFilenames = 0;
+	unsigned int pageSize = 1024;
+	unsigned int virtualPageSize = 0;
+	unsigned int cacheSize = 1024;
+	QuadTreeSplitPolicy splitPolicy;
+	bool powerOfTwoRoot = false;
+	unsigned int gutter = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-minLeafSize") && i + 1 < argc) splitPolicy.minLeafSize = max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "-maxLeafSize") && i + 1 < argc) splitPolicy.maxLeafSize = max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "-maxDepth") && i + 1 < argc) splitPolicy.maxDepth = (unsigned int)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-maxBackground") && i + 1 < argc) splitPolicy.maxBackgroundFraction = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-maxError") && i + 1 < argc) splitPolicy.maxEmptyError = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-pot")) powerOfTwoRoot = true;
+		else if (!strcmp(argv[i], "-view")) g_viewMode = true;
+		else if (!strcmp(argv[i], "-benchmark") && i + 1 < argc) g_benchmarkFrames = (unsigned int)max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "-fp") && i + 1 < argc && g_nLookupVariants < MAX_LOOKUP_VARIANTS) g_lookupVariants[g_nLookupVariants++].filename = argv[++i];
+		else if (!strcmp(argv[i], "-gutter") && i + 1 < argc) gutter = (unsigned int)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-mipLevels") && i + 1 < argc) g_mipLevels = (unsigned int)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-compress")) g_compressTexture = true;
+		else if (!strcmp(argv[i], "-virtual") && i + 1 < argc) virtualPageSize = (unsigned int)max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "-cacheSize") && i + 1 < argc) cacheSize = (unsigned int)max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "-pageSize") && i + 1 < argc) pageSize = (unsigned int)max(atoi(argv[++i]), 1);
+		else filenames[nFilenames++] = argv[i];
+	}
+	if (nFilenames == 0)
+	{
+		fprintf(stderr, "usage: %s [-minLeafSize n] [-maxLeafSize n] [-maxDepth n] [-maxBackground f] [-maxError f] [-pot] [-gutter n] [-mipLevels n] [-view] [-fp shader.fp]... [-benchmark n] [-virtual n] [-cacheSize n] [-pageSize n] image.pgm...\n", argv[0]);
+		return 1;
+	}
+	if (nFilenames > 1)
+	{
+		glutInit(&argc, argv);
+		glutInitWindowSize(g_mainWindowWidth, g_mainWindowHeight); 
+		glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+		g_mainWindow = glutCreateWindow(NULL);
+		glutDisplayFunc(mainRender);
+		glutReshapeFunc(mainReshape);
+		glutKeyboardFunc(mainKeyboard);
+		glutIdleFunc(idle);
+		gluxInit();
+
+		glClearColor(0.0, 0.0, 0.0, 1.0);
+
+		g_renderProfiler = new RenderProfiler(1);
+		g_renderProfiler->init();
+		atexit(exportRenderProfile);
+
+		// La vue à l'échelle des pixels suppose une image unique.
+		if (g_viewMode)
+		{
+			fprintf(stderr, "[WARNING] -view is not supported with several images, whole atlas displayed\n");
+			g_viewMode = false;
+		}
+		loadAtlas(filenames, nFilenames, splitPolicy, powerOfTwoRoot, pageSize);
+		delete[] filenames;
+		glutMainLoop();
+		return 0;
+	}
+	const char *filename = filenames[0];
+	delete[] filenames;
+	if (g_nLookupVariants == 0) g_lookupVariants[g_nLookupVariants++].filename = "quadTreeLookup.fp";
+
+	// On projette l'image en mémoire et on crée le quad tree correspondant. En mode texture virtuelle, aucune feuille non vide ne doit dépasser la taille d'une page.
+	MappedImage image;
+	if (!image.open(filename))
+	{
+		fprintf(stderr, "[ERROR] Cannot open file '%s'\n", filename);
+		return 1;
+	}
+	g_imageWidth = image.getWidth();
+	g_imageHeight = image.getHeight();
+	if (virtualPageSize > 0) splitPolicy.maxLeafSize = min(splitPolicy.maxLeafSize, virtualPageSize);
+	g_tree = new QuadTree(image.getData(), g_imageWidth, g_imageHeight, splitPolicy, powerOfTwoRoot);
+	if (virtualPageSize > 0 && g_tree->isLeaf())
+	{
+		fprintf(stderr, "[WARNING] Root is a leaf, virtual texturing disabled\n");
+		virtualPageSize = 0;
+	}
+	if (virtualPageSize > 0)
+	{
+		unsigned int nPages = QuadTreePageCache::countPages(g_tree, virtualPageSize);
+		if (nPages > QuadTreePageCache::MAX_PAGES)
+		{
+			fprintf(stderr, "[WARNING] %u pages (at most %u are addressable), virtual texturing disabled\n", nPages, QuadTreePageCache::MAX_PAGES);
+			virtualPageSize = 0;
+		}
+	}
+
+	float *indirectionPool = NULL;
+	if (virtualPageSize > 0)
+	{
+		// En mode texture virtuelle, seule l'indirection pool est générée, les pages étant copiées depuis l'image (qui reste projetée) à la demande.
+		g_pageCache = new QuadTreePageCache(g_tree, virtualPageSize, cacheSize, cacheSize);
+		g_textureWidth = g_pageCache->getCacheWidth();
+		g_textureHeight = g_pageCache->getCacheHeight();
+		g_indirectionPoolWidth = g_pageCache->getIndirectionPoolWidth();
+		g_indirectionPoolHeight = g_pageCache->getIndirectionPoolHeight();
+		g_mipLevels = 0;
+		g_viewMode = true;
+		g_task = 3;
+		printf("%u pages of %ux%u, %u slots\n", g_pageCache->getNPages(), virtualPageSize, virtualPageSize, g_pageCache->getNSlots());
+	}
+	else
+	{
+		// On place les patchs. La texture ne sera écrite que lors de son chargement, directement depuis l'image.
+		g_tree->packTexture(true, gutter, g_mipLevels, g_compressTexture ? BC4Codec::BLOCK_SIZE : 1);
+		g_textureHeight = g_tree->getTotalSizeV();
+		g_textureWidth = g_tree->getTotalSizeU();
 
-	// On génère la texture contenant les patchs.
-	BYTE *textureData = g_tree->generateTexture();
-	delete[] imageData;
-	g_textureHeight = g_tree->getTotalSizeV();
-	g_textureWidth = g_tree->getTotalSizeU();
+		// On génère l'indirection pool.
+		indirectionPool = g_tree->generateIndirectionPool(true, 128);
+		g_indirectionPoolWidth = g_tree->getIndirectionPoolWidth();
+		g_indirectionPoolHeight = g_tree->getIndirectionPoolHeight();
+	}
 
-	// On génère l'indirection pool.
-	float *indirectionPool = g_tree->generateIndirectionPool(true, 128);
-	unsigned int indirectionPoolWidth = g_tree->getIndirectionPoolWidth();
-	unsigned int indirectionPoolHeight = g_tree->getIndirectionPoolHeight();
+	// On affiche les statistiques de l'arbre.
+	QuadTreeStats stats;
+	g_tree->computeStats(stats);
+	QuadTree::printStats(stats);
 
+#ifdef QUADTREE_PROFILING
+	// On exporte les mesures effectuées lors de la construction.
+	QuadTreeProfiler::exportJSON("quadTreeProfile.json", g_tree);
+	QuadTreeProfiler::exportChromeTrace("quadTreeTrace.json");
+#endif
 
 	glutInit(&argc, argv);
 	glutInitWindowSize(g_mainWindowWidth, g_mainWindowHeight); 
@@ -285,57 +1088,109 @@ int main(int argc, char **argv)
 	glutDisplayFunc(mainRender);
 	glutReshapeFunc(mainReshape);
 	glutKeyboardFunc(mainKeyboard);
+	glutMouseFunc(mainMouse);
+	glutMotionFunc(mainMotion);
 	glutIdleFunc(idle);
 	gluxInit();
 
 	glClearColor(0.0, 0.0, 0.0, 1.0);
 
-	// On charge la texture contenant les patchs dans la mémoire vidéo.
+	g_renderProfiler = new RenderProfiler(4);
+	g_renderProfiler->init();
+	// Le mode benchmark ne profile aucune image : l'export écraserait le profil d'une session interactive précédente.
+	if (g_benchmarkFrames == 0) atexit(exportRenderProfile);
+
+	// On lance la compilation des variantes du fragment shader, qui se déroule pendant le chargement des textures.
+	initGLSLParallelCompile();
+	for (unsigned int i = 0; i < g_nLookupVariants; ++i)
+	{
+		LookupVariant &variant = g_lookupVariants[i];
+		variant.program = 0;
+		initGLSLFileWatch(&variant.watch, variant.filename);
+		variant.pending = submitLookupProgram(&variant.job, variant.filename);
+	}
+
+	// On charge la texture contenant les patchs dans la mémoire vidéo (en mode texture virtuelle, la texture cache est initialement vide).
 	glGenTextures(1, &g_texture);
 	glBindTexture(GL_TEXTURE_2D, g_texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, g_textureWidth, g_textureHeight, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, textureData);
-	delete[] textureData;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (g_mipLevels > 0) ? GL_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (g_mipLevels > 0) ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, g_mipLevels);
+	if (g_pageCache != NULL)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, g_textureWidth, g_textureHeight, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
+	}
+	else if (g_compressTexture && uploadCompressedTexture())
+	{
+		// La texture et ses niveaux de mipmap ont été compressés et chargés.
+	}
+	else if (g_mipLevels > 0 || !uploadTextureFromBuffer())
+	{
+		// A défaut de pixel buffer object, ou si les niveaux de mipmap doivent être calculés, la texture est écrite dans un tableau.
+		BYTE *textureData = new BYTE[g_textureWidth * g_textureHeight];
+		g_tree->writeTexture(textureData);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, g_textureWidth, g_textureHeight, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, textureData);
 
-	// On charge l'indirection pool dans la mémoire vidéo.
+		// Si besoin, on génère et on charge les niveaux de mipmap successifs.
+		unsigned int levelWidth = g_textureWidth;
+		unsigned int levelHeight = g_textureHeight;
+		for (unsigned int level = 1; level <= g_mipLevels; ++level)
+		{
+			BYTE *levelData = QuadTree::generateMipmapLevel(textureData, levelWidth, levelHeight);
+			delete[] textureData;
+			textureData = levelData;
+			levelWidth = max(levelWidth / 2, 1u);
+			levelHeight = max(levelHeight / 2, 1u);
+			glTexImage2D(GL_TEXTURE_2D, level, GL_LUMINANCE, levelWidth, levelHeight, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, textureData);
+		}
+		delete[] textureData;
+	}
+
+	// Hors mode texture virtuelle, l'image n'est plus nécessaire.
+	if (g_pageCache == NULL) image.close();
+
+	// On charge l'indirection pool dans la mémoire vidéo. En mode texture virtuelle, elle est stockée sur 16 bits par composante afin de conserver les indices de page.
 	glGenTextures(1, &g_indirectionPool);
 	glBindTexture(GL_TEXTURE_2D, g_indirectionPool);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, indirectionPoolWidth, indirectionPoolHeight, 0, GL_RGBA, GL_FLOAT, indirectionPool);
+	if (g_pageCache != NULL)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, g_indirectionPoolWidth, g_indirectionPoolHeight, 0, GL_RGBA, GL_FLOAT, g_pageCache->getIndirectionPool());
+		g_pageCache->clearDirtyRegion();
+		initPageCache();
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, g_indirectionPoolWidth, g_indirectionPoolHeight, 0, GL_RGBA, GL_FLOAT, indirectionPool);
+	}
 	delete[] indirectionPool;
 
-	// On charge la source du fragment shader et on insère les définitions des différents paramètres.
-	const char *fpCode = loadStringFromFile("quadTreeLookup.fp");
-	fpCode = insertDefine(fpCode, "imageWidth", (int)g_imageWidth);
-	fpCode = insertDefine(fpCode, "imageHeight", (int)g_imageHeight);
-	fpCode = insertDefine(fpCode, "textureWidth", (int)g_textureWidth);
-	fpCode = insertDefine(fpCode, "textureHeight", (int)g_textureHeight);
-	fpCode = insertDefine(fpCode, "indirectionPoolWidth", (int)indirectionPoolWidth);
-	fpCode = insertDefine(fpCode, "indirectionPoolHeight", (int)indirectionPoolHeight);
-	g_glslProgram = createGLSLProgram(NULL, fpCode);
-	delete[] fpCode;
-
-
-	glUseProgramObjectARB(g_glslProgram);
-
-	g_glslTexture = glGetUniformLocationARB(g_glslProgram, "u_texture");
-	g_glslIndirectionPool = glGetUniformLocationARB(g_glslProgram, "u_indirectionPool");
+	// On attend la fin de la compilation. En cas d'erreur, la quatrième tâche se rabat sur l'affichage par patch.
+	for (unsigned int i = 0; i < g_nLookupVariants; ++i)
+	{
+		if (g_lookupVariants[i].pending) waitGLSLPrograms(&g_lookupVariants[i].job, 1);
+		updateLookupVariant(g_lookupVariants[i]);
+	}
 
-	glUniform1iARB(g_glslTexture, 0);
-	glUniform1iARB(g_glslIndirectionPool, 1); 
-	glUseProgramObjectARB(0);
+	if (g_benchmarkFrames > 0)
+	{
+		glutHideWindow();
+		runBenchmark(g_benchmarkFrames);
+		exit(0);
+	}
 
 	glutMainLoop();
 
 	glDeleteTextures(1, &g_texture);
 	glDeleteTextures(1, &g_indirectionPool);
 
+	delete[] g_visibleLeaves;
+	delete g_pageCache;
 	delete g_tree;
 
 	return 0;
@@ -0,0 +1,67 @@
+// Variante du fragment shader de reconstruction pour un atlas regroupant plusieurs images (QuadTreeAtlas) :
+//  - les patches sont rpartis dans les couches d'un tableau de textures, dont l'indice est stock dans la quatrime coordonne de l'indirection pool,
+//  - l'indirection pool est commune  toutes les images,
+//  - gl_TexCoord[0] contient les coordonnes normalises du point par rapport  la racine de l'image,
+//  - gl_TexCoord[1] contient les coordonnes normalises de la racine de l'image dans l'indirection pool, puis les dimensions de la racine.
+// Ces paramtres tant transmis par sommet, toutes les images peuvent tre dessines en un seul appel.
+#define normIndexI(i) (float(i) / float(indirectionPoolWidth)) 
+#define normIndexJ(j) (float(j) / float(indirectionPoolHeight)) 
+#define unNormIndexI(i) round(i * float(indirectionPoolWidth))
+#define unNormIndexJ(j) round(j * float(indirectionPoolHeight))
+#define normTexU(u) (float(u) / float(textureWidth)) 
+#define normTexV(v) (float(v) / float(textureHeight))
+#define unNormTexU(u) round(u * float(textureWidth))
+#define unNormTexV(v) round(v * float(textureHeight))
+#define round(x) ((x - floor(x) < 0.5) ? int(x) : (int(x) + 1))
+
+#extension GL_EXT_texture_array : enable
+
+uniform sampler2DArray u_texture;
+uniform sampler2D u_indirectionPool;
+	
+void main()
+{
+	float fracU = gl_TexCoord[0].s;
+	float fracV = gl_TexCoord[0].t;
+	float rootWidth = gl_TexCoord[1].p;
+	float rootHeight = gl_TexCoord[1].q;
+
+	// Le parcours dmarre  l'indirection pool locale de la racine de l'image.
+	int dataType = 0; // 0 -> 0 ; 1 -> next ; 2 -> texture
+	float data0 = gl_TexCoord[1].s;
+	float data1 = gl_TexCoord[1].t;
+	int i, j, indexI, indexJ;
+	float scale = 1.;
+	vec4 indirectionPoolLookup;
+
+	do
+	{
+		i = (fracU > 0.5) ? 1 : 0;
+		j = (fracV > 0.5) ? 1 : 0;
+		indexI = unNormIndexI(data0);
+		indexJ = unNormIndexJ(data1);
+		indirectionPoolLookup = texture2D(u_indirectionPool, vec2(normIndexI(indexI + i), normIndexJ(indexJ + j)));
+		dataType = round(2. * indirectionPoolLookup.r);
+		data0 = indirectionPoolLookup.g;
+		data1 = indirectionPoolLookup.b;
+
+		fracU = (i > 0) ? (2. * fracU - 1.) : (2. * fracU);
+		fracV = (j > 0) ? (2. * fracV - 1.) : (2. * fracV);
+
+		scale /= 2.;
+	}
+	while (dataType != 2 && dataType != 0);
+
+	// Lorsqu'une feuille non vide est atteinte, on lit le pixel dans la couche de la texture contenant son patch.
+	vec4 pixel = vec4(0, 0, 0, 0);
+	if (dataType == 2) 
+	{
+		int u = round(fracU * scale * rootWidth);
+		int v = round(fracV * scale * rootHeight);
+		int du = unNormTexU(data0);
+		int dv = unNormTexV(data1);
+		int layer = round(255. * indirectionPoolLookup.a);
+		pixel = texture2DArray(u_texture, vec3(normTexU(u + du), normTexV(v + dv), float(layer)));
+	}
+	gl_FragColor = pixel;
+}
@@ -0,0 +1,42 @@
+// Passe de rendu de la texture virtuelle (QuadTreePageCache) : pour chaque pixel, on parcourt l'arbre jusqu' l'entre dsignant une page,
+// dont la quatrime coordonne contient (indice de page + 1) / 65535, que la page soit prsente ou non.
+// L'indice est crit sur les composantes rouge (octet de poids faible) et verte (octet de poids fort), 0 signifiant qu'aucune page n'est ncessaire.
+#define normIndexI(i) (float(i) / float(indirectionPoolWidth)) 
+#define normIndexJ(j) (float(j) / float(indirectionPoolHeight)) 
+#define unNormIndexI(i) round(i * float(indirectionPoolWidth))
+#define unNormIndexJ(j) round(j * float(indirectionPoolHeight))
+#define round(x) ((x - floor(x) < 0.5) ? int(x) : (int(x) + 1))
+
+uniform sampler2D u_indirectionPool;
+	
+void main()
+{
+	float fracU = gl_TexCoord[0].s * float(imageWidth) / float(rootWidth);
+	float fracV = gl_TexCoord[0].t * float(imageHeight) / float(rootHeight);
+
+	int dataType = 0; // 0 -> 0 ; 1 -> next ; 2 -> texture
+	float data0 = 0.;
+	float data1 = 0.;
+	int i, j, indexI, indexJ;
+	int page = 0;
+	vec4 indirectionPoolLookup;
+
+	do
+	{
+		i = (fracU > 0.5) ? 1 : 0;
+		j = (fracV > 0.5) ? 1 : 0;
+		indexI = unNormIndexI(data0);
+		indexJ = unNormIndexJ(data1);
+		indirectionPoolLookup = texture2D(u_indirectionPool, vec2(normIndexI(indexI + i), normIndexJ(indexJ + j)));
+		dataType = round(2. * indirectionPoolLookup.r);
+		data0 = indirectionPoolLookup.g;
+		data1 = indirectionPoolLookup.b;
+		page = round(65535. * indirectionPoolLookup.a);
+
+		fracU = (i > 0) ? (2. * fracU - 1.) : (2. * fracU);
+		fracV = (j > 0) ? (2. * fracV - 1.) : (2. * fracV);
+	}
+	while (dataType == 1 && page == 0);
+
+	gl_FragColor = vec4(mod(float(page), 256.) / 255., floor(float(page) / 256.) / 255., 0., 1.);
+}
@@ -3,14 +3,18 @@
 #define normIndexJ(j) (float(j) / float(indirectionPoolHeight)) 
 #define unNormIndexI(i) round(i * float(indirectionPoolWidth))
 #define unNormIndexJ(j) round(j * float(indirectionPoolHeight))
-#define unNormImU(u) round(u * float(imageWidth))
-#define unNormImV(v) round(v * float(imageHeight))
+#define unNormImU(u) round(u * float(rootWidth))
+#define unNormImV(v) round(v * float(rootHeight))
 #define normTexU(u) (float(u) / float(textureWidth)) 
 #define normTexV(v) (float(v) / float(textureHeight))
 #define unNormTexU(u) round(u * float(textureWidth))
 #define unNormTexV(v) round(v * float(textureHeight))
 #define round(x) ((x - floor(x) < 0.5) ? int(x) : (int(x) + 1))
 
+#if mipLevels > 0
+#extension GL_ARB_shader_texture_lod : enable
+#endif
+
 
 uniform sampler2D u_texture;
 uniform sampler2D u_indirectionPool;
@@ -18,8 +22,16 @@ uniform sampler2D u_indirectionPool;
 void main()
 {
 
-	float fracU = gl_TexCoord[0].s;
-	float fracV = gl_TexCoord[0].t;
+	// La racine peut dborder de l'image (racine complte  une puissance de 2) : on exprime les coordonnes par rapport  la racine.
+	float fracU = gl_TexCoord[0].s * float(imageWidth) / float(rootWidth);
+	float fracV = gl_TexCoord[0].t * float(imageHeight) / float(rootHeight);
+
+#if mipLevels > 0
+	// L'empreinte du pixel dans l'image est calcule avant le parcours de l'arbre, les drives n'tant pas dfinies dans une boucle.
+	float footprintU = length(vec2(dFdx(gl_TexCoord[0].s), dFdy(gl_TexCoord[0].s))) * float(imageWidth);
+	float footprintV = length(vec2(dFdx(gl_TexCoord[0].t), dFdy(gl_TexCoord[0].t))) * float(imageHeight);
+	float lod = max(log2(max(footprintU, footprintV)), 0.);
+#endif
 
 	int dataType = 0; // 0 -> 0 ; 1 -> next ; 2 -> texture
 	float data0 = 0.;
@@ -65,11 +77,18 @@ void main()
 	vec4 pixel = vec4(0, 0, 0, 0);
 	if (dataType == 2) 
 	{
+#if mipLevels > 0
+		// Le niveau de dtail est born par la taille du patch, qui dpend de la profondeur de la feuille.
+		float maxLod = min(float(mipLevels), log2(min(float(rootWidth), float(rootHeight)) * scale));
+		vec2 coord = vec2(data0 + fracU * scale * float(rootWidth) / float(textureWidth), data1 + fracV * scale * float(rootHeight) / float(textureHeight));
+		pixel = texture2DLod(u_texture, coord, min(lod, maxLod));
+#else
 		int u = unNormImU(fracU * scale);
 		int v = unNormImV(fracV * scale);
 		int du = unNormTexU(data0);
 		int dv = unNormTexV(data1);
 		pixel = texture2D(u_texture, vec2(normTexU(u + du), normTexV(v + dv)));
+#endif
 	}
 	gl_FragColor = pixel;
 }